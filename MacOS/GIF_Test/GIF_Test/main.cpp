@@ -11,6 +11,7 @@
 // test images
 #include "../../../test_images/earth_128x128.h"
 #include "../../../test_images/green.h"
+#include "../../../test_images/homer_tiny.h"
 // You can disable the fuzz tests to speed up the testing
 #define RUN_FUZZ_TESTS
 // buffer overflow?
@@ -77,6 +78,188 @@ void GIFDraw(GIFDRAW *pDraw)
         u32Pixel = *(uint32_t *)pDraw->pPixels; // grab 1 or more pixels to test
     }
 } /* GIFDraw() */
+//
+// Callback which accumulates a checksum of every line it receives
+//
+uint32_t u32Checksum;
+int iLineCount, iDrawCount;
+void GIFDrawSum(GIFDRAW *pDraw)
+{
+    iDrawCount++;
+    for (int y=0; y<pDraw->iStripHeight; y++) { // strip mode can send multiple lines
+        uint8_t *s = &pDraw->pPixels[y * pDraw->iPitch];
+        iLineCount++;
+        u32Checksum = (u32Checksum * 31) + pDraw->y + y;
+        for (int x=0; x<pDraw->iWidth; x++) {
+            u32Checksum = (u32Checksum * 31) + s[x];
+        }
+    }
+} /* GIFDrawSum() */
+//
+// Callback which checks the opaque span list against the pixels of each line
+//
+int iSpanErrors;
+void GIFDrawSpans(GIFDRAW *pDraw)
+{
+    int x = 0, iOpaque;
+    iLineCount++;
+    if (pDraw->pSpans == NULL) {
+        iSpanErrors++;
+        return;
+    }
+    for (int i=0; i<=pDraw->iSpanCount; i++) {
+        int iStart = (i < pDraw->iSpanCount) ? pDraw->pSpans[i*2] : pDraw->iWidth;
+        int iEnd = (i < pDraw->iSpanCount) ? iStart + pDraw->pSpans[i*2+1] : pDraw->iWidth;
+        for (; x<iEnd; x++) { // transparent up to the span, opaque inside it
+            iOpaque = !pDraw->ucHasTransparency || pDraw->pPixels[x] != pDraw->ucTransparent;
+            if (iOpaque != (x >= iStart)) iSpanErrors++;
+        }
+    }
+} /* GIFDrawSpans() */
+//
+// Callback which copies only the listed spans of cooked RGB565 pixels to a canvas sized display
+//
+uint16_t *pDisplay;
+void GIFDrawCopySpans(GIFDRAW *pDraw)
+{
+    uint16_t *s = (uint16_t *)pDraw->pPixels;
+    uint16_t *d = &pDisplay[pDraw->iX + (pDraw->iY + pDraw->y) * pDraw->iCanvasWidth];
+    for (int i=0; i<pDraw->iSpanCount; i++) {
+        memcpy(&d[pDraw->pSpans[i*2]], &s[pDraw->pSpans[i*2]], pDraw->pSpans[i*2+1] * sizeof(uint16_t));
+        iLineCount++;
+    }
+} /* GIFDrawCopySpans() */
+//
+// Callback which remembers the palette used for the last line
+//
+uint16_t *pLastPalette;
+void GIFDrawPalette(GIFDRAW *pDraw)
+{
+    pLastPalette = pDraw->pPalette;
+} /* GIFDrawPalette() */
+//
+// Create a 4-color GIF of any size in memory with the pixel pattern that
+// GIFDrawWide() expects. The LZW stream is all literals (a clear code
+// before every 2 pixels keeps the codes at 3 bits).
+//
+#define WIDE_PIXEL(x, y) ((((x) >> 4) + (y)) & 3)
+void WideCode(uint8_t *pLZW, int *piBit, int iCode)
+{
+    for (int i=0; i<3; i++, (*piBit)++) {
+        pLZW[*piBit >> 3] |= ((iCode >> i) & 1) << (*piBit & 7);
+    }
+} /* WideCode() */
+
+int MakeWideGIF(uint8_t *pOut, int iWidth, int iHeight)
+{
+    uint8_t *d = pOut, *pLZW;
+    int i, iLen, iBit = 0, iPixels = iWidth * iHeight;
+    const uint8_t ucColors[12] = {0,0,0, 255,0,0, 0,255,0, 0,0,255};
+
+    pLZW = (uint8_t *)calloc(1, iPixels + 16); // 4.5 bits per pixel
+    for (i=0; i<iPixels; i++) {
+        if ((i & 1) == 0)
+            WideCode(pLZW, &iBit, 4); // clear
+        WideCode(pLZW, &iBit, WIDE_PIXEL(i % iWidth, i / iWidth));
+    }
+    WideCode(pLZW, &iBit, 5); // end of data
+    memcpy(d, "GIF89a", 6); d += 6;
+    *d++ = (uint8_t)iWidth; *d++ = (uint8_t)(iWidth >> 8);
+    *d++ = (uint8_t)iHeight; *d++ = (uint8_t)(iHeight >> 8);
+    *d++ = 0x81; *d++ = 0; *d++ = 0; // 4 color global table
+    memcpy(d, ucColors, sizeof(ucColors)); d += sizeof(ucColors);
+    *d++ = ',';
+    memset(d, 0, 4); d += 4; // frame at 0,0
+    *d++ = (uint8_t)iWidth; *d++ = (uint8_t)(iWidth >> 8);
+    *d++ = (uint8_t)iHeight; *d++ = (uint8_t)(iHeight >> 8);
+    *d++ = 0; // not interlaced, no local table
+    *d++ = 2; // LZW code size
+    for (i=0; i<(iBit+7)/8; i+=iLen) { // sub-blocks of up to 255 bytes
+        iLen = (iBit+7)/8 - i;
+        if (iLen > 255) iLen = 255;
+        *d++ = (uint8_t)iLen;
+        memcpy(d, &pLZW[i], iLen); d += iLen;
+    }
+    *d++ = 0; // end of the image data
+    *d++ = ';';
+    free(pLZW);
+    return (int)(d - pOut);
+} /* MakeWideGIF() */
+//
+// Draw sinks for AnimatedGIFT
+//
+struct SumSink
+{
+    void operator()(GIFDRAW *pDraw) { GIFDrawSum(pDraw); }
+};
+// checks the MakeWideGIF() pattern
+struct WideSink
+{
+    int iErrors, iLines;
+    WideSink() : iErrors(0), iLines(0) {}
+    void operator()(GIFDRAW *pDraw) {
+        for (int x=0; x<pDraw->iWidth; x++) {
+            if (pDraw->pPixels[x] != WIDE_PIXEL(x, pDraw->y)) iErrors++;
+        }
+        iLines++;
+    }
+};
+// the GIFDrawSum() checksum kept by each instance
+struct HashSink
+{
+    uint32_t u32Sum;
+    HashSink() : u32Sum(0) {}
+    void operator()(GIFDRAW *pDraw) {
+        for (int y=0; y<pDraw->iStripHeight; y++) {
+            uint8_t *s = &pDraw->pPixels[y * pDraw->iPitch];
+            u32Sum = (u32Sum * 31) + pDraw->y + y;
+            for (int x=0; x<pDraw->iWidth; x++) {
+                u32Sum = (u32Sum * 31) + s[x];
+            }
+        }
+    }
+};
+//
+// Line buffer and workspace allocator for setAllocator()
+//
+static int iAllocCount; // calls since the last reset
+void *GIFAlloc(uint32_t u32Size)
+{
+    iAllocCount++;
+    return malloc(u32Size);
+} /* GIFAlloc() */
+//
+// Pool lock for setWorkPoolLock() which counts its calls
+//
+static int iLockCalls, iLockDepth;
+void GIFPoolLockCount(void *pUser, int bLock)
+{
+    (void)pUser;
+    iLockCalls++;
+    iLockDepth += (bLock) ? 1 : -1;
+} /* GIFPoolLockCount() */
+//
+// Callback which decodes a frame of another instance (pUser) in the middle
+// of its own frame, while holding the only slot of a workspace pool
+//
+int iNestedRC;
+void GIFDrawNested(GIFDRAW *pDraw)
+{
+    if (pDraw->y == 0 && pDraw->pUser) {
+        iNestedRC = ((AnimatedGIF *)pDraw->pUser)->playFrame(false, NULL);
+    }
+} /* GIFDrawNested() */
+//
+// Callback which counts the pixels not matching the MakeWideGIF() pattern
+//
+int iWideErrors;
+void GIFDrawWide(GIFDRAW *pDraw)
+{
+    for (int x=0; x<pDraw->iWidth; x++) {
+        if (pDraw->pPixels[x] != WIDE_PIXEL(x, pDraw->y)) iWideErrors++;
+    }
+    iLineCount++;
+} /* GIFDrawWide() */
 
 //
 // Simple logging print
@@ -380,6 +563,1120 @@ int main(int argc, const char * argv[]) {
         iTotalFail++;
         GIFLOG(__LINE__, szTestName, " - FAILED");
     }
+    // Test 16 - SIMD merge/cook functions must match the generic C code
+    // each x86 kernel the CPU supports is forced in turn (setSIMD), with and without a
+    // transparent index, at lengths which leave a tail after the 16/32 pixel loops
+    szTestName = (char *)"GIF mergeTransparent/cookPixels output";
+    iTotal++;
+    GIFLOG(__LINE__, szTestName, szStart);
+    {
+        static const int iLens[] = {1, 15, 17, 31, 33, 47, 301};
+        uint8_t ucSrc[301], ucOld[301], ucDst1[301], ucDst2[301];
+        uint16_t usPal[256], usOut[301];
+        int iLevel, iTrans, iLen, k, bMatch = 1;
+        for (i=0; i<256; i++) usPal[i] = (uint16_t)rand();
+        for (i=0; i<301; i++) {
+            ucSrc[i] = (i % 3 == 0) ? 0x55 : (uint8_t)rand();
+            ucOld[i] = (uint8_t)rand();
+        }
+        ucSrc[7] = 0xff; // the last palette entry (excluded from the AVX2 gather)
+        for (iLevel=GIF_SIMD_NONE; iLevel<=GIF_SIMD_AVX2; iLevel++) {
+            if (AnimatedGIF::setSIMD(iLevel) != iLevel) continue; // not supported by this CPU
+            for (k=0; k<(int)(sizeof(iLens)/sizeof(iLens[0])); k++) {
+                iLen = iLens[k];
+                memcpy(ucDst1, ucOld, sizeof(ucDst1));
+                gif.mergeTransparent(ucSrc, ucDst1, 0x55, iLen);
+                for (i=0; i<301; i++) {
+                    ucDst2[i] = (i < iLen && ucSrc[i] != 0x55) ? ucSrc[i] : ucOld[i];
+                }
+                if (memcmp(ucDst1, ucDst2, sizeof(ucDst1)) != 0) bMatch = 0;
+                for (iTrans=-1; iTrans<=0x55; iTrans+=0x56) { // -1 (none) and 0x55
+                    memcpy(ucDst1, ucOld, sizeof(ucDst1));
+                    memset(usOut, 0, sizeof(usOut));
+                    gif.cookPixels(ucSrc, ucDst1, iTrans, iLen, (uint32_t *)usPal, usOut);
+                    for (i=0; i<301; i++) {
+                        uint8_t c = (i < iLen && ucSrc[i] != iTrans) ? ucSrc[i] : ucOld[i];
+                        if (ucDst1[i] != c || usOut[i] != ((i < iLen) ? usPal[c] : 0)) bMatch = 0;
+                    }
+                }
+            }
+        }
+        AnimatedGIF::setSIMD(GIF_SIMD_AUTO);
+        if (bMatch) {
+            iTotalPass++;
+            GIFLOG(__LINE__, szTestName, " - PASSED");
+        } else {
+            iTotalFail++;
+            GIFLOG(__LINE__, szTestName, " - FAILED");
+        }
+    }
+    // Test 17 - Turbo mode RAW output must match the classic decoder
+    szTestName = (char *)"GIF Turbo RAW output";
+    iTotal++;
+    GIFLOG(__LINE__, szTestName, szStart);
+    gif.begin(GIF_PALETTE_RGB565_LE);
+    if (gif.open((uint8_t *)earth_128x128, sizeof(earth_128x128), GIFDrawSum)) {
+        uint32_t u32Classic;
+        int iClassicLines;
+        u32Checksum = 0; iLineCount = 0;
+        gif.setDrawType(GIF_DRAW_RAW);
+        while (gif.playFrame(false, NULL)) {}
+        u32Classic = u32Checksum; iClassicLines = iLineCount;
+        gif.reset();
+        gif.allocTurboBuf();
+        u32Checksum = 0; iLineCount = 0;
+        while (gif.playFrame(false, NULL)) {}
+        gif.freeTurboBuf(free);
+        if (iLineCount > 0 && iLineCount == iClassicLines && u32Checksum == u32Classic) {
+            iTotalPass++;
+            GIFLOG(__LINE__, szTestName, " - PASSED");
+        } else {
+            iTotalFail++;
+            GIFLOG(__LINE__, szTestName, " - FAILED");
+        }
+    } else {
+        GIFLOG(__LINE__, szTestName, "Error opening GIF file.");
+    }
+    // Test 18 - Strip mode must deliver the same lines with fewer GIFDRAW calls
+    szTestName = (char *)"GIF strip mode output";
+    iTotal++;
+    GIFLOG(__LINE__, szTestName, szStart);
+    gif.begin(GIF_PALETTE_RGB565_LE);
+    if (gif.open((uint8_t *)earth_128x128, sizeof(earth_128x128), GIFDrawSum)) {
+        uint32_t u32Lines;
+        int iLines, iCalls, bPassed;
+        uint8_t *pStrip = (uint8_t *)malloc(16 * gif.getCanvasWidth());
+        u32Checksum = 0; iLineCount = iDrawCount = 0;
+        gif.setDrawType(GIF_DRAW_RAW);
+        while (gif.playFrame(false, NULL)) {}
+        u32Lines = u32Checksum; iLines = iLineCount; iCalls = iDrawCount;
+        gif.reset();
+        gif.setStripBuf(pStrip, 16); // 16 lines per call
+        u32Checksum = 0; iLineCount = iDrawCount = 0;
+        while (gif.playFrame(false, NULL)) {}
+        bPassed = (u32Checksum == u32Lines && iLineCount == iLines && iDrawCount < iCalls);
+        gif.reset();
+        gif.allocTurboBuf();
+        gif.setStripBuf(NULL, gif.getCanvasHeight()); // Turbo RAW sends the whole frame at once
+        u32Checksum = 0; iLineCount = iDrawCount = 0;
+        while (gif.playFrame(false, NULL)) {}
+        gif.freeTurboBuf(free);
+        gif.setStripBuf(NULL, 0);
+        free(pStrip);
+        if (bPassed && u32Checksum == u32Lines && iLineCount == iLines && iDrawCount < iCalls) {
+            iTotalPass++;
+            GIFLOG(__LINE__, szTestName, " - PASSED");
+        } else {
+            iTotalFail++;
+            GIFLOG(__LINE__, szTestName, " - FAILED");
+        }
+    } else {
+        GIFLOG(__LINE__, szTestName, "Error opening GIF file.");
+    }
+    // Test 19 - seekFrame() must decode the same data as sequential playback
+    szTestName = (char *)"GIF frame index and seek";
+    iTotal++;
+    GIFLOG(__LINE__, szTestName, szStart);
+    gif.begin(GIF_PALETTE_RGB565_LE);
+    if (gif.open((uint8_t *)earth_128x128, sizeof(earth_128x128), GIFDrawSum)) {
+        uint32_t *u32Frames;
+        int iCount, iFrames = 0, bPassed = 1;
+        GIFFRAME *pFrames;
+        gif.setDrawType(GIF_DRAW_RAW);
+        iCount = gif.buildIndex(NULL, 0);
+        pFrames = (GIFFRAME *)malloc(iCount * sizeof(GIFFRAME));
+        gif.buildIndex(pFrames, iCount);
+        u32Frames = (uint32_t *)malloc((iCount+1) * sizeof(uint32_t));
+        do { // checksum each frame in order
+            u32Checksum = 0;
+            i = gif.playFrame(false, NULL);
+            if (iFrames <= iCount) u32Frames[iFrames] = u32Checksum;
+            iFrames++;
+        } while (i > 0);
+        if (iFrames != iCount) bPassed = 0;
+        for (iFrame=iCount-1; iFrame>=0 && bPassed; iFrame -= 3) { // visit frames out of order
+            u32Checksum = 0;
+            if (gif.seekFrame(iFrame) != GIF_SUCCESS) bPassed = 0;
+            gif.playFrame(false, NULL);
+            if (u32Checksum != u32Frames[iFrame] || gif.getCurrentFrame() != iFrame+1) bPassed = 0;
+        }
+        if (gif.seekFrame(iCount) == GIF_SUCCESS) bPassed = 0; // out of range
+        free(pFrames);
+        free(u32Frames);
+        if (bPassed) {
+            iTotalPass++;
+            GIFLOG(__LINE__, szTestName, " - PASSED");
+        } else {
+            iTotalFail++;
+            GIFLOG(__LINE__, szTestName, " - FAILED");
+        }
+    } else {
+        GIFLOG(__LINE__, szTestName, "Error opening GIF file.");
+    }
+    // Test 20 - gotoFrame() must rebuild the same frame buffer as sequential playback
+    szTestName = (char *)"GIF keyframe snapshots and gotoFrame";
+    iTotal++;
+    GIFLOG(__LINE__, szTestName, szStart);
+    gif.begin(GIF_PALETTE_RGB565_LE);
+    if (gif.open((uint8_t *)earth_128x128, sizeof(earth_128x128), NULL)) {
+        uint32_t *u32Frames;
+        int iCount, iSize, bPassed = 1;
+        GIFFRAME *pFrames;
+        uint8_t *pSnapshots;
+        w = gif.getCanvasWidth();
+        h = gif.getCanvasHeight();
+        iSize = w * h * 3; // 8-bit canvas + RGB565 canvas
+        pFrameBuffer = (uint8_t *)malloc(iSize);
+        memset(pFrameBuffer, 0, iSize);
+        gif.setDrawType(GIF_DRAW_COOKED);
+        gif.setFrameBuf(pFrameBuffer);
+        iCount = gif.buildIndex(NULL, 0);
+        pFrames = (GIFFRAME *)malloc(iCount * sizeof(GIFFRAME));
+        gif.buildIndex(pFrames, iCount);
+        pSnapshots = (uint8_t *)malloc(4 * (iSize + 4)); // budget of 4 snapshots
+        gif.setSnapshotBuf(pSnapshots, 4 * (iSize + 4));
+        u32Frames = (uint32_t *)malloc(iCount * sizeof(uint32_t));
+        for (iFrame=0; iFrame<iCount; iFrame++) { // checksum the frame buffer after each frame
+            gif.playFrame(false, NULL);
+            u32Frames[iFrame] = 0;
+            for (i=0; i<iSize; i++) u32Frames[iFrame] = (u32Frames[iFrame] * 31) + pFrameBuffer[i];
+        }
+        for (iFrame=iCount-1; iFrame>=0 && bPassed; iFrame -= 7) { // visit frames out of order
+            uint32_t u32 = 0;
+            if (gif.gotoFrame(iFrame) != GIF_SUCCESS) bPassed = 0;
+            gif.playFrame(false, NULL);
+            for (i=0; i<iSize; i++) u32 = (u32 * 31) + pFrameBuffer[i];
+            if (u32 != u32Frames[iFrame]) bPassed = 0;
+        }
+        if (bPassed) { // replaying from frame 0 mustn't keep what was left in the frame buffer
+            uint8_t *pSmall = (uint8_t *)malloc(1024);
+            uint32_t u32Ref = 0, u32 = 0;
+            GIFFRAME frame;
+            int iLen = MakeWideGIF(pSmall, 32, 16);
+            pSmall[6] = 64; pSmall[8] = 32; // the frame only covers part of a 64x32 canvas
+            iSize = 64 * 32 * 3;
+            if (gif.open(pSmall, iLen, NULL) && gif.buildIndex(&frame, 1) == 1) {
+                memset(pFrameBuffer, 0, iSize); // the background color
+                gif.playFrame(false, NULL);
+                for (i=0; i<iSize; i++) u32Ref = (u32Ref * 31) + pFrameBuffer[i];
+                memset(pFrameBuffer, 0x5a, iSize);
+                if (gif.gotoFrame(0) != GIF_SUCCESS) bPassed = 0;
+                gif.playFrame(false, NULL);
+                for (i=0; i<iSize; i++) u32 = (u32 * 31) + pFrameBuffer[i];
+                if (u32 != u32Ref) bPassed = 0;
+            } else {
+                bPassed = 0;
+            }
+            free(pSmall);
+        }
+        free(u32Frames);
+        free(pSnapshots);
+        free(pFrames);
+        gif.setFrameBuf(NULL);
+        free(pFrameBuffer);
+        if (bPassed) {
+            iTotalPass++;
+            GIFLOG(__LINE__, szTestName, " - PASSED");
+        } else {
+            iTotalFail++;
+            GIFLOG(__LINE__, szTestName, " - FAILED");
+        }
+    } else {
+        GIFLOG(__LINE__, szTestName, "Error opening GIF file.");
+    }
+#ifdef __LINUX__
+    // Test 21 - Frame-parallel playback must produce the same output as playFrame()
+    szTestName = (char *)"GIF frame-parallel playback";
+    iTotal++;
+    GIFLOG(__LINE__, szTestName, szStart);
+    gif.begin(GIF_PALETTE_RGB565_LE);
+    if (gif.open((uint8_t *)earth_128x128, sizeof(earth_128x128), GIFDrawSum)) {
+        uint32_t u32Serial;
+        int iSerialLines, iFrames;
+        gif.setDrawType(GIF_DRAW_RAW);
+        u32Checksum = 0; iLineCount = 0;
+        while (gif.playFrame(false, NULL)) {}
+        u32Serial = u32Checksum; iSerialLines = iLineCount;
+        gif.reset();
+        u32Checksum = 0; iLineCount = 0;
+        iFrames = gif.playParallel(4);
+        if (iFrames > 0 && iLineCount == iSerialLines && u32Checksum == u32Serial) { // again with each line scaled on the way out
+            gif.begin(GIF_PALETTE_RGB565_LE);
+            gif.setScale(2);
+            gif.open((uint8_t *)earth_128x128, sizeof(earth_128x128), GIFDrawSum);
+            gif.setDrawType(GIF_DRAW_RAW);
+            u32Checksum = 0; iLineCount = 0;
+            iFrames = gif.playParallel(4); // before playFrame() has set up a line buffer
+            u32Serial = u32Checksum; iSerialLines = iLineCount;
+            gif.reset();
+            u32Checksum = 0; iLineCount = 0;
+            while (gif.playFrame(false, NULL)) {}
+            gif.close();
+        }
+        if (iFrames > 0 && iLineCount == iSerialLines && u32Checksum == u32Serial) {
+            iTotalPass++;
+            GIFLOG(__LINE__, szTestName, " - PASSED");
+        } else {
+            iTotalFail++;
+            GIFLOG(__LINE__, szTestName, " - FAILED");
+        }
+    } else {
+        GIFLOG(__LINE__, szTestName, "Error opening GIF file.");
+    }
+    // Test 22 - The decode-ahead ring must deliver every frame in order with the same canvas
+    szTestName = (char *)"GIF decode-ahead frame ring";
+    iTotal++;
+    GIFLOG(__LINE__, szTestName, szStart);
+    gif.begin(GIF_PALETTE_RGB565_LE);
+    if (gif.open((uint8_t *)earth_128x128, sizeof(earth_128x128), NULL)) {
+        uint32_t u32Serial[256];
+        int iSize, iFrames = 0, bPassed = 1;
+        GIFRINGFRAME frame;
+        w = gif.getCanvasWidth();
+        h = gif.getCanvasHeight();
+        iSize = w * h * 3; // 8-bit canvas + RGB565 canvas
+        pFrameBuffer = (uint8_t *)malloc(iSize);
+        memset(pFrameBuffer, 0, iSize);
+        gif.setDrawType(GIF_DRAW_COOKED);
+        gif.setFrameBuf(pFrameBuffer);
+        do {
+            i = gif.playFrame(false, NULL);
+            u32Checksum = 0;
+            for (int j=0; j<iSize; j++) u32Checksum = (u32Checksum * 31) + pFrameBuffer[j];
+            if (iFrames < 256) u32Serial[iFrames] = u32Checksum;
+            iFrames++;
+        } while (i > 0);
+        gif.reset();
+        gif.startDecodeAhead(4, 1); // play once with 4 frames of look-ahead
+        iFrame = 0;
+        while ((i = gif.getDecodedFrame(&frame)) >= 0 && bPassed) {
+            if (i == 0) continue; // not ready yet
+            u32Checksum = 0;
+            for (int j=0; j<iSize; j++) u32Checksum = (u32Checksum * 31) + frame.pCanvas[j];
+            if (frame.iFrame != iFrame || iFrame >= 256 || u32Checksum != u32Serial[iFrame] || frame.iX + frame.iWidth > w || frame.iY + frame.iHeight > h) bPassed = 0;
+            gif.releaseDecodedFrame();
+            iFrame++;
+        }
+        gif.stopDecodeAhead();
+        gif.setFrameBuf(NULL);
+        free(pFrameBuffer);
+        if (bPassed && iFrame == iFrames) {
+            iTotalPass++;
+            GIFLOG(__LINE__, szTestName, " - PASSED");
+        } else {
+            iTotalFail++;
+            GIFLOG(__LINE__, szTestName, " - FAILED");
+        }
+    } else {
+        GIFLOG(__LINE__, szTestName, "Error opening GIF file.");
+    }
+    // Test 23 - A memory mapped file must decode the same as the data in RAM
+    szTestName = (char *)"GIF memory mapped file";
+    iTotal++;
+    GIFLOG(__LINE__, szTestName, szStart);
+    {
+        const char *szTemp = "/tmp/gif_test_mapped.gif";
+        uint32_t u32RAM;
+        int iRAMLines;
+        FILE *f = fopen(szTemp, "wb");
+        if (f) {
+            fwrite(earth_128x128, 1, sizeof(earth_128x128), f);
+            fclose(f);
+        }
+        gif.begin(GIF_PALETTE_RGB565_LE);
+        gif.open((uint8_t *)earth_128x128, sizeof(earth_128x128), GIFDrawSum);
+        u32Checksum = 0; iLineCount = 0;
+        while (gif.playFrame(false, NULL)) {}
+        gif.close();
+        u32RAM = u32Checksum; iRAMLines = iLineCount;
+        if (f && gif.openMapped(szTemp, GIFDrawSum)) {
+            u32Checksum = 0; iLineCount = 0;
+            while (gif.playFrame(false, NULL)) {}
+            gif.close();
+            if (iLineCount == iRAMLines && u32Checksum == u32RAM) {
+                iTotalPass++;
+                GIFLOG(__LINE__, szTestName, " - PASSED");
+            } else {
+                iTotalFail++;
+                GIFLOG(__LINE__, szTestName, " - FAILED");
+            }
+        } else {
+            iTotalFail++;
+            GIFLOG(__LINE__, szTestName, "Error opening GIF file.");
+        }
+        remove(szTemp);
+    }
+    // Test 24 - Slab reads must decode the same data with fewer read callbacks
+    szTestName = (char *)"GIF buffered slab reads";
+    iTotal++;
+    GIFLOG(__LINE__, szTestName, szStart);
+    {
+        const char *szTemp = "/tmp/gif_test_slab.gif";
+        uint32_t u32Plain;
+        int32_t iPlainReads;
+        uint8_t *pSlab = (uint8_t *)malloc(4096);
+        FILE *f = fopen(szTemp, "wb");
+        if (f) {
+            fwrite(earth_128x128, 1, sizeof(earth_128x128), f);
+            fclose(f);
+        }
+        gif.begin(GIF_PALETTE_RGB565_LE);
+        if (f && gif.open(szTemp, GIFDrawSum)) {
+            u32Checksum = 0;
+            while (gif.playFrame(false, NULL)) {}
+            gif.close();
+            u32Plain = u32Checksum; iPlainReads = gif.getReadCount();
+            gif.open(szTemp, GIFDrawSum);
+            gif.setReadBuf(pSlab, 4096);
+            u32Checksum = 0;
+            while (gif.playFrame(false, NULL)) {}
+            gif.close();
+            if (u32Checksum == u32Plain && gif.getReadCount() * 10 < iPlainReads) {
+                iTotalPass++;
+                GIFLOG(__LINE__, szTestName, " - PASSED");
+            } else {
+                iTotalFail++;
+                GIFLOG(__LINE__, szTestName, " - FAILED");
+            }
+        } else {
+            iTotalFail++;
+            GIFLOG(__LINE__, szTestName, "Error opening GIF file.");
+        }
+        gif.setReadBuf(NULL, 0);
+        free(pSlab);
+        remove(szTemp);
+    }
+    // Test 25 - A fast GIF container must decode the same as the original file
+    szTestName = (char *)"GIF fast container";
+    iTotal++;
+    GIFLOG(__LINE__, szTestName, szStart);
+    {
+        uint32_t u32Plain;
+        int32_t iFastSize = 0;
+        uint8_t *pFast = NULL;
+        gif.begin(GIF_PALETTE_RGB565_LE);
+        if (gif.open((uint8_t *)earth_128x128, sizeof(earth_128x128), GIFDrawSum)) {
+            u32Checksum = 0;
+            for (i=0; i<40; i++) gif.playFrame(false, NULL);
+            iFastSize = gif.writeFast(NULL, 0); // playback carries on where it was
+            if (gif.getCurrentFrame() != 40) iFastSize = 0;
+            while (gif.playFrame(false, NULL)) {}
+            u32Plain = u32Checksum;
+            pFast = (uint8_t *)malloc(iFastSize ? iFastSize : 1);
+            if (pFast && iFastSize && gif.writeFast(pFast, iFastSize - 1) == 0 && gif.writeFast(pFast, iFastSize) == iFastSize) {
+                gif.close();
+                gif.begin(GIF_PALETTE_RGB565_LE);
+                gif.openFast(pFast, iFastSize, GIFDrawSum);
+                u32Checksum = 0;
+                while (gif.playFrame(false, NULL)) {}
+            } else {
+                u32Checksum = ~u32Plain;
+            }
+            gif.close();
+            if (u32Checksum == u32Plain && gif.buildIndex(NULL, 0) == 103) {
+                iTotalPass++;
+                GIFLOG(__LINE__, szTestName, " - PASSED");
+            } else {
+                iTotalFail++;
+                GIFLOG(__LINE__, szTestName, " - FAILED");
+            }
+        } else {
+            iTotalFail++;
+            GIFLOG(__LINE__, szTestName, "Error opening GIF file.");
+        }
+        free(pFast);
+    }
+#endif // __LINUX__
+    // Test 26 - Frames replayed from the decoded frame cache must match live decoding
+    szTestName = (char *)"GIF decoded frame cache";
+    iTotal++;
+    GIFLOG(__LINE__, szTestName, szStart);
+    gif.begin(GIF_PALETTE_RGB565_LE);
+    if (gif.open((uint8_t *)earth_128x128, sizeof(earth_128x128), NULL)) {
+        uint32_t *u32Frames;
+        int iCount, iSize, iPass, iBudget, bPassed = 1;
+        uint8_t *pBake;
+        w = gif.getCanvasWidth();
+        h = gif.getCanvasHeight();
+        iSize = w * h * 3; // 8-bit canvas + RGB565 canvas
+        pFrameBuffer = (uint8_t *)malloc(iSize);
+        memset(pFrameBuffer, 0, iSize);
+        gif.setDrawType(GIF_DRAW_COOKED);
+        gif.setFrameBuf(pFrameBuffer);
+        iCount = gif.buildIndex(NULL, 0);
+        u32Frames = (uint32_t *)malloc(iCount * sizeof(uint32_t));
+        for (iFrame=0; iFrame<iCount; iFrame++) { // live checksums of a second pass
+            gif.playFrame(false, NULL);
+        }
+        for (iFrame=0; iFrame<iCount; iFrame++) {
+            gif.playFrame(false, NULL);
+            u32Frames[iFrame] = 0;
+            for (i=0; i<iSize; i++) u32Frames[iFrame] = (u32Frames[iFrame] * 31) + pFrameBuffer[i];
+        }
+        pBake = (uint8_t *)malloc(4 * 1024 * 1024);
+        for (iBudget = 4 * 1024 * 1024; iBudget >= 1024 * 1024; iBudget -= 3 * 1024 * 1024) { // everything fits, then part of it
+            gif.setBakeBuf(pBake, iBudget);
+            for (iPass=0; iPass<4; iPass++) { // a full pass, the recorded pass, two replays
+                for (iFrame=0; iFrame<iCount; iFrame++) {
+                    uint32_t u32 = 0;
+                    gif.playFrame(false, NULL);
+                    for (i=0; i<iSize; i++) u32 = (u32 * 31) + pFrameBuffer[i];
+                    if (u32 != u32Frames[iFrame]) bPassed = 0;
+                }
+            }
+            if (iBudget > 1024 * 1024 && gif.getBakedFrames() != iCount) bPassed = 0;
+            if (iBudget == 1024 * 1024 && (gif.getBakedFrames() == 0 || gif.getBakedFrames() >= iCount)) bPassed = 0; // the rest is decoded live
+        }
+        gif.setBakeBuf(NULL, 0);
+        free(pBake);
+        free(u32Frames);
+        gif.setFrameBuf(NULL);
+        free(pFrameBuffer);
+        if (bPassed) {
+            iTotalPass++;
+            GIFLOG(__LINE__, szTestName, " - PASSED");
+        } else {
+            iTotalFail++;
+            GIFLOG(__LINE__, szTestName, " - FAILED");
+        }
+    } else {
+        GIFLOG(__LINE__, szTestName, "Error opening GIF file.");
+    }
+    // Test 27 - The dirty rectangle must cover every pixel which changed and nothing when the canvas didn't change
+    szTestName = (char *)"GIF dirty rectangle";
+    iTotal++;
+    GIFLOG(__LINE__, szTestName, szStart);
+    gif.begin(GIF_PALETTE_RGB565_LE);
+    if (gif.open((uint8_t *)earth_128x128, sizeof(earth_128x128), NULL)) {
+        int iSize, x, y, dx, dy, dw, dh, bPassed = 1;
+        uint8_t *pOld;
+        w = gif.getCanvasWidth();
+        h = gif.getCanvasHeight();
+        iSize = w * h * 3; // 8-bit canvas + RGB565 canvas
+        pFrameBuffer = (uint8_t *)malloc(iSize);
+        pOld = (uint8_t *)malloc(iSize);
+        memset(pFrameBuffer, 0, iSize);
+        memset(pOld, 0, iSize);
+        gif.setDrawType(GIF_DRAW_COOKED);
+        gif.setFrameBuf(pFrameBuffer);
+        for (iFrame=0; iFrame<120 && bPassed; iFrame++) { // the first frames of a second loop too
+            gif.playFrame(false, NULL);
+            gif.getDirtyRect(&dx, &dy, &dw, &dh);
+            for (y=0; y<h; y++) {
+                for (x=0; x<w; x++) {
+                    int bChanged = (pFrameBuffer[y*w + x] != pOld[y*w + x]) || memcmp(&pFrameBuffer[w*h + (y*w + x)*2], &pOld[w*h + (y*w + x)*2], 2);
+                    if (bChanged && (x < dx || x >= dx + dw || y < dy || y >= dy + dh)) bPassed = 0;
+                }
+            }
+            memcpy(pOld, pFrameBuffer, iSize);
+        }
+        gif.close();
+        gif.setFrameBuf(NULL);
+        free(pFrameBuffer);
+        free(pOld);
+        // a single frame file played twice doesn't change the canvas the second time
+        gif.begin(GIF_PALETTE_RGB565_LE);
+        if (gif.open((uint8_t *)green, sizeof(green), NULL)) {
+            w = gif.getCanvasWidth();
+            h = gif.getCanvasHeight();
+            pFrameBuffer = (uint8_t *)malloc(w * h * 3);
+            memset(pFrameBuffer, 0, w * h * 3);
+            gif.setDrawType(GIF_DRAW_COOKED);
+            gif.setFrameBuf(pFrameBuffer);
+            gif.playFrame(false, NULL);
+            if (!gif.getDirtyRect(&dx, &dy, &dw, &dh) || dw != w || dh != h) bPassed = 0;
+            gif.playFrame(false, NULL);
+            if (gif.getDirtyRect(&dx, &dy, &dw, &dh) || dw != 0) bPassed = 0;
+            gif.close();
+            gif.setFrameBuf(NULL);
+            free(pFrameBuffer);
+        } else {
+            bPassed = 0;
+        }
+        if (bPassed) {
+            iTotalPass++;
+            GIFLOG(__LINE__, szTestName, " - PASSED");
+        } else {
+            iTotalFail++;
+            GIFLOG(__LINE__, szTestName, " - FAILED");
+        }
+    } else {
+        GIFLOG(__LINE__, szTestName, "Error opening GIF file.");
+    }
+    // Test 28 - Opaque span lists must match the pixels and fully transparent lines must be skipped
+    szTestName = (char *)"GIF opaque span lists";
+    iTotal++;
+    GIFLOG(__LINE__, szTestName, szStart);
+    gif.begin(GIF_PALETTE_RGB565_LE);
+    if (gif.open((uint8_t *)homer_tiny, sizeof(homer_tiny), GIFDrawSum)) {
+        uint16_t usSpans[1024];
+        int iAllLines;
+        gif.setDrawType(GIF_DRAW_RAW);
+        iLineCount = 0;
+        while (gif.playFrame(false, NULL)) {};
+        iAllLines = iLineCount;
+        gif.close();
+        gif.open((uint8_t *)homer_tiny, sizeof(homer_tiny), GIFDrawSpans);
+        gif.setDrawType(GIF_DRAW_RAW);
+        gif.setSpanBuf(usSpans, sizeof(usSpans) / (2 * sizeof(uint16_t)));
+        iLineCount = iSpanErrors = 0;
+        while (gif.playFrame(false, NULL)) {};
+        gif.close();
+        gif.setSpanBuf(NULL, 0);
+        if (iSpanErrors == 0 && iLineCount > 0 && iLineCount < iAllLines) {
+            iTotalPass++;
+            GIFLOG(__LINE__, szTestName, " - PASSED");
+        } else {
+            iTotalFail++;
+            GIFLOG(__LINE__, szTestName, " - FAILED");
+        }
+    } else {
+        GIFLOG(__LINE__, szTestName, "Error opening GIF file.");
+    }
+    // Test 29 - Compare-on-write must produce the same display as converting every pixel
+    szTestName = (char *)"GIF compare-on-write";
+    iTotal++;
+    GIFLOG(__LINE__, szTestName, szStart);
+    gif.begin(GIF_PALETTE_RGB565_LE);
+    if (gif.open((uint8_t *)homer_tiny, sizeof(homer_tiny), GIFDrawCopySpans)) {
+        static AnimatedGIF gifRef;
+        uint16_t usSpans[1024];
+        uint8_t *pRefBuffer;
+        int bPassed = 1;
+        w = gif.getCanvasWidth();
+        h = gif.getCanvasHeight();
+        pFrameBuffer = (uint8_t *)calloc(1, w * (h+2)); // 8-bit canvas + 1 line of cooked pixels
+        pRefBuffer = (uint8_t *)calloc(1, w * h * 3); // 8-bit canvas + RGB565 canvas
+        pDisplay = (uint16_t *)calloc(1, w * h * 2);
+        gif.setDrawType(GIF_DRAW_COOKED);
+        gif.setFrameBuf(pFrameBuffer);
+        gif.setSpanBuf(usSpans, sizeof(usSpans) / (2 * sizeof(uint16_t)));
+        gif.setCompareOnWrite(1);
+        gifRef.begin(GIF_PALETTE_RGB565_LE);
+        gifRef.open((uint8_t *)homer_tiny, sizeof(homer_tiny), NULL);
+        gifRef.setDrawType(GIF_DRAW_COOKED);
+        gifRef.setFrameBuf(pRefBuffer);
+        iLineCount = 0;
+        for (iFrame=0; iFrame<64 && bPassed; iFrame++) { // a second loop too
+            gif.playFrame(false, NULL);
+            gifRef.playFrame(false, NULL);
+            if (memcmp(pDisplay, &pRefBuffer[w*h], w * h * 2) != 0) bPassed = 0;
+        }
+        gif.close();
+        gifRef.close();
+        gif.setCompareOnWrite(0);
+        gif.setSpanBuf(NULL, 0);
+        gif.setFrameBuf(NULL);
+        free(pFrameBuffer);
+        free(pRefBuffer);
+        free(pDisplay);
+        if (bPassed && iLineCount > 0) {
+            iTotalPass++;
+            GIFLOG(__LINE__, szTestName, " - PASSED");
+        } else {
+            iTotalFail++;
+            GIFLOG(__LINE__, szTestName, " - FAILED");
+        }
+    } else {
+        GIFLOG(__LINE__, szTestName, "Error opening GIF file.");
+    }
+    // Test 30 - A 1/2 scaled canvas must match every other pixel of the full size canvas
+    szTestName = (char *)"GIF downscaled output";
+    iTotal++;
+    GIFLOG(__LINE__, szTestName, szStart);
+    gif.begin(GIF_PALETTE_RGB565_LE);
+    gif.setScale(2);
+    if (gif.open((uint8_t *)earth_128x128, sizeof(earth_128x128), NULL)) {
+        static AnimatedGIF gifRef;
+        uint8_t *pRefBuffer;
+        int x, y, W, bPassed = 1;
+        w = gif.getCanvasWidth();
+        h = gif.getCanvasHeight();
+        gifRef.begin(GIF_PALETTE_RGB565_LE);
+        gifRef.open((uint8_t *)earth_128x128, sizeof(earth_128x128), NULL);
+        W = gifRef.getCanvasWidth();
+        if (w != (W+1)/2 || h != (gifRef.getCanvasHeight()+1)/2) bPassed = 0;
+        pFrameBuffer = (uint8_t *)calloc(1, w * h * 3); // 8-bit canvas + RGB565 canvas
+        pRefBuffer = (uint8_t *)calloc(1, W * gifRef.getCanvasHeight() * 3);
+        gif.setDrawType(GIF_DRAW_COOKED);
+        gif.setFrameBuf(pFrameBuffer);
+        gifRef.setDrawType(GIF_DRAW_COOKED);
+        gifRef.setFrameBuf(pRefBuffer);
+        for (iFrame=0; iFrame<8 && bPassed; iFrame++) {
+            gif.playFrame(false, NULL);
+            gifRef.playFrame(false, NULL);
+            for (y=0; y<h && bPassed; y++) {
+                for (x=0; x<w; x++) {
+                    if (pFrameBuffer[(y*w)+x] != pRefBuffer[(y*2*W)+(x*2)]) bPassed = 0;
+                }
+            }
+        }
+        gif.close();
+        gifRef.close();
+        gif.setFrameBuf(NULL);
+        free(pFrameBuffer);
+        free(pRefBuffer);
+        if (bPassed) {
+            iTotalPass++;
+            GIFLOG(__LINE__, szTestName, " - PASSED");
+        } else {
+            iTotalFail++;
+            GIFLOG(__LINE__, szTestName, " - FAILED");
+        }
+    } else {
+        GIFLOG(__LINE__, szTestName, "Error opening GIF file.");
+    }
+    // Test 31 - A viewport must limit the drawn lines and leave the visible canvas unchanged
+    szTestName = (char *)"GIF viewport";
+    iTotal++;
+    GIFLOG(__LINE__, szTestName, szStart);
+    gif.begin(GIF_PALETTE_RGB565_LE);
+    if (gif.open((uint8_t *)earth_128x128, sizeof(earth_128x128), GIFDrawSum)) {
+        static AnimatedGIF gifRef;
+        uint8_t *pRefBuffer;
+        int x, y, bPassed = 1;
+        w = gif.getCanvasWidth();
+        h = gif.getCanvasHeight();
+        pFrameBuffer = (uint8_t *)calloc(1, w * h);
+        pRefBuffer = (uint8_t *)calloc(1, w * h);
+        gif.setFrameBuf(pFrameBuffer);
+        gif.setViewport(16, 24, 32, 40);
+        gifRef.begin(GIF_PALETTE_RGB565_LE);
+        gifRef.open((uint8_t *)earth_128x128, sizeof(earth_128x128), GIFDraw);
+        gifRef.setFrameBuf(pRefBuffer);
+        iLineCount = 0;
+        for (iFrame=0; iFrame<8 && bPassed; iFrame++) {
+            gif.playFrame(false, NULL);
+            gifRef.playFrame(false, NULL);
+            for (y=24; y<24+40; y++) {
+                for (x=16; x<16+32; x++) {
+                    if (pFrameBuffer[(y*w)+x] != pRefBuffer[(y*w)+x]) bPassed = 0;
+                }
+            }
+        }
+        gif.close();
+        gifRef.close();
+        gif.setFrameBuf(NULL);
+        free(pFrameBuffer);
+        free(pRefBuffer);
+        if (bPassed && iLineCount > 0 && iLineCount <= 40 * iFrame) {
+            iTotalPass++;
+            GIFLOG(__LINE__, szTestName, " - PASSED");
+        } else {
+            iTotalFail++;
+            GIFLOG(__LINE__, szTestName, " - FAILED");
+        }
+    } else {
+        GIFLOG(__LINE__, szTestName, "Error opening GIF file.");
+    }
+    // Test 32 - Stretched output must sample the cooked canvas after every frame
+    szTestName = (char *)"GIF stretched output";
+    iTotal++;
+    GIFLOG(__LINE__, szTestName, szStart);
+    gif.begin(GIF_PALETTE_RGB565_LE);
+    if (gif.open((uint8_t *)earth_128x128, sizeof(earth_128x128), NULL)) {
+        uint32_t u32Table[100 + 75];
+        uint16_t *pCooked, *pOut;
+        int x, y, bPassed = 1;
+        w = gif.getCanvasWidth();
+        h = gif.getCanvasHeight();
+        pFrameBuffer = (uint8_t *)calloc(1, w * h * 3); // 8-bit canvas + RGB565 canvas
+        pCooked = (uint16_t *)&pFrameBuffer[w * h];
+        pOut = (uint16_t *)calloc(1, 100 * 75 * 2);
+        gif.setDrawType(GIF_DRAW_COOKED);
+        gif.setFrameBuf(pFrameBuffer);
+        if (gif.setStretch(pOut, 100, 75, 100 * 2, GIF_SCALE_NEAREST, u32Table) != GIF_SUCCESS) bPassed = 0;
+        for (iFrame=0; iFrame<8 && bPassed; iFrame++) {
+            gif.playFrame(false, NULL);
+            for (y=0; y<75; y++) {
+                for (x=0; x<100; x++) {
+                    if (pOut[(y*100)+x] != pCooked[(((2*y+1)*h)/150)*w + ((2*x+1)*w)/200]) bPassed = 0;
+                }
+            }
+        }
+        gif.close();
+        gif.setStretch(NULL, 0, 0, 0, 0, NULL);
+        gif.setFrameBuf(NULL);
+        free(pFrameBuffer);
+        free(pOut);
+        if (bPassed) {
+            iTotalPass++;
+            GIFLOG(__LINE__, szTestName, " - PASSED");
+        } else {
+            iTotalFail++;
+            GIFLOG(__LINE__, szTestName, " - FAILED");
+        }
+    } else {
+        GIFLOG(__LINE__, szTestName, "Error opening GIF file.");
+    }
+    // Test 33 - Cached local palettes must give the same pixels and be used in place
+    szTestName = (char *)"GIF converted palette cache";
+    iTotal++;
+    GIFLOG(__LINE__, szTestName, szStart);
+    gif.begin(GIF_PALETTE_RGB565_LE);
+    if (gif.open((uint8_t *)earth_128x128, sizeof(earth_128x128), GIFDrawPalette)) {
+        static AnimatedGIF gifRef;
+        static GIFPALSLOT palSlots[4];
+        uint8_t *pRefBuffer;
+        int bPassed = 1;
+        w = gif.getCanvasWidth();
+        h = gif.getCanvasHeight();
+        pFrameBuffer = (uint8_t *)calloc(1, w * h);
+        pRefBuffer = (uint8_t *)calloc(1, w * h * 3); // 8-bit canvas + RGB565 canvas
+        gif.setFrameBuf(pFrameBuffer);
+        if (gif.setPaletteCache(palSlots, sizeof(palSlots)) != GIF_SUCCESS) bPassed = 0;
+        gifRef.begin(GIF_PALETTE_RGB565_LE);
+        gifRef.open((uint8_t *)earth_128x128, sizeof(earth_128x128), NULL);
+        gifRef.setDrawType(GIF_DRAW_COOKED);
+        gifRef.setFrameBuf(pRefBuffer);
+        for (iFrame=0; iFrame<16 && bPassed; iFrame++) {
+            pLastPalette = NULL;
+            gif.playFrame(false, NULL);
+            gifRef.playFrame(false, NULL);
+            if (memcmp(pFrameBuffer, pRefBuffer, w * h) != 0) bPassed = 0;
+            // every frame after the first one has a local color table
+            if (iFrame > 0 && ((uint8_t *)pLastPalette < (uint8_t *)palSlots || (uint8_t *)pLastPalette >= (uint8_t *)&palSlots[4])) bPassed = 0;
+        }
+        gif.close();
+        gifRef.close();
+        gif.setPaletteCache(NULL, 0);
+        gif.setFrameBuf(NULL);
+        free(pFrameBuffer);
+        free(pRefBuffer);
+        if (bPassed) {
+            iTotalPass++;
+            GIFLOG(__LINE__, szTestName, " - PASSED");
+        } else {
+            iTotalFail++;
+            GIFLOG(__LINE__, szTestName, " - FAILED");
+        }
+    } else {
+        GIFLOG(__LINE__, szTestName, "Error opening GIF file.");
+    }
+    // Test 34 - A canvas wider than MAX_WIDTH gets a line buffer from setLineBuf(), the allocator or malloc
+    szTestName = (char *)"GIF runtime line buffer";
+    iTotal++;
+    GIFLOG(__LINE__, szTestName, szStart);
+    {
+        const int iWideW = MAX_WIDTH + 1000, iWideH = 3;
+        uint8_t *pWide = (uint8_t *)malloc(64 + iWideW * iWideH); // more than the 4.5 bits per pixel needed
+        uint8_t *pLine = (uint8_t *)malloc(iWideW + 15);
+        int iWideSize = MakeWideGIF(pWide, iWideW, iWideH);
+        int bPassed = 1;
+        gif.begin(GIF_PALETTE_RGB565_LE);
+        // a line buffer from the allocator, from malloc (freed with free), then the caller's
+        gif.setAllocator(GIFAlloc, free);
+        for (i=0; i<3; i++) {
+            iWideErrors = iLineCount = 0;
+            if (!gif.open(pWide, iWideSize, GIFDrawWide)) {
+                bPassed = 0;
+                break;
+            }
+            gif.playFrame(false, NULL);
+            gif.close();
+            if (iWideErrors || iLineCount != iWideH) bPassed = 0;
+            gif.setAllocator(NULL, NULL);
+            if (i == 1)
+                gif.setLineBuf(pLine, iWideW + 15);
+        }
+        gif.setLineBuf(NULL, 0);
+        free(pWide);
+        free(pLine);
+        if (bPassed) {
+            iTotalPass++;
+            GIFLOG(__LINE__, szTestName, " - PASSED");
+        } else {
+            iTotalFail++;
+            GIFLOG(__LINE__, szTestName, " - FAILED");
+        }
+    }
+    // Test 35 - AnimatedGIFT sends the same lines to its sink and decodes up to MaxWidth pixels on its own
+    szTestName = (char *)"GIF template class with a draw sink";
+    iTotal++;
+    GIFLOG(__LINE__, szTestName, szStart);
+    {
+        const int iWideW = MAX_WIDTH + 1000, iWideH = 3;
+        static AnimatedGIFT<SumSink> gifSum;
+        static AnimatedGIFT<WideSink, MAX_WIDTH + 1000> gifWide;
+        uint8_t *pWide = (uint8_t *)malloc(64 + iWideW * iWideH);
+        int iWideSize = MakeWideGIF(pWide, iWideW, iWideH);
+        uint32_t u32Ref;
+        int bPassed = 1;
+        // the sink gets the same lines as the draw callback of AnimatedGIF
+        u32Checksum = 0;
+        gif.begin(GIF_PALETTE_RGB565_LE);
+        if (!gif.open((uint8_t *)earth_128x128, sizeof(earth_128x128), GIFDrawSum)) bPassed = 0;
+        while (gif.playFrame(false, NULL) > 0) {}
+        gif.close();
+        u32Ref = u32Checksum;
+        u32Checksum = 0;
+        gifSum.begin(GIF_PALETTE_RGB565_LE);
+        if (!gifSum.open((uint8_t *)earth_128x128, sizeof(earth_128x128))) bPassed = 0;
+        while (gifSum.playFrame(false) > 0) {}
+        gifSum.close();
+        if (u32Checksum != u32Ref) bPassed = 0;
+        // a canvas wider than MAX_WIDTH fits in the template's own line buffer
+        gifWide.begin(GIF_PALETTE_RGB565_LE);
+        if (!gifWide.open(pWide, iWideSize)) bPassed = 0;
+        gifWide.playFrame(false);
+        gifWide.close();
+        if (gifWide.sink().iErrors || gifWide.sink().iLines != iWideH) bPassed = 0;
+#ifndef GIF_SPLIT_WORKSPACE
+        // a narrow one uses the line buffer in GIFIMAGE instead of carrying another
+        if (sizeof(AnimatedGIFT<HashSink, 64>) > sizeof(AnimatedGIF) + sizeof(HashSink) + 8) bPassed = 0;
+#endif
+        free(pWide);
+        if (bPassed) {
+            iTotalPass++;
+            GIFLOG(__LINE__, szTestName, " - PASSED");
+        } else {
+            iTotalFail++;
+            GIFLOG(__LINE__, szTestName, " - FAILED");
+        }
+    }
+    // Test 36 - The workspace is sized for the decode mode and (GIF_SPLIT_WORKSPACE) only allocated to decode a frame
+    szTestName = (char *)"GIF workspace per decode mode";
+    iTotal++;
+    GIFLOG(__LINE__, szTestName, szStart);
+    {
+        int32_t iClassic, iTurbo;
+        uint8_t *pWork;
+        uint32_t u32Ref;
+        int bPassed = 1;
+        u32Checksum = 0;
+        gif.begin(GIF_PALETTE_RGB565_LE);
+        gif.setAllocator(GIFAlloc, free);
+        iAllocCount = 0;
+        if (!gif.open((uint8_t *)earth_128x128, sizeof(earth_128x128), GIFDrawSum)) bPassed = 0;
+        iClassic = gif.getWorkspaceSize();
+        if (iClassic != (int32_t)offsetof(GIFWORK, ucLineBuf) + 128 + 15) bPassed = 0;
+        if (gif.allocTurboBuf(GIFAlloc) != GIF_SUCCESS) bPassed = 0;
+        iTurbo = gif.getWorkspaceSize();
+        if (iTurbo < LZW_BUF_SIZE_TURBO || iTurbo > (int32_t)sizeof(GIFWORK) + 16) bPassed = 0;
+        gif.freeTurboBuf(free);
+        iAllocCount = 0; // the Turbo buffer
+        while (gif.playFrame(false, NULL) > 0) {}
+        u32Ref = u32Checksum;
+        pWork = (uint8_t *)malloc(iClassic);
+#ifdef GIF_SPLIT_WORKSPACE
+        if (iAllocCount != 1) bPassed = 0; // one classic workspace, reused for every frame
+        gif.close();
+        // the caller's memory is used instead
+        u32Checksum = 0;
+        iAllocCount = 0;
+        if (gif.setWorkspace(pWork, iClassic) != GIF_SUCCESS) bPassed = 0;
+        if (!gif.open((uint8_t *)earth_128x128, sizeof(earth_128x128), GIFDrawSum)) bPassed = 0;
+        while (gif.playFrame(false, NULL) > 0) {}
+        if (iAllocCount || u32Checksum != u32Ref) bPassed = 0;
+        gif.setWorkspace(NULL, 0);
+#else
+        if (u32Ref == 0 || iAllocCount || gif.setWorkspace(pWork, iClassic) != GIF_UNSUPPORTED_FEATURE) bPassed = 0; // built into GIFIMAGE
+#endif
+        gif.close();
+        gif.setAllocator(NULL, NULL);
+        free(pWork);
+        if (bPassed) {
+            iTotalPass++;
+            GIFLOG(__LINE__, szTestName, " - PASSED");
+        } else {
+            iTotalFail++;
+            GIFLOG(__LINE__, szTestName, " - FAILED");
+        }
+    }
+    // Test 37 - Instances sharing a workspace pool borrow it for one frame at a time
+    szTestName = (char *)"GIF shared workspace pool";
+    iTotal++;
+    GIFLOG(__LINE__, szTestName, szStart);
+    {
+        static AnimatedGIFT<HashSink> gifs[3];
+        int32_t iPoolSize = AnimatedGIF::getWorkPoolSize(1);
+        uint8_t *pPoolMem = (uint8_t *)malloc(iPoolSize);
+        GIFWORKPOOL *pPool;
+        uint32_t u32Ref;
+        int bPassed = 1;
+        gifs[0].begin(GIF_PALETTE_RGB565_LE);
+        if (!gifs[0].open((uint8_t *)earth_128x128, sizeof(earth_128x128))) bPassed = 0;
+        while (gifs[0].playFrame(false) > 0) {}
+        gifs[0].close();
+        u32Ref = gifs[0].sink().u32Sum;
+        if (AnimatedGIF::initWorkPool(pPoolMem, iPoolSize - 1, 1) != NULL) bPassed = 0; // too small
+        pPool = AnimatedGIF::initWorkPool(pPoolMem, iPoolSize, 1);
+        if (pPool == NULL) bPassed = 0;
+#ifdef GIF_SPLIT_WORKSPACE
+        else {
+            int iMore;
+            iAllocCount = 0;
+            for (i=0; i<3; i++) {
+                gifs[i].begin(GIF_PALETTE_RGB565_LE);
+                gifs[i].setAllocator(GIFAlloc, free);
+                gifs[i].sink().u32Sum = 0;
+                if (gifs[i].setWorkPool(pPool) != GIF_SUCCESS) bPassed = 0;
+                if (!gifs[i].open((uint8_t *)earth_128x128, sizeof(earth_128x128))) bPassed = 0;
+            }
+            // one workspace for three animations, passed on after every frame
+            do {
+                iMore = 0;
+                for (i=0; i<3; i++) {
+                    iMore += (gifs[i].playFrame(false) > 0);
+                }
+            } while (iMore);
+            for (i=0; i<3; i++) {
+                if (gifs[i].sink().u32Sum != u32Ref) bPassed = 0;
+                gifs[i].close();
+            }
+            if (iAllocCount) bPassed = 0;
+            // a frame started while the only slot is taken uses its own workspace
+            // instead of waiting (forever, on one thread) for it to come back
+            {
+                static AnimatedGIF outer, inner;
+                AnimatedGIF::setWorkPoolLock(pPool, GIFPoolLockCount, NULL);
+                iLockCalls = iLockDepth = 0;
+                iNestedRC = -2;
+                outer.begin(GIF_PALETTE_RGB565_LE);
+                inner.begin(GIF_PALETTE_RGB565_LE);
+                inner.setAllocator(GIFAlloc, free);
+                outer.setWorkPool(pPool);
+                inner.setWorkPool(pPool);
+                if (!outer.open((uint8_t *)earth_128x128, sizeof(earth_128x128), GIFDrawNested)) bPassed = 0;
+                if (!inner.open((uint8_t *)earth_128x128, sizeof(earth_128x128), GIFDraw)) bPassed = 0;
+                if (outer.playFrame(false, NULL, &inner) < 0) bPassed = 0;
+                if (iNestedRC < 0 || iAllocCount != 1) bPassed = 0;
+                if (iLockCalls == 0 || iLockDepth != 0) bPassed = 0;
+                outer.close();
+                inner.close();
+                AnimatedGIF::setWorkPoolLock(pPool, NULL, NULL);
+            }
+        }
+#else
+        else if (u32Ref == 0 || gifs[0].setWorkPool(pPool) != GIF_UNSUPPORTED_FEATURE) bPassed = 0; // built into GIFIMAGE
+#endif
+        AnimatedGIF::closeWorkPool(pPool);
+        free(pPoolMem);
+        if (bPassed) {
+            iTotalPass++;
+            GIFLOG(__LINE__, szTestName, " - PASSED");
+        } else {
+            iTotalFail++;
+            GIFLOG(__LINE__, szTestName, " - FAILED");
+        }
+    }
+    // Test 38 - A file fed in small pieces decodes the same as from memory, drawing rows before a frame is complete
+    szTestName = (char *)"GIF push mode (feed)";
+    iTotal++;
+    GIFLOG(__LINE__, szTestName, szStart);
+    {
+        static AnimatedGIFT<HashSink> ref, push;
+        static uint8_t ucFeedBuf[1024];
+        GIFFEEDINFO info;
+        int iPass, iStep, iRC, iFrames, iFirstRow;
+        int32_t iFed;
+        int bPassed = 1;
+        ref.begin(GIF_PALETTE_RGB565_LE);
+        if (!ref.open((uint8_t *)earth_128x128, sizeof(earth_128x128))) bPassed = 0;
+        while (ref.playFrame(false) > 0) {}
+        for (iPass=0; iPass<2; iPass++) { // pieces of 1 to 97 bytes, then one byte at a time
+            push.begin(GIF_PALETTE_RGB565_LE);
+            push.sink().u32Sum = 0;
+            if (!push.openFeed(ucFeedBuf, (int32_t)sizeof(ucFeedBuf))) bPassed = 0;
+            iFed = 0; iFrames = 0; iFirstRow = 0; iRC = 1;
+            for (i=0; iRC == 1 && iFed < (int32_t)sizeof(earth_128x128); i++) {
+                iStep = (iPass == 0) ? (i % 97) + 1 : 1;
+                if (iStep > (int32_t)sizeof(earth_128x128) - iFed) iStep = (int32_t)sizeof(earth_128x128) - iFed;
+                iRC = push.feed((const uint8_t *)&earth_128x128[iFed], iStep, &info);
+                iFed += iStep;
+                iFrames += info.iFrames;
+                if (iFirstRow == 0 && info.iRows) iFirstRow = iFed;
+                if (iFed >= 13 && push.getCanvasWidth() != ref.getCanvasWidth()) bPassed = 0;
+                if (iPass == 1 && iFed == 5000) { // the other ways of decoding are refused while feeding
+                    if (push.playFrame(false) != -1 || push.getLastError() != GIF_INVALID_PARAMETER) bPassed = 0;
+                    if (push.seekFrame(0) != GIF_INVALID_PARAMETER || push.gotoFrame(0) != GIF_INVALID_PARAMETER) bPassed = 0;
+                }
+            }
+            if (iRC != 0 || iFrames != ref.getCurrentFrame() || push.sink().u32Sum != ref.sink().u32Sum) bPassed = 0;
+            if (iFirstRow == 0 || iFirstRow > 2048) bPassed = 0; // the first sub-block is enough to start
+            push.close();
+        }
+        ref.close();
+        // not a GIF
+        push.begin(GIF_PALETTE_RGB565_LE);
+        push.openFeed(ucFeedBuf, (int32_t)sizeof(ucFeedBuf));
+        if (push.feed((const uint8_t *)"PNG image data", 14) != -1 || push.getLastError() != GIF_BAD_FILE) bPassed = 0;
+        if (bPassed) {
+            iTotalPass++;
+            GIFLOG(__LINE__, szTestName, " - PASSED");
+        } else {
+            iTotalFail++;
+            GIFLOG(__LINE__, szTestName, " - FAILED");
+        }
+    }
+    // Test 39 - Frames decoded a few rows (or microseconds) at a time match whole frames
+    szTestName = (char *)"GIF time-sliced decoding (decodeStep)";
+    iTotal++;
+    GIFLOG(__LINE__, szTestName, szStart);
+    {
+        static AnimatedGIFT<HashSink> ref, gifs[2];
+        int iRC[2] = {1, 1}, iSteps[2] = {0, 0};
+        int bPassed = 1;
+        ref.begin(GIF_PALETTE_RGB565_LE);
+        if (!ref.open((uint8_t *)earth_128x128, sizeof(earth_128x128))) bPassed = 0;
+        while (ref.playFrame(false) > 0) {}
+        for (i=0; i<2; i++) {
+            gifs[i].begin(GIF_PALETTE_RGB565_LE);
+            if (!gifs[i].open((uint8_t *)earth_128x128, sizeof(earth_128x128))) bPassed = 0;
+        }
+        gifs[1].allocTurboBuf(); // steps use the classic decoder
+        // two animations taking turns: 5 rows or 100us per step
+        while (iRC[0] > 0 || iRC[1] > 0) {
+            if (iRC[0] > 0) { iRC[0] = gifs[0].decodeStep(5, 0); iSteps[0] += (iRC[0] == 2); }
+            if (iRC[1] > 0) { iRC[1] = gifs[1].decodeStep(0, 100); iSteps[1] += (iRC[1] == 2); }
+        }
+        for (i=0; i<2; i++) {
+            if (iRC[i] != 0 || gifs[i].getCurrentFrame() != ref.getCurrentFrame() || gifs[i].sink().u32Sum != ref.sink().u32Sum) bPassed = 0;
+        }
+        if (iSteps[0] < ref.getCurrentFrame() * ((ref.getCanvasHeight() / 5) - 1)) bPassed = 0; // stopped every 5 rows
+        if (gifs[0].decodeStep(-1, 0) != -1 || gifs[0].getLastError() != GIF_INVALID_PARAMETER) bPassed = 0;
+        { // seeking or playing drops an unfinished step frame
+            const int iSize = 128 * 128 * 3, iCount = 103;
+            static GIFFRAME frames[iCount];
+            static uint32_t u32Frames[iCount];
+            uint8_t *pBuf = (uint8_t *)calloc(1, iSize);
+            int iFrame;
+            gifs[0].setDrawType(GIF_DRAW_COOKED);
+            gifs[0].setFrameBuf(pBuf);
+            gifs[0].reset();
+            if (gifs[0].buildIndex(frames, iCount) != iCount) bPassed = 0;
+            for (iFrame=0; iFrame<iCount; iFrame++) { // checksum the frame buffer after each frame
+                gifs[0].playFrame(false);
+                u32Frames[iFrame] = 0;
+                for (i=0; i<iSize; i++) u32Frames[iFrame] = (u32Frames[iFrame] * 31) + pBuf[i];
+            }
+            for (iFrame=0; iFrame<3 && bPassed; iFrame++) {
+                uint32_t u32 = 0;
+                int iWant = 20 + iFrame;
+                if (gifs[0].decodeStep(5, 0) != 2) bPassed = 0;
+                if (iFrame == 0) gifs[0].gotoFrame(iWant);
+                else if (iFrame == 1) gifs[0].seekFrame(iWant); // every frame of earth covers the canvas
+                else iWant = gifs[0].getCurrentFrame(); // playFrame() decodes the whole frame again
+                gifs[0].playFrame(false);
+                for (i=0; i<iSize; i++) u32 = (u32 * 31) + pBuf[i];
+                if (u32 != u32Frames[iWant] || gifs[0].getCurrentFrame() != iWant + 1) bPassed = 0;
+            }
+            gifs[0].setFrameBuf(NULL);
+            free(pBuf);
+        }
+        gifs[1].freeTurboBuf(free);
+        for (i=0; i<2; i++) {
+            gifs[i].close();
+        }
+        ref.close();
+        if (bPassed) {
+            iTotalPass++;
+            GIFLOG(__LINE__, szTestName, " - PASSED");
+        } else {
+            iTotalFail++;
+            GIFLOG(__LINE__, szTestName, " - FAILED");
+        }
+    }
     printf("Total tests: %d, %d passed, %d failed\n", iTotal, iTotalPass, iTotalFail);
 
     return 0;
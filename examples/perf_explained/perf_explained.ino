@@ -29,6 +29,7 @@ uint8_t *pFrameBuffer;
 int iXOff, iYOff;
 bool bDMA = false;
 static uint8_t *pDMA;
+static uint16_t usSpans[2 * ((320+1)/2)]; // room for the worst case list of opaque spans of a 320 pixel line
 //
 // This version of GIFDraw manages the transparent pixels and palette
 // changes by depending on the display (external) framebuffer to hold
@@ -40,6 +41,9 @@ static uint8_t *pDMA;
 // between commands and data takes a lot of time. It's much faster to
 // just write continuous runs of pixels without stopping to move the
 // write pointer.
+// When the decoder provides a list of opaque spans (setSpanBuf), we don't
+// need to search for the runs ourselves and fully transparent lines
+// don't even reach this function.
 //
 void GIFDrawSlow(GIFDRAW *pDraw)
 {
@@ -64,7 +68,18 @@ void GIFDrawSlow(GIFDRAW *pDraw)
     }
 
     // Apply the new pixels to the main image
-    if (pDraw->ucHasTransparency) // if transparency used
+    if (pDraw->ucHasTransparency && pDraw->pSpans) // the decoder found the opaque runs for us
+    {
+      for (int i=0; i<pDraw->iSpanCount; i++)
+      {
+        int iStart = pDraw->pSpans[i*2], iCount = pDraw->pSpans[i*2+1];
+        for (x=0; x<iCount; x++)
+          usTemp[x] = usPalette[s[iStart + x]];
+        lcd.setAddrWindow(pDraw->iX+iStart+iXOff, y+iYOff, iCount, 1);
+        lcd.pushPixels(usTemp, iCount);
+      }
+    }
+    else if (pDraw->ucHasTransparency) // if transparency used
     {
       uint8_t *pEnd, c, ucTransparent = pDraw->ucTransparent;
       int x, iCount;
@@ -163,12 +178,14 @@ void setup()
     iXOff = (lcd.width() - w)/2; // center on the LCD
     iYOff = (lcd.height() - h)/2;
     gif.setDrawType(GIF_DRAW_RAW);
+    gif.setSpanBuf(usSpans, sizeof(usSpans) / (2 * sizeof(uint16_t)));
     iFrame = 0;
     lTime = millis();
     while (gif.playFrame(false, NULL)) {
         iFrame++;
     } // play unthrottled to measure the speed
     gif.close();
+    gif.setSpanBuf(NULL, 0); // the next demos set the address window once per frame and need every line
     lTime = millis() - lTime;
   }
   lcd.setCursor(0, lcd.height() - 16);
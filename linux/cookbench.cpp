@@ -0,0 +1,83 @@
+//
+// cookbench - time the cooked line conversion (DrawCooked) for each
+// palette type on opaque lines, lines with transparent pixels and
+// lines restored to the background color (disposal method 2)
+//
+// usage: cookbench [line width] [iterations]
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../src/AnimatedGIF.cpp" // the line functions are static
+
+static const char *szPaletteNames[] = {"rgb565le", "rgb565be", "rgb888", "rgb8888", "1bpp", "1bpp_oled"};
+static const char *szModeNames[] = {"opaque", "transparent", "dispose"};
+static GIFIMAGE gif;
+
+static int64_t Micros(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts); // not counting time given to other processes
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+} /* Micros() */
+
+int main(int argc, char *argv[])
+{
+    int i, y, iType, iMode, iIter, iTrial;
+    int iWidth = (argc > 1) ? atoi(argv[1]) : 480;
+    int iIterations = (argc > 2) ? atoi(argv[2]) : 200;
+    const int iHeight = 16;
+    uint8_t *pFrame, *pLines, *pCooked;
+    int64_t iTime, iBest;
+    GIFDRAW gd;
+
+    if (iWidth < 8 || iWidth > 8192 || iIterations < 1) {
+        printf("usage: cookbench [line width (8-8192)] [iterations]\n");
+        return -1;
+    }
+    pFrame = (uint8_t *)malloc(iWidth * iHeight * 2 + iWidth); // 8-bit canvas + 1-bpp output
+    pLines = (uint8_t *)malloc(iWidth * iHeight);
+    pCooked = (uint8_t *)malloc(iWidth * iHeight * 4);
+    srand(1);
+    for (i=0; i<iWidth * iHeight; i++) {
+        pLines[i] = (i % 5 == 0) ? 0x55 : (uint8_t)rand(); // 1 in 5 pixels is transparent
+    }
+    printf("%d x %d pixels, %d iterations\n", iWidth, iHeight, iIterations);
+    for (iType = GIF_PALETTE_RGB565_LE; iType <= GIF_PALETTE_1BPP_OLED; iType++) {
+        for (iMode = 0; iMode < 3; iMode++) {
+            memset(&gif, 0, sizeof(gif));
+            gif.ucPaletteType = (uint8_t)iType;
+            for (i=0; i<(int)sizeof(gif.pPalette)/2; i++) {
+                gif.pPalette[i] = (iType >= GIF_PALETTE_1BPP) ? (uint16_t)(rand() & 0x0101) : (uint16_t)rand();
+            }
+            gif.pFrameBuffer = pFrame;
+            gif.iCanvasWidth = gif.iWidth = (uint16_t)iWidth;
+            gif.iCanvasHeight = gif.iHeight = (uint16_t)iHeight;
+            gif.ucTransparent = 0x55;
+            gif.ucGIFBits = (iMode == 0) ? 0 : ((iMode == 2) ? 0x09 : 0x01); // disposal method 2 + transparency flag
+            GIFInitDraw(&gif, &gd);
+            iBest = 0;
+            for (iTrial=0; iTrial<25; iTrial++) { // keep the best of 25 runs
+                iTime = Micros();
+                for (iIter=0; iIter<iIterations; iIter++) {
+                    for (y=0; y<iHeight; y++) {
+                        gd.y = y;
+                        gd.pPixels = &pLines[y * iWidth];
+                        DrawCooked(&gif, &gd, &pCooked[y * iWidth * 4]);
+                    }
+                }
+                iTime = Micros() - iTime;
+                if (iBest == 0 || iTime < iBest)
+                    iBest = iTime;
+            }
+            iTime = iBest;
+            printf("%-10s %-12s %8.1f Mpixels/s\n", szPaletteNames[iType], szModeNames[iMode],
+                   (double)iWidth * iHeight * iIterations / (double)(iTime ? iTime : 1));
+        }
+    }
+    free(pFrame);
+    free(pLines);
+    free(pCooked);
+    return 0;
+} /* main() */
@@ -23,6 +23,7 @@
 GIFIMAGE gif;
 int iGIFWidth, iGIFHeight;
 uint8_t *pGIFBuf;
+uint32_t *pStretchTable;
 
 struct fb_var_screeninfo vinfo;
 struct fb_fix_screeninfo finfo;
@@ -38,91 +39,26 @@ void my_handler(int signal)
 } /* my_handler() */
 
 //
-// Display a GIF frame on the framebuffer
+// The library stretches the canvas straight into the display memory as
+// R,G,B,A bytes; most 32-bpp framebuffers want B,G,R,A, so swap the
+// red and blue bytes of the pixels which were just updated
 //
-void ShowFrame(int bFullscreen)
+void ShowFrame(void)
 {
-uint32_t ulPixel=0, *pul;
-uint8_t *s, *pPal;
-int pixel, x, y;
+uint8_t *d, c;
+int x, y, iX, iY, iWidth, iHeight;
 
-	if (bFullscreen) { // stretch to fit
-	int iFracX, iFracY; // x/y stretch fractions
-	int newpixel, iAccumX, iAccumY;
-	iFracX = (iGIFWidth * 256) / iScreenWidth;
-	iFracY = (iGIFHeight * 256) / iScreenHeight;
-	iAccumY = 0;
-	for (y=0; y<iScreenHeight; y++) {
-		pul = (uint32_t *)&fbp[iPitch * y];
-		s = &pGIFBuf[(iAccumY>>8) * iGIFWidth];
-		iAccumY += iFracY;
-		iAccumX = 0;
-		pixel = -1;
-		for (x=0; x<iScreenWidth; x++) {
-			newpixel = s[(iAccumX >> 8)];
-			if (newpixel != pixel) {
-				pixel = newpixel;
-				pPal = (uint8_t *)&gif.pPalette;
-				pPal += pixel * 3;
-				ulPixel = 0xff000000 | (pPal[0] << 16) | (pPal[1] << 8) | pPal[2];
-			}
-			*pul++ = ulPixel;
-			iAccumX += iFracX;
-		}
-	} // for y
-        } else { // draw 1:1
-	for (y=0; y<iGIFHeight; y++) {
-		pul = (uint32_t *)&fbp[iPitch * y];
-		s = &pGIFBuf[y * iGIFWidth];
-		for (x=0; x<iGIFWidth; x++) {
-			pixel = *s++;
-			pPal = (uint8_t *)&gif.pPalette;
-			pPal += pixel * 3;
-			ulPixel = 0xff000000 | (pPal[0] << 16) | (pPal[1] << 8) | pPal[2];
-			*pul++ = ulPixel;
-		}
-	} // for y
-	} // 1:1
+    if (vinfo.bits_per_pixel != 32 || vinfo.red.offset == 0)
+        return; // already in the right order
+    GIF_getStretchRect(&gif, &iX, &iY, &iWidth, &iHeight);
+    for (y=iY; y<iY+iHeight; y++) {
+        d = &fbp[(iPitch * y) + (iX * 4)];
+        for (x=0; x<iWidth; x++) {
+            c = d[0]; d[0] = d[2]; d[2] = c;
+            d += 4;
+        }
+    } // for y
 } /* ShowFrame() */
-//
-// Callback from GIF library for each line decoded
-//
-void GIFDraw(GIFDRAW *pDraw)
-{
-uint8_t *s, *d;
-int x, y;
-
-    y = pDraw->iY + pDraw->y; // current line
-    s = pDraw->pPixels;
-    d = &pGIFBuf[pDraw->iX + (y * iGIFWidth)];
-    if (pDraw->ucDisposalMethod == 2) // restore to background color
-    {
-      for (x=0; x<pDraw->iWidth; x++)
-      {
-        if (s[x] == pDraw->ucTransparent)
-           s[x] = pDraw->ucBackground;
-      }
-      pDraw->ucHasTransparency = 0;
-    }
-    // Apply the new pixels to the main image
-    if (pDraw->ucHasTransparency) // if transparency used
-    {
-      uint8_t c, ucTransparent = pDraw->ucTransparent;
-      for (x=0; x < pDraw->iWidth; x++)
-      {
-          c = *s++;
-          if (c != ucTransparent)
-          {
-            d[x] = c; 
-          }
-      }
-    }
-    else
-    {
-      s = pDraw->pPixels;
-      memcpy(d, s, pDraw->iWidth);
-    }
-} /* GIFDraw() */
 
 int main(int argc, const char * argv[]) {
 int screensize, fbfd = 0, rc;
@@ -169,30 +105,35 @@ struct sigaction sigIntHandler;
        return -1;
     }
 
-    GIF_begin(&gif, BIG_ENDIAN_PIXELS);
+    GIF_begin(&gif, (vinfo.bits_per_pixel == 16) ? GIF_PALETTE_RGB565_LE : GIF_PALETTE_RGB8888);
     printf("Starting GIF decoder...\n");
     if (argc == 2) // use filename
-        rc = GIF_openFile(&gif, argv[1], GIFDraw);
+        rc = GIF_openFile(&gif, argv[1], NULL);
     else
-        rc = GIF_openRAM(&gif, (uint8_t *)ucBadgers, sizeof(ucBadgers), GIFDraw);
+        rc = GIF_openRAM(&gif, (uint8_t *)ucBadgers, sizeof(ucBadgers), NULL);
     if (rc)
     {
         printf("Successfully opened GIF\n");
 	iGIFWidth = GIF_getCanvasWidth(&gif);
 	iGIFHeight = GIF_getCanvasHeight(&gif);
         printf("Image size: %d x %d\n", iGIFWidth, iGIFHeight);
-	gif.ucDrawType = GIF_DRAW_RAW; // we want the original 8-bit pixels
-	gif.ucPaletteType = GIF_PALETTE_RGB888;
-	// Allocate a buffer to hold the current GIF frame
-	pGIFBuf = malloc(iGIFWidth * iGIFHeight);
+	gif.ucDrawType = GIF_DRAW_COOKED; // the library keeps the whole converted canvas
+	// Allocate a buffer to hold the current GIF frame (8-bit canvas + converted pixels)
+	pGIFBuf = malloc(iGIFWidth * iGIFHeight * (1 + vinfo.bits_per_pixel/8));
+	gif.pFrameBuffer = pGIFBuf;
+	// stretch to fit; only the changed part of the screen is redone each frame
+	pStretchTable = malloc((iScreenWidth + iScreenHeight) * sizeof(uint32_t));
+	GIF_setStretch(&gif, fbp, iScreenWidth, iScreenHeight, iPitch, GIF_SCALE_NEAREST, pStretchTable);
         while (!iStop) {
 	    int iDelay;
 	    while (GIF_playFrame(&gif, &iDelay, NULL)) {
-		    ShowFrame(1);
+		    ShowFrame();
 		    // usleep(iDelay * 1000);
             }
 	} // waiting for CTRL-C
         GIF_close(&gif);
+        free(pStretchTable);
+        free(pGIFBuf);
     }
     // Cleanup
     munmap(fbp, screensize);
@@ -58,29 +58,44 @@ int main(int argc, char *argv[])
 	return EXIT_FAILURE;
     }
     pOld = canvas->pixels; // keep old pixel pointer; we will substitute our own
-    canvas->pixels = &pFrameBuf[w * h]; // point to the pixels the library will generate
     winSurface = SDL_GetWindowSurface(win);
     
     bool bQuit = false;
     int iLoopCount = gif.getLoopCount();
     if (iLoopCount == 0) iLoopCount = 5; // infinite->5
-    for (int i=0; i<iLoopCount && !bQuit; i++) {
-        while (!bQuit && gif.playFrame(false, &rc, NULL)) {
-            SDL_Rect rect;
-            SDL_Event e;
-            while (SDL_PollEvent(&e)) { // take care of queued events
-                if (e.type == SDL_QUIT || e.type == SDL_KEYDOWN) {
-                    bQuit = true;
-                }
+    // Decode on a background thread and keep 4 composed frames ready
+    // so that slow frames don't show up as jitter
+    gif.startDecodeAhead(4, iLoopCount);
+    Uint32 u32Deadline = SDL_GetTicks();
+    while (!bQuit) {
+        GIFRINGFRAME frame;
+        SDL_Rect rect;
+        SDL_Event e;
+        while (SDL_PollEvent(&e)) { // take care of queued events
+            if (e.type == SDL_QUIT || e.type == SDL_KEYDOWN) {
+                bQuit = true;
             }
-            rect.x = gif.getFrameXOff(); rect.y = gif.getFrameYOff();
-            rect.w = gif.getFrameWidth(); rect.h = gif.getFrameHeight();
+        }
+        rc = gif.getDecodedFrame(&frame);
+        if (rc < 0) break; // no more frames
+        Sint32 iWait = (rc == 0) ? 1 : (Sint32)(u32Deadline - SDL_GetTicks()); // decoder behind: look again shortly
+        if (iWait > 0) { // sleep until the frame is due, waking early for input
+            if (SDL_WaitEventTimeout(&e, iWait) && (e.type == SDL_QUIT || e.type == SDL_KEYDOWN)) {
+                bQuit = true;
+            }
+            continue;
+        }
+        if (frame.iWidth) { // only the pixels which changed value (the dirty rect) are copied
+            canvas->pixels = &frame.pCanvas[w * h]; // point to the pixels the library generated
+            rect.x = frame.iX; rect.y = frame.iY;
+            rect.w = frame.iWidth; rect.h = frame.iHeight;
             SDL_BlitSurface(canvas, &rect, winSurface, &rect);
             SDL_UpdateWindowSurface(win);
-	    SDL_Delay(rc);
         }
-        gif.reset();
-    } // for i
+        gif.releaseDecodedFrame();
+        u32Deadline += frame.iDelay;
+    }
+    gif.stopDecodeAhead();
 
     // Clean up
     canvas->pixels = pOld; // restore original pointer
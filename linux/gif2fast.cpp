@@ -0,0 +1,66 @@
+//
+// gif2fast - convert a GIF file into a "fast GIF" container
+// The container can be played with AnimatedGIF::openFast() without
+// de-chunking the LZW data or converting the palettes at run time
+//
+// usage: gif2fast <input.gif> <output.fgif> [palette type]
+// palette types: rgb565le (default), rgb565be, rgb888, rgb8888, 1bpp, 1bpp_oled
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "AnimatedGIF.h"
+
+static AnimatedGIF gif;
+
+static const char *szPaletteNames[] = {"rgb565le", "rgb565be", "rgb888", "rgb8888", "1bpp", "1bpp_oled", NULL};
+
+int main(int argc, char *argv[])
+{
+    int i, iPaletteType = GIF_PALETTE_RGB565_LE;
+    int32_t iSize;
+    uint8_t *pOut;
+    FILE *oHandle;
+
+    if (argc < 3 || argc > 4) {
+        printf("usage: gif2fast <input.gif> <output.fgif> [rgb565le|rgb565be|rgb888|rgb8888|1bpp|1bpp_oled]\n");
+        return -1;
+    }
+    if (argc == 4) {
+        for (i=0; szPaletteNames[i] != NULL; i++) {
+            if (strcmp(argv[3], szPaletteNames[i]) == 0)
+                break;
+        }
+        if (szPaletteNames[i] == NULL) {
+            printf("Unknown palette type: %s\n", argv[3]);
+            return -1;
+        }
+        iPaletteType = i;
+    }
+    gif.begin((uint8_t)iPaletteType);
+    if (!gif.open(argv[1], NULL)) {
+        printf("Error opening file %s\n", argv[1]);
+        return -1;
+    }
+    iSize = gif.writeFast(NULL, 0);
+    pOut = (iSize) ? (uint8_t *)malloc(iSize) : NULL;
+    if (pOut == NULL || gif.writeFast(pOut, iSize) != iSize) {
+        printf("Error converting %s (error %d)\n", argv[1], gif.getLastError());
+        gif.close();
+        free(pOut);
+        return -1;
+    }
+    gif.close();
+    oHandle = fopen(argv[2], "wb");
+    if (oHandle == NULL || fwrite(pOut, 1, iSize, oHandle) != (size_t)iSize) {
+        printf("Error writing file %s\n", argv[2]);
+        if (oHandle)
+            fclose(oHandle);
+        free(pOut);
+        return -1;
+    }
+    fclose(oHandle);
+    printf("%s: %d bytes\n", argv[2], (int)iSize);
+    free(pOut);
+    return 0;
+} /* main() */
@@ -0,0 +1,72 @@
+//
+// gifstream - decode a GIF as it arrives through a pipe (push mode)
+// The file is read from stdin in pieces and passed to AnimatedGIF::feed();
+// rows are drawn as soon as their data has arrived. A slow link can be
+// simulated by giving the piece size and a delay between pieces.
+//
+// usage: gifstream [bytes per piece] [ms between pieces] < input.gif
+// e.g. cat earth.gif | gifstream 64 2
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "AnimatedGIF.h"
+
+static AnimatedGIF gif;
+static uint8_t ucFeedBuf[4096]; // the largest header plus a couple of sub-blocks
+static int64_t iStartUs;
+
+static int64_t MicroSeconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+} /* MicroSeconds() */
+
+static void GIFDraw(GIFDRAW *pDraw)
+{
+    (void)pDraw; // a display would get the line here
+} /* GIFDraw() */
+
+int main(int argc, char *argv[])
+{
+    int iPiece = (argc > 1) ? atoi(argv[1]) : 256;
+    int iDelay = (argc > 2) ? atoi(argv[2]) : 0;
+    int rc = 1, iFrame = -1;
+    int64_t iTotal = 0, iFirstRow = -1;
+    uint8_t *pPiece;
+    GIFFEEDINFO info;
+    ssize_t iLen;
+
+    if (argc > 3 || iPiece < 1 || iDelay < 0) {
+        printf("usage: gifstream [bytes per piece] [ms between pieces] < input.gif\n");
+        return -1;
+    }
+    pPiece = (uint8_t *)malloc(iPiece);
+    gif.begin(GIF_PALETTE_RGB565_LE);
+    gif.openFeed(ucFeedBuf, (int32_t)sizeof(ucFeedBuf), GIFDraw);
+    iStartUs = MicroSeconds();
+    while (rc == 1 && (iLen = read(0, pPiece, iPiece)) > 0) {
+        rc = gif.feed(pPiece, (int32_t)iLen, &info);
+        iTotal += iLen;
+        if (info.iRows && iFirstRow < 0)
+            iFirstRow = iTotal;
+        if (info.iFrames)
+            printf("%8.3fs %10lld bytes: frame %d finished\n", (MicroSeconds() - iStartUs) / 1e6, (long long)iTotal, info.iFrame - 1);
+        if (info.iFrameRows && info.iFrame != iFrame) { // the start of a frame is showing
+            printf("%8.3fs %10lld bytes: frame %d, first %d rows\n", (MicroSeconds() - iStartUs) / 1e6, (long long)iTotal, info.iFrame, info.iFrameRows);
+            iFrame = info.iFrame;
+        }
+        if (iDelay)
+            usleep(iDelay * 1000);
+    }
+    if (rc < 0)
+        printf("error %d after %lld bytes\n", gif.getLastError(), (long long)iTotal);
+    else
+        printf("%d frames from %lld bytes, first row after %lld bytes\n", gif.getCurrentFrame(), (long long)iTotal, (long long)iFirstRow);
+    gif.close();
+    free(pPiece);
+    return (rc < 0) ? -1 : 0;
+} /* main() */
@@ -0,0 +1,166 @@
+//
+// membench - memory used by many open decoders at once
+// Each mode opens the same GIF in every instance: info only (open and
+// getInfo), classic or Turbo (one frame decoded) and a fast GIF container
+// in Turbo mode. The instances and everything they allocate are counted.
+// Build it with and without GIF_SPLIT_WORKSPACE (make membench membench_split)
+// to compare the two layouts. The split build also decodes the classic
+// instances from POOL_THREADS threads sharing a pool of POOL_THREADS workspaces.
+//
+// usage: membench [instances]
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "../src/AnimatedGIF.cpp" // built with the GIF_SPLIT_WORKSPACE setting of this program
+#include "../test_images/earth_128x128.h"
+
+enum {
+    MODE_INFO = 0,
+    MODE_CLASSIC,
+    MODE_TURBO,
+    MODE_FAST_TURBO,
+    MODE_POOLED,
+    MODE_COUNT
+};
+static const char *szModeNames[] = {"info only", "classic", "Turbo", "fast GIF Turbo", "classic, pooled"};
+#define POOL_THREADS 4
+
+typedef struct thread_tag
+{
+    pthread_t tid;
+    AnimatedGIF **pGIFs;
+    int iCount;
+} THREAD;
+static int64_t iHeapBytes; // allocated through CountAlloc() and still in use
+
+static void *CountAlloc(uint32_t u32Size)
+{
+    uint32_t *p = (uint32_t *)malloc(u32Size + 8);
+    if (p == NULL)
+        return NULL;
+    p[0] = u32Size;
+    iHeapBytes += u32Size;
+    return &p[2];
+} /* CountAlloc() */
+
+static void CountFree(void *p)
+{
+    uint32_t *pBlock = (uint32_t *)p - 2;
+    if (p == NULL)
+        return;
+    iHeapBytes -= pBlock[0];
+    free(pBlock);
+} /* CountFree() */
+
+static void GIFDraw(GIFDRAW *pDraw)
+{
+    (void)pDraw; // only the memory matters
+} /* GIFDraw() */
+//
+// Decode the first frame of a share of the instances
+//
+static void *PlayThread(void *pArg)
+{
+    THREAD *pT = (THREAD *)pArg;
+    for (int i=0; i<pT->iCount; i++) {
+        pT->pGIFs[i]->playFrame(false, NULL);
+    }
+    return NULL;
+} /* PlayThread() */
+
+int main(int argc, char *argv[])
+{
+    int i, iMode;
+    int iCount = (argc > 1) ? atoi(argv[1]) : 1000;
+    int32_t iFastSize;
+    uint8_t *pFast;
+    AnimatedGIF **pGIFs;
+    GIFINFO info;
+    int64_t iTurbo, iOther;
+    THREAD threads[POOL_THREADS];
+    GIFWORKPOOL *pPool = NULL;
+    int32_t iPoolSize;
+    void *pPoolMem = NULL;
+
+    if (iCount < 1) {
+        printf("usage: membench [instances]\n");
+        return -1;
+    }
+    pGIFs = (AnimatedGIF **)calloc(iCount, sizeof(AnimatedGIF *));
+    pGIFs[0] = new AnimatedGIF; // convert the test image to a fast GIF container
+    pGIFs[0]->begin(GIF_PALETTE_RGB565_LE);
+    pGIFs[0]->open((uint8_t *)earth_128x128, sizeof(earth_128x128), GIFDraw);
+    iFastSize = pGIFs[0]->writeFast(NULL, 0);
+    pFast = (uint8_t *)malloc(iFastSize);
+    pGIFs[0]->writeFast(pFast, iFastSize);
+    pGIFs[0]->close();
+    delete pGIFs[0];
+#ifdef GIF_SPLIT_WORKSPACE
+    printf("GIF_SPLIT_WORKSPACE: sizeof(GIFIMAGE) = %d, workspace allocated per mode\n", (int)sizeof(GIFIMAGE));
+#else
+    printf("built-in workspace: sizeof(GIFIMAGE) = %d, sizeof(GIFWORK) = %d\n", (int)sizeof(GIFIMAGE), (int)sizeof(GIFWORK));
+#endif
+    printf("%d instances, %dx%d canvas\n", iCount, 128, 128);
+    printf("%-16s %12s %12s %12s %12s %10s\n", "mode", "instances", "workspace", "Turbo bufs", "total", "per inst");
+    for (iMode = 0; iMode < MODE_COUNT; iMode++) {
+        iHeapBytes = 0;
+        if (iMode == MODE_POOLED) {
+#ifndef GIF_SPLIT_WORKSPACE
+            break; // the workspace is part of each instance
+#endif
+            iPoolSize = AnimatedGIF::getWorkPoolSize(POOL_THREADS);
+            pPoolMem = CountAlloc(iPoolSize);
+            pPool = AnimatedGIF::initWorkPool(pPoolMem, iPoolSize, POOL_THREADS);
+        }
+        for (i=0; i<iCount; i++) {
+            AnimatedGIF *pGIF = new AnimatedGIF;
+            pGIF->begin(GIF_PALETTE_RGB565_LE);
+            pGIF->setAllocator(CountAlloc, CountFree);
+            if (pPool)
+                pGIF->setWorkPool(pPool);
+            if (iMode == MODE_FAST_TURBO)
+                pGIF->openFast(pFast, iFastSize, GIFDraw);
+            else
+                pGIF->open((uint8_t *)earth_128x128, sizeof(earth_128x128), GIFDraw);
+            if (iMode == MODE_INFO) {
+                pGIF->getInfo(&info);
+            } else if (iMode != MODE_POOLED) {
+                if (iMode != MODE_CLASSIC)
+                    pGIF->allocTurboBuf(CountAlloc);
+                pGIF->playFrame(false, NULL);
+            }
+            pGIFs[i] = pGIF;
+        }
+        if (pPool) {
+            for (i=0; i<POOL_THREADS; i++) {
+                threads[i].pGIFs = &pGIFs[(iCount * i) / POOL_THREADS];
+                threads[i].iCount = (iCount * (i+1)) / POOL_THREADS - (iCount * i) / POOL_THREADS;
+                pthread_create(&threads[i].tid, NULL, PlayThread, &threads[i]);
+            }
+            for (i=0; i<POOL_THREADS; i++) {
+                pthread_join(threads[i].tid, NULL);
+            }
+        }
+        iTurbo = (iMode == MODE_TURBO || iMode == MODE_FAST_TURBO) ? (int64_t)iCount * (TURBO_BUFFER_SIZE + 128*128) : 0;
+        iOther = iHeapBytes - iTurbo; // line buffers and workspaces
+        printf("%-16s %12lld %12lld %12lld %12lld %10lld\n", szModeNames[iMode],
+               (long long)iCount * (long long)sizeof(AnimatedGIF), (long long)iOther, (long long)iTurbo,
+               (long long)iCount * (long long)sizeof(AnimatedGIF) + iHeapBytes,
+               ((long long)iCount * (long long)sizeof(AnimatedGIF) + iHeapBytes) / iCount);
+        for (i=0; i<iCount; i++) {
+            pGIFs[i]->freeTurboBuf(CountFree);
+            pGIFs[i]->close();
+            delete pGIFs[i];
+        }
+        if (pPool) {
+            AnimatedGIF::closeWorkPool(pPool);
+            CountFree(pPoolMem);
+            pPool = NULL;
+        }
+    }
+    free(pGIFs);
+    free(pFast);
+    return 0;
+} /* main() */
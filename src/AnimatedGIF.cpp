@@ -53,6 +53,35 @@ int AnimatedGIF::openFLASH(uint8_t *pData, int iDataSize, GIF_DRAW_CALLBACK *pfn
     return GIFInit(&_gif);
 } /* openFLASH() */
 #endif
+//
+// Fast GIF container in memory or FLASH (see writeFast)
+// It must have been written for the palette type passed to begin()
+//
+int AnimatedGIF::openFast(uint8_t *pData, int iDataSize, GIF_DRAW_CALLBACK *pfnDraw)
+{
+    if (!GIFIsFast(pData, iDataSize)) {
+        _gif.iError = GIF_BAD_FILE;
+        return 0;
+    }
+    return open(pData, iDataSize, pfnDraw);
+} /* openFast() */
+//
+// Decode a GIF as it arrives (e.g. from a network stream)
+// pBuf holds the bytes passed to feed() until they're used; the largest
+// frame header (with its palettes) plus one sub-block must fit
+//
+int AnimatedGIF::openFeed(uint8_t *pBuf, int32_t iBufSize, GIF_DRAW_CALLBACK *pfnDraw)
+{
+    return GIFOpenFeed(&_gif, pBuf, iBufSize, pfnDraw);
+} /* openFeed() */
+//
+// Pass the next piece of the file; lines are drawn as soon as their LZW data arrives
+// returns 1 = more data needed, 0 = the end of the file was reached, -1 = error (see getLastError)
+//
+int AnimatedGIF::feed(const uint8_t *pData, int32_t iLen, GIFFEEDINFO *pInfo, void *pUser)
+{
+    return GIFFeed(&_gif, pData, iLen, pInfo, pUser);
+} /* feed() */
 void AnimatedGIF::mergeTransparent(uint8_t *pSrc, uint8_t *pDst, uint8_t ucTrans, int iLen) 
 {
    GIF_mergeTransparent(pSrc, pDst, ucTrans, iLen);
@@ -63,6 +92,14 @@ void AnimatedGIF::cookPixels(uint8_t *pSrc, uint8_t *pDst, int iTrans, int iLen,
    GIF_cookPixels(pSrc, pDst, iTrans, iLen, pPalette, pRGB565);
 } /* cookPixels() */
 //
+// Select the x86 SIMD kernels of mergeTransparent() and cookPixels() (for testing)
+// returns the level in use
+//
+int AnimatedGIF::setSIMD(int iLevel)
+{
+    return GIF_setSIMD(iLevel);
+} /* setSIMD() */
+//
 // Returns the first comment block found (if any)
 //
 int AnimatedGIF::getComment(char *pDest)
@@ -104,11 +141,13 @@ int AnimatedGIF::allocFrameBuf(GIF_ALLOC_CALLBACK *pfnAlloc)
 //
 int AnimatedGIF::allocTurboBuf(GIF_ALLOC_CALLBACK *pfnAlloc)
 {
+    if (_gif.iSrcCanvasWidth * _gif.iSrcCanvasHeight > TURBO_MAX_PIXELS)
+        return GIF_TOO_WIDE; // use the regular decoder for this one
     if (_gif.iCanvasWidth > 0 && _gif.iCanvasHeight > 0 && _gif.pTurboBuffer == NULL)
     {
         // Allocate a little extra space for the current line
         // as RGB565 or RGB888
-        int iTurboSize = TURBO_BUFFER_SIZE + (_gif.iCanvasWidth * _gif.iCanvasHeight);
+        int iTurboSize = TURBO_BUFFER_SIZE + (_gif.iSrcCanvasWidth * _gif.iSrcCanvasHeight);
         if (pfnAlloc == nullptr) {
             _gif.pTurboBuffer = (unsigned char *)malloc(iTurboSize);
         } else {
@@ -126,8 +165,218 @@ int AnimatedGIF::allocTurboBuf(GIF_ALLOC_CALLBACK *pfnAlloc)
 void AnimatedGIF::setFrameBuf(void *pFrameBuf)
 {
     _gif.pFrameBuffer = (uint8_t*)pFrameBuf;
+    _gif.bStretchAll = 1;
 }
 //
+// Set the strip buffer pointer and the number of lines per GIFDRAW call
+// The buffer must hold iLines * canvas width * output bytes per pixel
+// iLines of 0 or 1 returns to drawing a single line at a time
+//
+int AnimatedGIF::setStripBuf(void *pStripBuf, int iLines)
+{
+    if (iLines < 0)
+        return GIF_INVALID_PARAMETER;
+    _gif.pStripBuf = (uint8_t *)pStripBuf;
+    _gif.iStripLines = iLines;
+    return GIF_SUCCESS;
+} /* setStripBuf() */
+//
+// Set a buffer for the list of opaque pixel spans of each line (GIFDRAW.pSpans)
+// It holds iMaxSpans [start, length) pairs; (canvas width+1)/2 pairs is enough for any line
+// Lines with more spans than that get pSpans = NULL. NULL turns the span lists off.
+//
+int AnimatedGIF::setSpanBuf(uint16_t *pSpans, int iMaxSpans)
+{
+    if (pSpans && iMaxSpans < 1)
+        return GIF_INVALID_PARAMETER;
+    _gif.pSpanBuf = pSpans;
+    _gif.iSpanMax = (pSpans) ? iMaxSpans : 0;
+    return GIF_SUCCESS;
+} /* setSpanBuf() */
+//
+// Compare each new line of COOKED output with the canvas and only convert
+// the pixels which changed; GIFDRAW.pSpans lists them (needs setSpanBuf)
+//
+int AnimatedGIF::setCompareOnWrite(int bCompare)
+{
+    _gif.bCompare = (bCompare != 0);
+    return GIF_SUCCESS;
+} /* setCompareOnWrite() */
+//
+// Reduce the output to 1/iScale of the GIF's size (1, 2, 4 or 8)
+// Call this before open(); getCanvasWidth/Height() and the frame buffer
+// sizes are then the reduced sizes. The Turbo buffer still needs the full size.
+//
+int AnimatedGIF::setScale(int iScale, int iFilter)
+{
+    int iShift;
+
+    for (iShift=0; iShift<4 && (1 << iShift) != iScale; iShift++) {}
+    if (iShift == 4 || (iFilter != GIF_SCALE_NEAREST && iFilter != GIF_SCALE_BOX))
+        return GIF_INVALID_PARAMETER;
+    _gif.ucScale = (uint8_t)iShift;
+    _gif.ucScaleFilter = (uint8_t)iFilter;
+    return GIF_SUCCESS;
+} /* setScale() */
+//
+// Limit composition, conversion and GIFDraw calls to a rectangle of the
+// (scaled) canvas. The frame rect reported to GIFDraw is clipped to match.
+// A width or height of 0 turns the viewport off.
+//
+int AnimatedGIF::setViewport(int x, int y, int w, int h)
+{
+    if (x < 0 || y < 0 || w < 0 || h < 0 || x + w > 32767 || y + h > 32767)
+        return GIF_INVALID_PARAMETER;
+    if (w == 0 || h == 0)
+        x = y = w = h = 0;
+    _gif.iViewX = (uint16_t)x; _gif.iViewY = (uint16_t)y;
+    _gif.iViewWidth = (uint16_t)w; _gif.iViewHeight = (uint16_t)h;
+    return GIF_SUCCESS;
+} /* setViewport() */
+//
+// Resize the COOKED canvas to iWidth x iHeight pixels in pOut after each playFrame()
+// (needs a frame buffer and no GIFDraw callback). pTable holds iWidth + iHeight
+// entries of the source position of each output column and row. NULL turns it off.
+//
+int AnimatedGIF::setStretch(void *pOut, int iWidth, int iHeight, int iPitch, int iFilter, uint32_t *pTable)
+{
+    return GIFSetStretch(&_gif, pOut, iWidth, iHeight, iPitch, iFilter, pTable);
+} /* setStretch() */
+//
+// Return the area of the stretched output updated by the last frame
+// Returns 0 if nothing changed
+//
+int AnimatedGIF::getStretchRect(int *pX, int *pY, int *pWidth, int *pHeight)
+{
+    return GIFGetStretchRect(&_gif, pX, pY, pWidth, pHeight);
+} /* getStretchRect() */
+//
+// Set a buffer used to read the file in large slabs (e.g. 4-16K)
+// This greatly reduces the number of read callback calls for files on SD cards
+// Memory sources don't use it. NULL returns to unbuffered reads.
+//
+int AnimatedGIF::setReadBuf(void *pReadBuf, int32_t iSize)
+{
+    if (pReadBuf && iSize < MAX_CHUNK_SIZE+1)
+        return GIF_INVALID_PARAMETER;
+    _gif.pReadBuf = (uint8_t *)pReadBuf;
+    _gif.iReadBufSize = (pReadBuf) ? iSize : 0;
+    _gif.iReadBufLen = 0;
+    return GIF_SUCCESS;
+} /* setReadBuf() */
+//
+// Set memory to keep converted local palettes (sizeof(GIFPALSLOT) bytes each)
+// Frames which reuse a local color table then skip the conversion
+// NULL turns the cache off.
+//
+int AnimatedGIF::setPaletteCache(void *pBuf, int32_t iSize)
+{
+    return GIFSetPaletteCache(&_gif, pBuf, iSize);
+} /* setPaletteCache() */
+//
+// Set memory for the decoder's line buffer (canvas width + 15 bytes)
+// It's used instead of the built-in one (MAX_WIDTH pixels) by the next open()
+// when it's big enough, so files wider than MAX_WIDTH can be decoded.
+// NULL goes back to the built-in buffer.
+//
+int AnimatedGIF::setLineBuf(void *pBuf, int32_t iSize)
+{
+    return GIFSetLineBuf(&_gif, pBuf, iSize);
+} /* setLineBuf() */
+//
+// Set the functions used to allocate and free a line buffer sized for
+// the canvas when open() finds a file too wide for the others
+// (see setLineBuf), and the workspace when built with GIF_SPLIT_WORKSPACE.
+// Either one can be NULL to use malloc() or free() instead. The memory is
+// freed by close() (or here, before switching to the new functions).
+//
+void AnimatedGIF::setAllocator(GIF_ALLOC_CALLBACK *pfnAlloc, GIF_FREE_CALLBACK *pfnFree)
+{
+    GIFFreeLineBuf(&_gif); // allocated by the old functions
+    GIFFreeWork(&_gif);
+    _gif.pfnAlloc = pfnAlloc;
+    _gif.pfnFree = pfnFree;
+} /* setAllocator() */
+//
+// Set memory for the decoder workspace (GIF_SPLIT_WORKSPACE builds only)
+// It's used for each frame it's big enough for (see getWorkspaceSize);
+// otherwise the workspace comes from the allocator. The pointer must
+// be 4-byte aligned. NULL stops using it.
+//
+int AnimatedGIF::setWorkspace(void *pBuf, int32_t iSize)
+{
+    return GIFSetWorkspace(&_gif, pBuf, iSize);
+} /* setWorkspace() */
+//
+// Bytes of workspace needed to decode the open file in the current
+// mode (classic or Turbo, see GIFWORK). Nothing is needed until a frame
+// is decoded, so an instance only opened for getInfo() doesn't use any
+// in a GIF_SPLIT_WORKSPACE build.
+//
+int32_t AnimatedGIF::getWorkspaceSize()
+{
+    return GIFWorkSize(&_gif);
+} /* getWorkspaceSize() */
+//
+// Borrow the workspace from a pool shared with other instances for each
+// frame decoded instead of keeping one (GIF_SPLIT_WORKSPACE builds only).
+// Frames which need more than a pool slot, or which find every slot in
+// use, get the instance's own workspace (setWorkspace or the allocator).
+// NULL stops using the pool.
+//
+int AnimatedGIF::setWorkPool(GIFWORKPOOL *pPool)
+{
+    return GIFSetWorkPool(&_gif, pPool);
+} /* setWorkPool() */
+//
+// Bytes of memory for initWorkPool() to hold iSlots workspaces of
+// iSlotSize bytes (0 = sizeof(GIFWORK) + 16, enough for any file up to
+// MAX_WIDTH pixels wide in classic or Turbo mode)
+//
+int32_t AnimatedGIF::getWorkPoolSize(int iSlots, int32_t iSlotSize)
+{
+    return GIFWorkPoolSize(iSlots, iSlotSize);
+} /* getWorkPoolSize() */
+//
+// Set up a workspace pool in the caller's memory (8-byte aligned)
+// The number of slots is the number of frames which can be decoded at
+// once by all of the instances using it without falling back to their own
+// workspace. Returns NULL if iMemSize is too small.
+//
+GIFWORKPOOL * AnimatedGIF::initWorkPool(void *pMem, int32_t iMemSize, int iSlots, int32_t iSlotSize)
+{
+    return GIFInitWorkPool(pMem, iMemSize, iSlots, iSlotSize);
+} /* initWorkPool() */
+//
+// Lock the pool with the caller's function on systems without pthreads
+// (see GIFSetWorkPoolLock)
+//
+void AnimatedGIF::setWorkPoolLock(GIFWORKPOOL *pPool, GIF_LOCK_CALLBACK *pfnLock, void *pUser)
+{
+    GIFSetWorkPoolLock(pPool, pfnLock, pUser);
+} /* setWorkPoolLock() */
+//
+// Release the pool's resources once no instance is using it
+//
+void AnimatedGIF::closeWorkPool(GIFWORKPOOL *pPool)
+{
+    GIFCloseWorkPool(pPool);
+} /* closeWorkPool() */
+//
+// Number of read callback calls made while decoding since open()
+//
+int32_t AnimatedGIF::getReadCount()
+{
+    return _gif.iReadCount;
+} /* getReadCount() */
+//
+// Number of LZW bytes shifted in the de-chunk buffer since open()
+//
+int32_t AnimatedGIF::getBytesMoved()
+{
+    return _gif.iBytesMoved;
+} /* getBytesMoved() */
+//
 // Set the Turbo buffer pointer
 //
 void AnimatedGIF::setTurboBuf(void *pBuf)
@@ -226,6 +475,137 @@ int AnimatedGIF::getInfo(GIFINFO *pInfo)
    return GIF_getInfo(&_gif, pInfo);
 } /* getInfo() */
 
+//
+// Walk the file and record the position and info of every frame
+// Call with pFrames = NULL to just count the frames
+// returns the number of frames found
+//
+int AnimatedGIF::buildIndex(GIFFRAME *pFrames, int iMaxFrames)
+{
+    return GIF_buildIndex(&_gif, pFrames, iMaxFrames);
+} /* buildIndex() */
+//
+// Go directly to a frame (requires buildIndex)
+// The next call to playFrame() will decode this frame
+//
+int AnimatedGIF::seekFrame(int iFrame)
+{
+    return GIF_seekFrame(&_gif, iFrame);
+} /* seekFrame() */
+//
+// Go to any frame with a correct frame buffer (requires buildIndex and a frame buffer)
+// uses the snapshots (if any) to avoid decoding from the start
+//
+int AnimatedGIF::gotoFrame(int iFrame)
+{
+    return GIF_gotoFrame(&_gif, iFrame);
+} /* gotoFrame() */
+//
+// Set the memory used to hold frame buffer snapshots
+// a snapshot is saved every iInterval frames (0 = spread evenly over the frame index)
+// Each snapshot needs 4 bytes + the frame buffer size (8-bit canvas + cooked output)
+//
+int AnimatedGIF::setSnapshotBuf(void *pBuf, int32_t iBufSize, int iInterval)
+{
+    if (iBufSize < 0 || iInterval < 0)
+        return GIF_INVALID_PARAMETER;
+    _gif.pSnapBuf = (uint8_t *)pBuf;
+    _gif.iSnapBufSize = (pBuf) ? iBufSize : 0;
+    _gif.iSnapInterval = iInterval;
+    _gif.iSnapSize = 0; // slots are laid out on the next save
+    _gif.iSnapCount = 0;
+    return GIF_SUCCESS;
+} /* setSnapshotBuf() */
+//
+// Set the memory used to cache decoded frames (NULL = off)
+// After one full pass of the animation, the next pass is recorded as deltas
+// and later passes replay them without decoding. Frames which don't fit are
+// decoded as usual. Requires COOKED output to the frame buffer without a GIFDRAW callback
+// The buffer needs room for a copy of the frame buffer plus the deltas
+//
+int AnimatedGIF::setBakeBuf(void *pBuf, int32_t iBufSize)
+{
+    if (iBufSize < 0)
+        return GIF_INVALID_PARAMETER;
+    _gif.pBakeBuf = (uint8_t *)pBuf;
+    _gif.iBakeBufSize = (pBuf) ? iBufSize : 0;
+    _gif.ucBakeState = (pBuf) ? GIF_BAKE_WAITING : GIF_BAKE_OFF;
+    _gif.iBakeFrames = 0;
+    return GIF_SUCCESS;
+} /* setBakeBuf() */
+//
+// Return the number of frames which are replayed from the cache (0 = not ready yet)
+//
+int AnimatedGIF::getBakedFrames()
+{
+    return (_gif.ucBakeState == GIF_BAKE_COMPLETE) ? _gif.iBakeFrames : 0;
+} /* getBakedFrames() */
+#ifdef __LINUX__
+//
+// Decode all frames with multiple threads (frame-parallel LZW)
+// Output is the same as calling playFrame() for each frame
+// returns the number of frames drawn or -1 for an error
+//
+int AnimatedGIF::playParallel(int iThreads, void *pUser)
+{
+    return GIF_playParallel(&_gif, iThreads, pUser);
+} /* playParallel() */
+//
+// Convert the open file into a fast GIF container for openFast()
+// Call with pOut = NULL to get the size needed
+// returns the container size or 0 for an error
+//
+int32_t AnimatedGIF::writeFast(uint8_t *pOut, int32_t iOutSize)
+{
+    return GIF_writeFast(&_gif, pOut, iOutSize);
+} /* writeFast() */
+//
+// Start a background thread which keeps up to iFrames composed frames ready
+// iLoops = number of times to play the animation (0 = forever)
+//
+int AnimatedGIF::startDecodeAhead(int iFrames, int iLoops)
+{
+    return GIF_startDecodeAhead(&_gif, iFrames, iLoops);
+} /* startDecodeAhead() */
+//
+// Get the next composed frame (doesn't wait)
+// returns 1 = frame ready, 0 = not ready yet, -1 = no more frames
+//
+int AnimatedGIF::getDecodedFrame(GIFRINGFRAME *pFrame)
+{
+    return GIF_getDecodedFrame(&_gif, pFrame);
+} /* getDecodedFrame() */
+//
+// Return the frame from getDecodedFrame() to the decoder
+//
+void AnimatedGIF::releaseDecodedFrame()
+{
+    GIF_releaseDecodedFrame(&_gif);
+} /* releaseDecodedFrame() */
+
+void AnimatedGIF::stopDecodeAhead()
+{
+    GIF_stopDecodeAhead(&_gif);
+} /* stopDecodeAhead() */
+#endif
+//
+// Return the number of the frame the next playFrame() call will decode
+//
+int AnimatedGIF::getCurrentFrame()
+{
+    return _gif.iCurrentFrame;
+} /* getCurrentFrame() */
+
+//
+// Return the area of the canvas changed by the last frame (call after playFrame)
+// With a frame buffer, this only covers pixels which changed value; without one
+// it's the frame's rectangle. Returns 0 if nothing changed
+//
+int AnimatedGIF::getDirtyRect(int *pX, int *pY, int *pWidth, int *pHeight)
+{
+    return GIFGetDirtyRect(&_gif, pX, pY, pWidth, pHeight);
+} /* getDirtyRect() */
+
 int AnimatedGIF::getLastError()
 {
     return _gif.iError;
@@ -235,6 +615,13 @@ int AnimatedGIF::open(const char *szFilename, GIF_DRAW_CALLBACK *pfnDraw)
 {
     return GIF_openFile(&_gif, szFilename, pfnDraw);
 } /* open() */
+//
+// Memory mapped file (no fread copies)
+//
+int AnimatedGIF::openMapped(const char *szFilename, GIF_DRAW_CALLBACK *pfnDraw)
+{
+    return GIF_openMapped(&_gif, szFilename, pfnDraw);
+} /* openMapped() */
 #endif // __LINUX__
 //
 // File (SD/MMC) based initialization
@@ -258,34 +645,38 @@ int AnimatedGIF::open(const char *szFilename, GIF_OPEN_CALLBACK *pfnOpen, GIF_CL
 
 void AnimatedGIF::close()
 {
+#ifdef __LINUX__
+    GIF_stopDecodeAhead(&_gif); // the decoder thread may still be using the file
+#endif
     if (_gif.pfnClose)
         (*_gif.pfnClose)(_gif.GIFFile.fHandle);
+    GIFFreeLineBuf(&_gif);
+    GIFFreeWork(&_gif);
+    _gif.ucFeedState = GIF_FEED_OFF;
+    _gif.bStepFrame = 0;
 } /* close() */
 
 void AnimatedGIF::reset()
 {
     _gif.iError = GIF_SUCCESS;
+    if (GIFMoreFrames(&_gif)) // resetting after the last frame is the same as looping
+        _gif.iBakeNext = -1;
+    GIFDropStep(&_gif);
     (*_gif.pfnSeek)(&_gif.GIFFile, 0);
+    _gif.iCurrentFrame = 0;
 } /* reset() */
 
 void AnimatedGIF::begin(unsigned char ucPaletteType)
 {
-uint8_t *p;
-uint32_t u32;
-
     memset(&_gif, 0, sizeof(_gif));
     if (ucPaletteType != GIF_PALETTE_RGB565_LE && ucPaletteType != GIF_PALETTE_RGB565_BE && ucPaletteType != GIF_PALETTE_RGB888)
         _gif.iError = GIF_INVALID_PARAMETER;
     _gif.ucPaletteType = ucPaletteType;
     _gif.ucDrawType = GIF_DRAW_RAW; // assume RAW pixel handling
     _gif.pFrameBuffer = NULL;
-    p = &_gif.ucLineBuf[0];
-    u32 = (uint32_t)(intptr_t)p;
-    u32 &= 15; // align on 16-byte boundary
-    if (u32 > 0) {
-        p += (16-u32);
-    }
-    _gif.pLineBufAligned = p;
+#ifndef GIF_SPLIT_WORKSPACE
+    _gif.pLineBufAligned = _gif.work.ucLineBuf; // set for the canvas width by open()
+#endif
 } /* begin() */
 //
 // Play a single frame
@@ -300,22 +691,40 @@ int rc;
 long lTime = millis();
 #endif
 
+    if (_gif.ucFeedState != GIF_FEED_OFF) // frames come from feed() in push mode
+    {
+        _gif.iError = GIF_INVALID_PARAMETER;
+        return -1;
+    }
+    GIFDropStep(&_gif); // the frame is decoded again as a whole
     if (_gif.GIFFile.iPos >= _gif.GIFFile.iSize-1) // no more data exists
     {
         (*_gif.pfnSeek)(&_gif.GIFFile, 0); // seek to start
+        _gif.iCurrentFrame = 0;
     }
-    if (GIFParseInfo(&_gif, 0))
+    if (_gif.ucBakeState && GIFBakeReplay(&_gif)) // drawn from the decoded frame cache
     {
         _gif.pUser = pUser;
-        if (_gif.iError == GIF_EMPTY_FRAME) // don't try to decode it
+    }
+    else if (GIFParseInfo(&_gif, 0))
+    {
+        _gif.pUser = pUser;
+        if (_gif.iError == GIF_EMPTY_FRAME) { // don't try to decode it
+            GIFReleaseWork(&_gif);
             return 0;
+        }
         if (_gif.pTurboBuffer) {
             rc = DecodeLZWTurbo(&_gif, 0);
         } else {
             rc = DecodeLZW(&_gif, 0);
         }
+        GIFReleaseWork(&_gif); // a pool workspace is only borrowed for one frame
         if (rc != 0) // problem
             return -1;
+        GIFBakeSave(&_gif);
+        _gif.iCurrentFrame++;
+        if (_gif.pSnapBuf)
+            GIFSaveSnapshot(&_gif);
     }
     else
     {
@@ -323,6 +732,7 @@ long lTime = millis();
         // the last frame. Return as if all is well, though if needed getLastError()
         // can be used to see if a frame was actually processed:
         // GIF_SUCCESS -> frame processed, GIF_EMPTY_FRAME -> no frame processed
+        GIFReleaseWork(&_gif);
         if (_gif.iError == GIF_EMPTY_FRAME)
         {
 	    if (delayMilliseconds)
@@ -331,6 +741,8 @@ long lTime = millis();
         }
         return -1; // error parsing the frame info, we may be at the end of the file
     }
+    if (_gif.pStretchBuf)
+        GIFStretchFrame(&_gif);
     // Return 1 for more frames or 0 if this was the last frame
     if (bSync)
     {
@@ -342,6 +754,20 @@ long lTime = millis();
     }
     if (delayMilliseconds) // if not NULL, return the frame delay time
         *delayMilliseconds = _gif.iFrameDelay;
-    return (_gif.GIFFile.iPos < _gif.GIFFile.iSize-10);
+    return GIFMoreFrames(&_gif);
 } /* playFrame() */
+//
+// Decode the current frame a slice at a time, for event loops which
+// can't wait for a whole frame (see GIFDecodeStep)
+// Stops after iRows rows or iMicros microseconds, whichever comes first
+// returns:
+// 2 = the frame isn't finished yet; call again to continue it
+// 1 = the frame is finished and more frames exist
+// 0 = the last frame is finished
+// -1 = error
+//
+int AnimatedGIF::decodeStep(int iRows, int32_t iMicros, int *delayMilliseconds, void *pUser)
+{
+    return GIFDecodeStep(&_gif, iRows, iMicros, delayMilliseconds, pUser);
+} /* decodeStep() */
 
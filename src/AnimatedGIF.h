@@ -19,6 +19,7 @@
 #include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stddef.h>
 #define memcpy_P memcpy
 #define PROGMEM
 #endif
@@ -41,6 +42,7 @@
 // ** NEW **
 // Turbo mode added Feb 18, 2024. This option decodes images
 // up to 30x faster if there is enough RAM (48K + full framebuffer)
+// Turbo mode supports both RAW (8-bit lines to GIFDRAW) and COOKED output
 //
 
 /* GIF Defines and variables */
@@ -64,11 +66,16 @@
 #define MAX_CODE_SIZE 12
 
 #define MAX_COLORS 256
+// Width of the line buffer built into GIFIMAGE. Wider images are decoded
+// with a buffer from setLineBuf() or else one from setAllocator() (or malloc);
+// a project which always supplies one can define this smaller to save RAM in every instance
+#ifndef MAX_WIDTH
 #ifdef __LINUX__
 #define MAX_WIDTH 2048
 #else
 #define MAX_WIDTH 480
 #endif // __LINUX__
+#endif // MAX_WIDTH
 #define LZW_BUF_SIZE (6*MAX_CHUNK_SIZE)
 #define LZW_HIGHWATER (4*MAX_CHUNK_SIZE)
 // This buffer is used to store the pixel sequence in reverse order
@@ -84,6 +91,8 @@
 // expanded LZW buffer for Turbo mode
 #define LZW_BUF_SIZE_TURBO (LZW_BUF_SIZE + (2<<MAX_CODE_SIZE) + (PIXEL_LAST*2) + MAX_WIDTH)
 #define LZW_HIGHWATER_TURBO ((LZW_BUF_SIZE_TURBO * 14) / 16)
+// Turbo mode keeps 23-bit offsets into the frame, so it's limited to this many pixels
+#define TURBO_MAX_PIXELS (0x7fffff - 256)
 
 //
 // Pixel types
@@ -111,10 +120,64 @@ enum {
 //          canvas size with 24-bit output would require (160*120 + 3*160) bytes.
 //          Each prepared line is sent to the GIFDraw callback as a row of 16/24/32-bit pixels.
 //
+// STRIPS = optional for RAW and COOKED (not 1-bpp) output. setStripBuf() provides a buffer of
+//          iLines * canvas width * bytes-per-pixel and GIFDraw then receives up to iLines lines per call
+//          (GIFDRAW.iStripHeight lines, GIFDRAW.iPitch bytes apart). Interlaced frames are sent 1 line
+//          at a time. In Turbo mode, RAW strips come straight from the Turbo buffer (no strip buffer needed).
+//
+// SPANS = optional for single line output. setSpanBuf() provides room for a list of [start, length) pairs
+//         of the non-transparent pixels of each line (GIFDRAW.pSpans / iSpanCount). Lines without any opaque
+//         pixels are not sent to GIFDraw at all (except with disposal method 2).
+//
+// COMPARE = optional for COOKED (not 1-bpp) output with a span buffer. setCompareOnWrite() makes the decoder
+//           compare each new line with the 8-bit canvas and only convert the pixels whose index changed.
+//           GIFDRAW.pSpans then lists the changed pixels (the only valid ones in pPixels), lines without
+//           changes are skipped and getDirtyRect() returns their bounding box.
+//
 enum {
    GIF_DRAW_RAW = 0,
    GIF_DRAW_COOKED
 };
+//
+// Scaled output (see setScale)
+//
+// The canvas, frame buffer and GIFDRAW coordinates are reduced to 1/2, 1/4 or 1/8 of the GIF's size.
+// NEAREST keeps the pixel at the top left of each block. BOX keeps the opaque pixel of each block which is
+// nearest to the block's average color (the canvas holds palette indices, so it can't blend new colors).
+// BOX needs every line of a block at once, so it's only used with a Turbo buffer.
+// BILINEAR is only for setStretch().
+//
+// Viewport (see setViewport)
+//
+// Only the part of each frame inside the viewport (in output canvas coordinates) is composed, converted and
+// sent to GIFDraw. The GIFDRAW frame rect (iX, iY, iWidth, iHeight) is the visible part of the frame, so
+// the canvas outside the viewport isn't kept up to date.
+//
+enum {
+   GIF_SCALE_NEAREST = 0,
+   GIF_SCALE_BOX,
+   GIF_SCALE_BILINEAR
+};
+//
+// Stretched output (see setStretch)
+//
+// After each playFrame(), the COOKED canvas (frame buffer without a GIFDraw callback) is resized to any
+// output size in the same pixel format. NEAREST copies pixels, BILINEAR blends the 4 nearest ones.
+// The source column and row of each output pixel are kept in a table of (width + height) uint32_t's
+// which is rebuilt only when a size changes, and only the output pixels which depend on the
+// canvas pixels changed by the frame are redone (see getStretchRect).
+//
+
+//
+// x86 SIMD kernels of mergeTransparent() and cookPixels() (see setSIMD)
+// AUTO picks the best one the CPU supports; the others are for testing each kernel.
+//
+enum {
+   GIF_SIMD_AUTO = -1,
+   GIF_SIMD_NONE,
+   GIF_SIMD_SSE2,
+   GIF_SIMD_AVX2
+};
 
 enum {
    GIF_SUCCESS = 0,
@@ -129,6 +192,36 @@ enum {
    GIF_ERROR_MEMORY
 };
 
+//
+// "Fast GIF" container (see writeFast/openFast)
+// It holds the frame table, palettes already converted for one palette type
+// and the LZW data of each frame as one stream without the sub-block lengths.
+// Multi-byte values are little endian.
+//
+// Header (32 bytes): "FGIF", version, palette type, canvas width, height (16-bit),
+//   background, bpp, loop count (16-bit), global palette entries (16-bit),
+//   frame count, frame table offset, global palette offset, comment offset (32-bit)
+// Frame table entry (32 bytes): x, y, width, height, delay in ms,
+//   graphic control delay (16-bit, 0xffff = none), GIF bits, transparent color,
+//   descriptor flags, LZW code size, local palette entries (16-bit, 0 = use global),
+//   reserved (16-bit), palette offset, LZW offset, LZW length (32-bit)
+// Comment: 1 byte length followed by the text
+// Each LZW stream is followed by at least GIF_FAST_LZW_PAD zero bytes
+//
+#define GIF_FAST_VERSION 1
+#define GIF_FAST_HEADER_SIZE 32
+#define GIF_FAST_ENTRY_SIZE 32
+#define GIF_FAST_LZW_PAD 16
+
+//
+// A memory mapped file (see openMapped)
+//
+typedef struct gif_map_tag
+{
+  void *pData; // start of the mapping
+  size_t iSize; // length of the mapping
+} GIFMAP;
+
 typedef struct gif_file_tag
 {
   int32_t iPos; // current file position
@@ -145,12 +238,67 @@ typedef struct gif_info_tag
   int32_t iMinDelay; // minimum frame delay
 } GIFINFO;
 
+//
+// Progress reported by feed()
+//
+typedef struct gif_feed_info_tag
+{
+  int iFrames; // frames finished by this call
+  int iRows; // rows sent to GIFDRAW by this call
+  int iFrame; // frame which the next rows belong to
+  int iFrameRows; // rows of that frame decoded so far
+} GIFFEEDINFO;
+
+//
+// Per-frame information gathered by buildIndex()
+// It allows seekFrame() to go directly to any frame
+//
+typedef struct gif_frame_tag
+{
+  int32_t iStartOffset; // file offset of the first block of this frame (extensions)
+  int32_t iDescOffset; // file offset of the image descriptor (',')
+  int32_t iPalOffset; // file offset of the local color table (0 = uses the global palette)
+  int32_t iDataOffset; // file offset of the first LZW sub-block (length byte)
+  uint16_t iX, iY, iWidth, iHeight; // frame position and size on the canvas
+  uint16_t iDelay; // frame delay in milliseconds (0 = no graphic control extension)
+  uint8_t ucDisposalMethod; // frame disposal method
+  uint8_t ucTransparent; // transparent color index
+  uint8_t ucHasTransparency; // flag indicating the transparent color is in use
+  uint8_t ucMap; // image descriptor flags (local palette, interlace)
+} GIFFRAME;
+
+//
+// A composed frame from the decode-ahead ring (see startDecodeAhead)
+//
+typedef struct gif_ring_frame_tag
+{
+  uint8_t *pCanvas; // copy of the frame buffer (8-bit canvas followed by any cooked pixels)
+  int iFrame; // frame number
+  int iDelay; // frame delay in milliseconds
+  uint16_t iX, iY, iWidth, iHeight; // dirty rect - area changed since the previous frame
+} GIFRINGFRAME;
+
+//
+// One entry of the converted palette cache (see setPaletteCache)
+//
+typedef struct gif_pal_slot_tag
+{
+  uint32_t u32Hash; // hash of the raw palette bytes
+  uint16_t iColors; // number of entries (0 = empty slot)
+  uint8_t ucPaletteType; // output type the entries were converted to
+  uint8_t ucUnused;
+  uint8_t ucRaw[MAX_COLORS * 3]; // original RGB888 entries from the file
+  uint16_t usPalette[(MAX_COLORS * 3)/2]; // converted entries
+} GIFPALSLOT;
+
 typedef struct gif_draw_tag
 {
     int iX, iY; // Corner offset of this frame on the canvas
     int y; // current line being drawn (0 = top line of image)
     int iWidth, iHeight; // size of this frame
     int iCanvasWidth; // need this to know where to place output in a fully cooked bitmap
+    int iStripHeight; // number of lines in pPixels (1 unless strip mode is enabled)
+    int iPitch; // bytes from one line to the next in pPixels
     void *pUser; // user supplied pointer
     uint8_t *pPixels; // 8-bit source pixels for this line
     uint16_t *pPalette; // little or big-endian RGB565 palette entries (default)
@@ -161,6 +309,8 @@ typedef struct gif_draw_tag
     uint8_t ucBackground; // background color
     uint8_t ucPaletteType; // type of palette entries
     uint8_t ucIsGlobalPalette; // Flag to indicate that a global palette, rather than a local palette is being used
+    uint16_t *pSpans; // [start, length) pairs of opaque pixels in this line (NULL = not available, see setSpanBuf)
+    int iSpanCount; // number of pairs in pSpans
 } GIFDRAW;
 
 // Callback function prototypes
@@ -171,6 +321,26 @@ typedef void * (GIF_OPEN_CALLBACK)(const char *szFilename, int32_t *pFileSize);
 typedef void (GIF_CLOSE_CALLBACK)(void *pHandle);
 typedef void * (GIF_ALLOC_CALLBACK)(uint32_t iSize);
 typedef void (GIF_FREE_CALLBACK)(void *buffer);
+typedef void (GIF_LOCK_CALLBACK)(void *pUser, int bLock);
+//
+// Decoder workspace
+// Only needed while a frame is being decoded. Turbo mode keeps its code
+// tables in the Turbo buffer and uses all of this (except the end of the
+// line) as one larger LZW buffer. Normally it's part of GIFIMAGE; with
+// GIF_SPLIT_WORKSPACE defined it's allocated by the first frame decoded,
+// only as big as the mode needs (see GIF_getWorkspaceSize), so instances
+// which are only opened for their info don't carry it.
+//
+typedef struct gif_work_tag
+{
+    uint8_t ucLZW[LZW_BUF_SIZE]; // holds de-chunked LZW data
+    // These next 3 are used in Turbo mode to have a larger ucLZW buffer
+    uint16_t usGIFTable[1<<MAX_CODE_SIZE];
+    uint8_t ucGIFPixels[(PIXEL_LAST*2)];
+    uint8_t ucLineBuf[MAX_WIDTH+15]; // current line
+} GIFWORK;
+typedef struct gif_work_pool_tag GIFWORKPOOL; // workspaces shared by several instances (see GIF_initWorkPool)
+
 //
 // our private structure to hold a GIF image decode state
 //
@@ -179,6 +349,9 @@ typedef struct gif_image_tag
     uint16_t iWidth, iHeight, iCanvasWidth, iCanvasHeight;
     uint16_t iPrevW, iPrevH, iPrevX, iPrevY; // for disposal method 2 (restore to bg)
     uint16_t iX, iY; // GIF corner offset
+    uint16_t iSrcX, iSrcY, iSrcWidth, iSrcHeight, iSrcCanvasWidth, iSrcCanvasHeight; // sizes in the file before scaling
+    uint16_t iViewX, iViewY, iViewWidth, iViewHeight; // visible part of the output canvas (iViewWidth = 0 for all of it)
+    uint16_t iDirtyX1, iDirtyY1, iDirtyX2, iDirtyY2; // canvas pixels changed by the last frame (see getDirtyRect)
     uint16_t iBpp;
     int16_t iError; // last error
     uint16_t iFrameDelay; // delay in milliseconds for this frame
@@ -187,8 +360,40 @@ typedef struct gif_image_tag
     int iLZWOff; // current LZW data offset
     int iLZWSize; // current quantity of data in the LZW buffer
     int iCommentPos; // file offset of start of comment data
+    GIFFRAME *pFrameIndex; // optional frame index (see buildIndex)
+    int iFrameCount; // number of frames in the index
+    int iCurrentFrame; // frame number which the next playFrame() will decode
+    uint8_t *pSnapBuf; // optional memory for frame buffer snapshots (see gotoFrame)
+    int32_t iSnapBufSize, iSnapSize; // total size of the snapshot memory, size of one snapshot
+    int iSnapInterval, iSnapCount; // frames between snapshots, number of snapshot slots
+    uint8_t *pBakeBuf; // optional memory for the decoded frame cache (see setBakeBuf)
+    int32_t iBakeBufSize, iBakeUsed, iBakePos, iBakeCanvas; // cache size, bytes of records, next record, canvas bytes
+    int iBakeFrames, iBakeNext; // frames in the cache, next frame of an unbroken run from frame 0 (-1 = none)
+    unsigned char ucBakeState; // off, waiting for a full pass, recording or complete
+    uint8_t *pFeedBuf; // caller's buffer for the bytes passed to feed() (see openFeed)
+    int32_t iFeedBufSize;
+    unsigned char ucFeedState; // off, waiting for the file header or a frame header, decoding, skipping, finished
+    unsigned char bNewTable; // the classic decoder stopped before (re)initializing its table
+    unsigned char ucLastPel; // classic decoder state kept between feed() calls
+    signed short sCodeMask;
+    unsigned short usCodeSize, usOldCode, usNextCode, usNextLim;
+    int iBitNum;
+    unsigned char bStepFrame; // a frame started by decodeStep() isn't finished yet
+    int32_t iStepFrameStart; // file offset of that frame
+    int iStepStopY, iStepEndY; // iYCount at which to check the budget, where the row budget runs out (-1 = none)
+    uint32_t u32StepStart, u32StepMicros; // clock at the start of this decodeStep() call and its time budget
+    void *pDecodeAhead; // background decoder state (Linux only)
+    uint8_t *pReadBuf; // optional buffer to read the file in large slabs (see setReadBuf)
+    int32_t iReadBufSize, iReadBufPos, iReadBufLen; // slab size, file offset and valid bytes
+    int32_t iReadCount, iBytesMoved; // read callback calls and LZW bytes moved since open()
+    uint8_t *pLZW; // LZW data being decoded (ucLZW or a frame of a fast GIF container)
     short sCommentLen; // length of comment
     unsigned char bEndOfFrame;
+    unsigned char bFastGIF; // the file is a fast GIF container (see openFast)
+    unsigned char bCookedStale; // cooked pixels may not match the canvas indices (new frame buffer or a local palette)
+    unsigned char bDirtyAll; // every pixel written by this frame counts as changed
+    unsigned char bCompare; // only convert the pixels which change the canvas (see setCompareOnWrite)
+    unsigned char ucScale, ucScaleFilter; // log2 of the output reduction and the filter used (see setScale)
     unsigned char ucPrevDisp, ucDisposalMethod;
     unsigned char ucGIFBits, ucBackground, ucTransparent, ucCodeStart, ucMap, bUseLocalPalette;
     unsigned char ucPaletteType; // RGB565 or RGB888
@@ -203,16 +408,42 @@ typedef struct gif_image_tag
     unsigned char *pFrameBuffer;
     unsigned char *pTurboBuffer;
     unsigned char *pPixels, *pOldPixels;
+    unsigned char *pStripBuf; // optional buffer to collect multiple lines per GIFDRAW call
+    int iStripLines, iStripCount, iStripY; // strip size, lines collected so far, first line
+    uint16_t *pSpanBuf; // optional memory for the opaque span list of each line (see setSpanBuf)
+    int iSpanMax; // number of [start, length) pairs which fit in pSpanBuf
+    GIFPALSLOT *pPalCache; // optional cache of converted local palettes (see setPaletteCache)
+    int iPalSlots, iPalNext; // number of cache slots, next slot to replace
+    unsigned short *pLocalPal; // active local palette (pLocalPalette or a cache slot)
+    void (*pfnCookLine)(struct gif_image_tag *pPage, GIFDRAW *pDraw, void *pDest); // DrawCooked kernel for the current frame
+    uint8_t *pStretchBuf; // optional output for the canvas resized to any size (see setStretch)
+    uint32_t *pStretchTab; // (source index << 8) | bilinear fraction for each output column, then each row
+    int iStretchPitch; // bytes per line of pStretchBuf
+    uint16_t iStretchWidth, iStretchHeight, iStretchSrcW, iStretchSrcH; // output size, canvas size of the table
+    uint16_t iStretchX1, iStretchY1, iStretchX2, iStretchY2; // output pixels updated by the last frame
+    unsigned char ucStretchFilter, bStretchAll; // NEAREST or BILINEAR, redo the whole output next frame
     unsigned char ucFileBuf[FILE_BUF_SIZE]; // holds temp data and pixel stack
     unsigned short pPalette[(MAX_COLORS * 3)/2]; // can hold RGB565 or RGB888 - set in begin()
     unsigned short pLocalPalette[(MAX_COLORS * 3)/2]; // color palettes for GIF images
     int iLocalPalSize, iGlobalPalSize;
-    uint8_t ucLZW[LZW_BUF_SIZE]; // holds de-chunked LZW data
-    // These next 3 are used in Turbo mode to have a larger ucLZW buffer
-    uint16_t usGIFTable[1<<MAX_CODE_SIZE];
-    uint8_t ucGIFPixels[(PIXEL_LAST*2)];
-    uint8_t ucLineBuf[MAX_WIDTH+15]; // current line
+#ifdef GIF_SPLIT_WORKSPACE
+    GIFWORK *pWork; // workspace for the current mode (NULL until a frame is decoded)
+    uint8_t *pWorkBuf; // caller's workspace memory (see setWorkspace)
+    int32_t iWorkBufSize;
+    uint8_t *pWorkAlloc; // workspace from pfnAlloc (or malloc), kept until close()
+    int32_t iWorkAllocSize;
+    GIFWORKPOOL *pWorkPool; // shared workspaces (see setWorkPool)
+    uint8_t *pPoolSlot; // workspace borrowed from pWorkPool for the current frame
+#else
+    GIFWORK work;
+#endif
     uint8_t *pLineBufAligned;
+    uint8_t *pLineBuf; // caller's line buffer (see setLineBuf)
+    int32_t iLineBufSize;
+    uint8_t *pLineAlloc; // line buffer from pfnAlloc for canvases too wide for the others
+    int32_t iLineAllocSize;
+    GIF_ALLOC_CALLBACK *pfnAlloc; // see setAllocator
+    GIF_FREE_CALLBACK *pfnFree;
 } GIFIMAGE;
 
 #ifdef __cplusplus
@@ -224,8 +455,12 @@ class AnimatedGIF
   public:
     int open(uint8_t *pData, int iDataSize, GIF_DRAW_CALLBACK *pfnDraw);
     int openFLASH(uint8_t *pData, int iDataSize, GIF_DRAW_CALLBACK *pfnDraw);
+    int openFast(uint8_t *pData, int iDataSize, GIF_DRAW_CALLBACK *pfnDraw);
+    int openFeed(uint8_t *pBuf, int32_t iBufSize, GIF_DRAW_CALLBACK *pfnDraw);
+    int feed(const uint8_t *pData, int32_t iLen, GIFFEEDINFO *pInfo = NULL, void *pUser = NULL);
 #ifdef __LINUX__
     int open(const char *szFilename, GIF_DRAW_CALLBACK *pfnDraw);
+    int openMapped(const char *szFilename, GIF_DRAW_CALLBACK *pfnDraw);
 #endif
     int open(const char *szFilename, GIF_OPEN_CALLBACK *pfnOpen, GIF_CLOSE_CALLBACK *pfnClose, GIF_READ_CALLBACK *pfnRead, GIF_SEEK_CALLBACK *pfnSeek, GIF_DRAW_CALLBACK *pfnDraw);
     void close();
@@ -233,6 +468,7 @@ class AnimatedGIF
     void begin(uint8_t ucPaletteType = GIF_PALETTE_RGB565_LE);
     void begin(int iEndian, uint8_t ucPaletteType) { begin(ucPaletteType); };
     int playFrame(bool bSync, int *delayMilliseconds, void *pUser = NULL);
+    int decodeStep(int iRows, int32_t iMicros, int *delayMilliseconds = NULL, void *pUser = NULL);
     int getCanvasWidth();
     int getFrameWidth();
     int getFrameHeight();
@@ -242,6 +478,34 @@ class AnimatedGIF
     int allocFrameBuf(GIF_ALLOC_CALLBACK *pfnAlloc = nullptr);
     void setTurboBuf(void *pTurboBuffer);
     void setFrameBuf(void *pFrameBuffer);
+    int setStripBuf(void *pStripBuf, int iLines);
+    int setSpanBuf(uint16_t *pSpans, int iMaxSpans);
+    int setCompareOnWrite(int bCompare);
+    int setScale(int iScale, int iFilter = GIF_SCALE_NEAREST);
+    int setViewport(int x, int y, int w, int h);
+    int setStretch(void *pOut, int iWidth, int iHeight, int iPitch, int iFilter, uint32_t *pTable);
+    int getStretchRect(int *pX, int *pY, int *pWidth, int *pHeight);
+    int setReadBuf(void *pReadBuf, int32_t iSize);
+    int setPaletteCache(void *pBuf, int32_t iSize);
+    int setLineBuf(void *pBuf, int32_t iSize);
+    void setAllocator(GIF_ALLOC_CALLBACK *pfnAlloc, GIF_FREE_CALLBACK *pfnFree);
+    // The decoder workspace (GIFWORK, about 20K) is normally part of every
+    // object, so decoding never allocates it. Define GIF_SPLIT_WORKSPACE to
+    // leave it out: each object is that much smaller and only gets one (from
+    // setWorkspace, a pool or the allocator) once it decodes a frame. Without
+    // the define, setWorkspace() and setWorkPool() return GIF_UNSUPPORTED_FEATURE
+    // and getWorkspaceSize() is just informational.
+    int setWorkspace(void *pBuf, int32_t iSize);
+    int32_t getWorkspaceSize();
+    // A pool can be set up in any build, but setWorkPool() returns
+    // GIF_UNSUPPORTED_FEATURE unless GIF_SPLIT_WORKSPACE is defined.
+    int setWorkPool(GIFWORKPOOL *pPool);
+    static int32_t getWorkPoolSize(int iSlots, int32_t iSlotSize = 0);
+    static GIFWORKPOOL *initWorkPool(void *pMem, int32_t iMemSize, int iSlots, int32_t iSlotSize = 0);
+    static void setWorkPoolLock(GIFWORKPOOL *pPool, GIF_LOCK_CALLBACK *pfnLock, void *pUser);
+    static void closeWorkPool(GIFWORKPOOL *pPool);
+    int32_t getReadCount();
+    int32_t getBytesMoved();
     int setDrawType(int iType);
     int freeFrameBuf(GIF_FREE_CALLBACK *pfnFree);
     int freeTurboBuf(GIF_FREE_CALLBACK *pfnFree);
@@ -250,30 +514,215 @@ class AnimatedGIF
     int getCanvasHeight();
     int getLoopCount();
     int getInfo(GIFINFO *pInfo);
+    int buildIndex(GIFFRAME *pFrames, int iMaxFrames);
+    int seekFrame(int iFrame);
+    int gotoFrame(int iFrame);
+    int setSnapshotBuf(void *pBuf, int32_t iBufSize, int iInterval = 0);
+    int setBakeBuf(void *pBuf, int32_t iBufSize);
+    int getBakedFrames();
+    int getCurrentFrame();
+#ifdef __LINUX__
+    int playParallel(int iThreads, void *pUser = NULL);
+    int32_t writeFast(uint8_t *pOut, int32_t iOutSize);
+    int startDecodeAhead(int iFrames, int iLoops = 0);
+    int getDecodedFrame(GIFRINGFRAME *pFrame);
+    void releaseDecodedFrame();
+    void stopDecodeAhead();
+#endif
+    int getDirtyRect(int *pX, int *pY, int *pWidth, int *pHeight);
     int getLastError();
     int getComment(char *destBuffer);
     void mergeTransparent(uint8_t *pSrc, uint8_t *pDst, uint8_t ucTrans, int iLen);
     void cookPixels(uint8_t *pSrc, uint8_t *pDst, int iTrans, int iLen, uint32_t *pPalette, uint16_t *pRGB565);
+    static int setSIMD(int iLevel);
 
-  private:
+  protected:
     GIFIMAGE _gif;
 };
+//
+// AnimatedGIF with a compile-time line buffer and a functor draw sink
+// Sink is any class with void operator()(GIFDRAW *pDraw). Lines still reach
+// it through the GIFDRAW function pointer (a static function for each
+// Sink type which calls the instance's sink), so each line costs one
+// indirect call, as with AnimatedGIF; the sink just keeps its own state
+// instead of going through pUser.
+// Canvases up to MaxWidth pixels use a line buffer inside the object
+// (see setLineBuf) when MaxWidth is wider than MAX_WIDTH, or with
+// GIF_SPLIT_WORKSPACE (so the workspace doesn't carry the line);
+// otherwise the one built into GIFIMAGE is used. The decoder keeps
+// pointers into the object, so it can't be copied. Everything else
+// works like AnimatedGIF; pUser is taken by the sink, so it has no
+// pUser parameters.
+//
+template <int iSize, bool bOwn>
+struct GIFLineStore
+{
+    uint8_t *lineBuf() { return _ucLineBuf; }
+    uint8_t _ucLineBuf[iSize];
+};
+template <int iSize>
+struct GIFLineStore<iSize, false> // empty; takes no room as a base class
+{
+    uint8_t *lineBuf() { return NULL; }
+};
+#ifdef GIF_SPLIT_WORKSPACE
+#define GIF_OWN_LINE(w) true
+#else
+#define GIF_OWN_LINE(w) ((w) > MAX_WIDTH)
+#endif
+template <typename Sink, int MaxWidth = MAX_WIDTH>
+class AnimatedGIFT : private AnimatedGIF, private GIFLineStore<MaxWidth + 15, GIF_OWN_LINE(MaxWidth)>
+{
+    typedef GIFLineStore<MaxWidth + 15, GIF_OWN_LINE(MaxWidth)> LineStore;
+  public:
+    AnimatedGIFT() : _sink() {}
+    explicit AnimatedGIFT(const Sink &sink) : _sink(sink) {}
+    AnimatedGIFT(const AnimatedGIFT &) = delete; // the line buffer and pUser point into this object
+    AnimatedGIFT &operator=(const AnimatedGIFT &) = delete;
+    Sink &sink() { return _sink; }
+    void begin(uint8_t ucPaletteType = GIF_PALETTE_RGB565_LE) {
+        AnimatedGIF::begin(ucPaletteType);
+        if (LineStore::lineBuf())
+            AnimatedGIF::setLineBuf(LineStore::lineBuf(), MaxWidth + 15);
+    }
+    int open(uint8_t *pData, int iDataSize) { return attach(AnimatedGIF::open(pData, iDataSize, drawLine)); }
+    int openFLASH(uint8_t *pData, int iDataSize) { return attach(AnimatedGIF::openFLASH(pData, iDataSize, drawLine)); }
+    int openFast(uint8_t *pData, int iDataSize) { return attach(AnimatedGIF::openFast(pData, iDataSize, drawLine)); }
+    int openFeed(uint8_t *pBuf, int32_t iBufSize) { return attach(AnimatedGIF::openFeed(pBuf, iBufSize, drawLine)); }
+    int feed(const uint8_t *pData, int32_t iLen, GIFFEEDINFO *pInfo = NULL) { return AnimatedGIF::feed(pData, iLen, pInfo, this); }
+#ifdef __LINUX__
+    int open(const char *szFilename) { return attach(AnimatedGIF::open(szFilename, drawLine)); }
+    int openMapped(const char *szFilename) { return attach(AnimatedGIF::openMapped(szFilename, drawLine)); }
+    int playParallel(int iThreads) { return AnimatedGIF::playParallel(iThreads, this); }
+#endif
+    int open(const char *szFilename, GIF_OPEN_CALLBACK *pfnOpen, GIF_CLOSE_CALLBACK *pfnClose, GIF_READ_CALLBACK *pfnRead, GIF_SEEK_CALLBACK *pfnSeek) {
+        return attach(AnimatedGIF::open(szFilename, pfnOpen, pfnClose, pfnRead, pfnSeek, drawLine));
+    }
+    int playFrame(bool bSync, int *delayMilliseconds = NULL) { return AnimatedGIF::playFrame(bSync, delayMilliseconds, this); }
+    int decodeStep(int iRows, int32_t iMicros, int *delayMilliseconds = NULL) { return AnimatedGIF::decodeStep(iRows, iMicros, delayMilliseconds, this); }
+    using AnimatedGIF::close;
+    using AnimatedGIF::reset;
+    using AnimatedGIF::getCanvasWidth;
+    using AnimatedGIF::getCanvasHeight;
+    using AnimatedGIF::getFrameWidth;
+    using AnimatedGIF::getFrameHeight;
+    using AnimatedGIF::getFrameXOff;
+    using AnimatedGIF::getFrameYOff;
+    using AnimatedGIF::allocTurboBuf;
+    using AnimatedGIF::allocFrameBuf;
+    using AnimatedGIF::setTurboBuf;
+    using AnimatedGIF::setFrameBuf;
+    using AnimatedGIF::setStripBuf;
+    using AnimatedGIF::setSpanBuf;
+    using AnimatedGIF::setCompareOnWrite;
+    using AnimatedGIF::setScale;
+    using AnimatedGIF::setViewport;
+    using AnimatedGIF::setStretch;
+    using AnimatedGIF::getStretchRect;
+    using AnimatedGIF::setReadBuf;
+    using AnimatedGIF::setPaletteCache;
+    using AnimatedGIF::setAllocator;
+    using AnimatedGIF::setWorkspace;
+    using AnimatedGIF::getWorkspaceSize;
+    using AnimatedGIF::setWorkPool;
+    using AnimatedGIF::getWorkPoolSize;
+    using AnimatedGIF::initWorkPool;
+    using AnimatedGIF::closeWorkPool;
+    using AnimatedGIF::getReadCount;
+    using AnimatedGIF::getBytesMoved;
+    using AnimatedGIF::setDrawType;
+    using AnimatedGIF::freeFrameBuf;
+    using AnimatedGIF::freeTurboBuf;
+    using AnimatedGIF::getFrameBuf;
+    using AnimatedGIF::getTurboBuf;
+    using AnimatedGIF::getLoopCount;
+    using AnimatedGIF::getInfo;
+    using AnimatedGIF::buildIndex;
+    using AnimatedGIF::seekFrame;
+    using AnimatedGIF::gotoFrame;
+    using AnimatedGIF::setSnapshotBuf;
+    using AnimatedGIF::setBakeBuf;
+    using AnimatedGIF::getBakedFrames;
+    using AnimatedGIF::getCurrentFrame;
+#ifdef __LINUX__
+    using AnimatedGIF::writeFast;
+    using AnimatedGIF::startDecodeAhead;
+    using AnimatedGIF::getDecodedFrame;
+    using AnimatedGIF::releaseDecodedFrame;
+    using AnimatedGIF::stopDecodeAhead;
+#endif
+    using AnimatedGIF::getDirtyRect;
+    using AnimatedGIF::getLastError;
+    using AnimatedGIF::getComment;
+    using AnimatedGIF::mergeTransparent;
+    using AnimatedGIF::cookPixels;
+    using AnimatedGIF::setSIMD;
+
+  private:
+    // lines can be drawn before the first playFrame() (e.g. by gotoFrame)
+    int attach(int rc) { _gif.pUser = this; return rc; }
+    static void drawLine(GIFDRAW *pDraw) { static_cast<AnimatedGIFT *>(pDraw->pUser)->_sink(pDraw); }
+    Sink _sink;
+};
 #else
 // C interface
     int GIF_openRAM(GIFIMAGE *pGIF, uint8_t *pData, int iDataSize, GIF_DRAW_CALLBACK *pfnDraw);
     int GIF_openFile(GIFIMAGE *pGIF, const char *szFilename, GIF_DRAW_CALLBACK *pfnDraw);
+    int GIF_openFast(GIFIMAGE *pGIF, uint8_t *pData, int iDataSize, GIF_DRAW_CALLBACK *pfnDraw);
+    int GIF_openFeed(GIFIMAGE *pGIF, uint8_t *pBuf, int32_t iBufSize, GIF_DRAW_CALLBACK *pfnDraw);
+    int GIF_feed(GIFIMAGE *pGIF, const uint8_t *pData, int32_t iLen, GIFFEEDINFO *pInfo, void *pUser);
+#ifdef __LINUX__
+    int GIF_openMapped(GIFIMAGE *pGIF, const char *szFilename, GIF_DRAW_CALLBACK *pfnDraw);
+#endif
     void GIF_close(GIFIMAGE *pGIF);
     void GIF_begin(GIFIMAGE *pGIF, unsigned char ucPaletteType);
     void GIF_reset(GIFIMAGE *pGIF);
     int GIF_playFrame(GIFIMAGE *pGIF, int *delayMilliseconds, void *pUser);
+    int GIF_decodeStep(GIFIMAGE *pGIF, int iRows, int32_t iMicros, int *delayMilliseconds, void *pUser);
     int GIF_getCanvasWidth(GIFIMAGE *pGIF);
     int GIF_getCanvasHeight(GIFIMAGE *pGIF);
     int GIF_getComment(GIFIMAGE *pGIF, char *destBuffer);
     int GIF_getInfo(GIFIMAGE *pGIF, GIFINFO *pInfo);
+    int GIF_buildIndex(GIFIMAGE *pGIF, GIFFRAME *pFrames, int iMaxFrames);
+    int GIF_seekFrame(GIFIMAGE *pGIF, int iFrame);
+    int GIF_gotoFrame(GIFIMAGE *pGIF, int iFrame);
+    int GIF_setSnapshotBuf(GIFIMAGE *pGIF, void *pBuf, int32_t iBufSize, int iInterval);
+    int GIF_setBakeBuf(GIFIMAGE *pGIF, void *pBuf, int32_t iBufSize);
+    int GIF_getBakedFrames(GIFIMAGE *pGIF);
+#ifdef __LINUX__
+    int GIF_playParallel(GIFIMAGE *pGIF, int iThreads, void *pUser);
+    int32_t GIF_writeFast(GIFIMAGE *pGIF, uint8_t *pOut, int32_t iOutSize);
+    int GIF_startDecodeAhead(GIFIMAGE *pGIF, int iFrames, int iLoops);
+    int GIF_getDecodedFrame(GIFIMAGE *pGIF, GIFRINGFRAME *pFrame);
+    void GIF_releaseDecodedFrame(GIFIMAGE *pGIF);
+    void GIF_stopDecodeAhead(GIFIMAGE *pGIF);
+#endif
+    int GIF_getDirtyRect(GIFIMAGE *pGIF, int *pX, int *pY, int *pWidth, int *pHeight);
     int GIF_getLastError(GIFIMAGE *pGIF);
     int GIF_getLoopCount(GIFIMAGE *pGIF);
+    int GIF_setStripBuf(GIFIMAGE *pGIF, void *pStripBuf, int iLines);
+    int GIF_setSpanBuf(GIFIMAGE *pGIF, uint16_t *pSpans, int iMaxSpans);
+    int GIF_setCompareOnWrite(GIFIMAGE *pGIF, int bCompare);
+    int GIF_setScale(GIFIMAGE *pGIF, int iScale, int iFilter);
+    int GIF_setViewport(GIFIMAGE *pGIF, int x, int y, int w, int h);
+    int GIF_setStretch(GIFIMAGE *pGIF, void *pOut, int iWidth, int iHeight, int iPitch, int iFilter, uint32_t *pTable);
+    int GIF_getStretchRect(GIFIMAGE *pGIF, int *pX, int *pY, int *pWidth, int *pHeight);
+    int GIF_setReadBuf(GIFIMAGE *pGIF, void *pReadBuf, int32_t iSize);
+    int GIF_setPaletteCache(GIFIMAGE *pGIF, void *pBuf, int32_t iSize);
+    int GIF_setLineBuf(GIFIMAGE *pGIF, void *pBuf, int32_t iSize);
+    void GIF_setAllocator(GIFIMAGE *pGIF, GIF_ALLOC_CALLBACK *pfnAlloc, GIF_FREE_CALLBACK *pfnFree);
+    int GIF_setWorkspace(GIFIMAGE *pGIF, void *pBuf, int32_t iSize);
+    int32_t GIF_getWorkspaceSize(GIFIMAGE *pGIF);
+    int32_t GIF_getWorkPoolSize(int iSlots, int32_t iSlotSize);
+    GIFWORKPOOL *GIF_initWorkPool(void *pMem, int32_t iMemSize, int iSlots, int32_t iSlotSize);
+    void GIF_setWorkPoolLock(GIFWORKPOOL *pPool, GIF_LOCK_CALLBACK *pfnLock, void *pUser);
+    void GIF_closeWorkPool(GIFWORKPOOL *pPool);
+    int GIF_setWorkPool(GIFIMAGE *pGIF, GIFWORKPOOL *pPool);
+    int32_t GIF_getReadCount(GIFIMAGE *pGIF);
+    int32_t GIF_getBytesMoved(GIFIMAGE *pGIF);
     void GIF_mergeTransparent(uint8_t *pSrc, uint8_t *pDst, uint8_t ucTrans, int iLen);
     void GIF_cookPixels(uint8_t *pSrc, uint8_t *pDst, int iTrans, int iLen, uint32_t *pPalette, uint16_t *pRGB565);
+    int GIF_setSIMD(int iLevel);
 #endif // __cplusplus
 
 #if (INTPTR_MAX == INT64_MAX)
@@ -267,24 +267,28 @@ int GIFPlayer::play(int x, int y, bool bDelay)
     _x = x; _y = y;
     cw = _gif.getCanvasWidth();
     ch = _gif.getCanvasHeight();
-    w = _gif.getFrameWidth();
-    h = _gif.getFrameHeight();
-    iX = _gif.getFrameXOff();
-    iY = _gif.getFrameYOff();
     rc = _gif.playFrame(bDelay, NULL);
     if (!rc) _gif.reset(); // loop forever
+    // only the pixels which changed value need to be sent to the display
+    _gif.getDirtyRect(&iX, &iY, &w, &h);
     // Update the display with the new pixels
 #ifdef __ONEBITDISPLAY__
+    if (w == 0) // nothing changed
+        return rc;
+    // each byte holds 8 rows, so the dirty rect is rounded out to whole pages
     pPixels = (uint8_t *)(_gif.getFrameBuf() + (cw * ch));
+    pPixels += iX + ((iY/8) * cw);
     d = (uint8_t *)_pLCD->getBuffer();
-    d += x + ((y/8) * _pLCD->width());
-    for (int ty=0; ty<h+7; ty+=8) {
-        memcpy(d, pPixels, cw);
+    d += x + iX + (((y/8) + (iY/8)) * _pLCD->width());
+    for (ty = (iY & ~7); ty < ((iY + h + 7) & ~7); ty += 8) {
+        memcpy(d, pPixels, w);
         d += _pLCD->width(); // columns = bytes per row
         pPixels += cw; // source pitch = canvas width
     }
     _pLCD->display();
 #else
+    if (w == 0) // nothing changed
+        return rc;
     _pLCD->setAddrWindow(_x + iX, _y + iY, w, h);
         pPixels = (uint16_t *)(_gif.getFrameBuf() + (cw * ch)); // cooked pixels start here
         pPixels += iX + (iY * cw);
@@ -27,26 +27,156 @@
 #if (__ARM_ARCH >= 7) || defined(__arm64__) || defined(__aarch64__)
 #include <arm_neon.h>
 #define HAS_NEON
-#endif 
+#endif
+// SSE2 is part of the x64 baseline; AVX2 is detected at runtime (CPUID)
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define HAS_SSE2
+#if defined(__GNUC__)
+#include <immintrin.h>
+#define HAS_AVX2
+#endif // GCC/Clang
+#endif // x86
+#ifdef __MACH__
+#include <time.h>
+#endif
+#ifdef __LINUX__
+#include <pthread.h>
+#include <stddef.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// DecodeLZWTurbo option: leave the decoded pixels in the Turbo buffer without drawing them
+#define GIF_DECODE_ONLY 1
+// Decoded frame cache states (see GIF_setBakeBuf)
+#define GIF_BAKE_OFF 0
+#define GIF_BAKE_WAITING 1
+#define GIF_BAKE_RECORDING 2
+#define GIF_BAKE_COMPLETE 3
+// push mode states (see GIFOpenFeed)
+#define GIF_FEED_OFF 0
+#define GIF_FEED_HEADER 1
+#define GIF_FEED_FRAME 2
+#define GIF_FEED_DECODE 3
+#define GIF_FEED_SKIP 4
+#define GIF_FEED_END 5
+// the decoder can stop in the middle of a frame and return (push mode or decodeStep)
+#define GIF_SUSPENDS(p) ((p)->ucFeedState || (p)->bStepFrame)
+// Size of a position or length in the file after scaling (see GIF_setScale)
+#define GIF_SCALED(p, v) (((v) + (1 << (p)->ucScale) - 1) >> (p)->ucScale)
+// Decoded lines have to go through GIFScaleLine() before they're used
+#define GIF_LINE_MAPPED(p) ((p)->ucScale || (p)->iViewWidth)
+#ifdef GIF_SPLIT_WORKSPACE
+#define GIF_WORK(p) ((p)->pWork)
+#else
+#define GIF_WORK(p) (&(p)->work)
+#endif
+// shared workspaces (see GIFInitWorkPool)
+struct gif_work_pool_tag
+{
+#ifdef __LINUX__
+    pthread_mutex_t mutex;
+#endif
+    GIF_LOCK_CALLBACK *pfnLock; // caller's lock (see GIF_setWorkPoolLock)
+    void *pLockUser; // passed to pfnLock
+    int32_t iSlotSize; // bytes of workspace in each slot
+    int iSlots, iFree; // number of slots, number on the free stack
+    int iMisses; // times a borrower found no free slot
+    uint8_t **pFree; // stack of free slots
+};
 
 static const unsigned char cGIFBits[9] = {1,4,4,4,8,8,8,8,8}; // convert odd bpp values to ones we can handle
 typedef void (GIF_MAKE_PELS)(GIFIMAGE *pFile, unsigned int code);
+typedef void (GIF_COOK_LINE)(GIFIMAGE *pPage, GIFDRAW *pDraw, void *pDest);
+#if defined(__GNUC__) || defined(__clang__)
+#define GIF_INLINE inline __attribute__((always_inline))
+#else
+#define GIF_INLINE inline
+#endif
 // forward references
 static int GIFInit(GIFIMAGE *pGIF);
 static int GIFParseInfo(GIFIMAGE *pPage, int bInfoOnly);
+static int GIFIsFast(const uint8_t *pData, int32_t iSize);
+static int GIFParseFast(GIFIMAGE *pPage, int bInfoOnly);
 static int GIFGetMoreData(GIFIMAGE *pPage);
+static int32_t GIFRead(GIFIMAGE *pPage, uint8_t *pBuf, int32_t iLen);
+static void GIFSeek(GIFIMAGE *pPage, int32_t iPosition);
 static void GIFMakePels(GIFIMAGE *pPage, unsigned int code);
+static void GIFInitDraw(GIFIMAGE *pPage, GIFDRAW *pDraw);
+static void GIFSelectCook(GIFIMAGE *pPage, GIFDRAW *pDraw);
+static void GIFScaleCanvas(GIFIMAGE *pPage);
+static void GIFScaleFrame(GIFIMAGE *pPage);
+static int GIFScaleLine(GIFIMAGE *pPage, GIFDRAW *pDraw, uint8_t *pFrame);
+static uint8_t *GIFStripLine(GIFIMAGE *pPage, GIFDRAW *pDraw);
+static void GIFStripAdd(GIFIMAGE *pPage, GIFDRAW *pDraw, uint8_t *pLine, int bLastLine);
 
 static void GIFMakeRGB565Pels(GIFIMAGE *pPage, unsigned int code);
 static int DecodeLZW(GIFIMAGE *pImage, int iOptions);
 static int DecodeLZWTurbo(GIFIMAGE *pImage, int iOptions);
+static void GIFTurboOutput(GIFIMAGE *pImage, uint8_t *buf);
+static void GIFDisposePrevious(GIFIMAGE *pImage);
+static void GIFSavePrevious(GIFIMAGE *pImage);
+static void GIFDirtyStart(GIFIMAGE *pPage);
+static void GIFDirtyRow(GIFIMAGE *pPage, GIFDRAW *pDraw);
+static void GIFDrawChanged(GIFIMAGE *pPage, GIFDRAW *pDraw, void *pDest);
+static int GIFGetDirtyRect(GIFIMAGE *pPage, int *pX, int *pY, int *pWidth, int *pHeight);
+static int GIFSetStretch(GIFIMAGE *pPage, void *pOut, int iWidth, int iHeight, int iPitch, int iFilter, uint32_t *pTable);
+static int GIFGetStretchRect(GIFIMAGE *pPage, int *pX, int *pY, int *pWidth, int *pHeight);
+static void GIFStretchFrame(GIFIMAGE *pPage);
+static int GIFSetPaletteCache(GIFIMAGE *pPage, void *pBuf, int32_t iSize);
+static void GIFLocalPalette(GIFIMAGE *pPage, uint8_t *pRaw, int iColors);
+static int GIFSetLineBuf(GIFIMAGE *pPage, void *pBuf, int32_t iSize);
+static int GIFPrepareLineBuf(GIFIMAGE *pPage);
+static void GIFFreeLineBuf(GIFIMAGE *pPage);
+static int32_t GIFWorkSize(GIFIMAGE *pPage);
+static int GIFSetWorkspace(GIFIMAGE *pPage, void *pBuf, int32_t iSize);
+static int GIFPrepareWork(GIFIMAGE *pPage);
+static void GIFFreeWork(GIFIMAGE *pPage);
+#ifdef GIF_SPLIT_WORKSPACE
+static uint8_t *GIFPoolGet(GIFWORKPOOL *pPool);
+static void GIFPoolPut(GIFWORKPOOL *pPool, uint8_t *p);
+#endif
+static void GIFReleaseWork(GIFIMAGE *pPage);
+static int32_t GIFWorkPoolSize(int iSlots, int32_t iSlotSize);
+static GIFWORKPOOL *GIFInitWorkPool(void *pMem, int32_t iMemSize, int iSlots, int32_t iSlotSize);
+static void GIFCloseWorkPool(GIFWORKPOOL *pPool);
+static void GIFSetWorkPoolLock(GIFWORKPOOL *pPool, GIF_LOCK_CALLBACK *pfnLock, void *pUser);
+static int GIFSetWorkPool(GIFIMAGE *pPage, GIFWORKPOOL *pPool);
+static int GIFDecodeStep(GIFIMAGE *pPage, int iRows, int32_t iMicros, int *delayMilliseconds, void *pUser);
+static void GIFDropStep(GIFIMAGE *pPage);
+static int GIFMoreFrames(GIFIMAGE *pPage);
+static int GIFOpenFeed(GIFIMAGE *pPage, uint8_t *pBuf, int32_t iBufSize, GIF_DRAW_CALLBACK *pfnDraw);
+static int GIFFeed(GIFIMAGE *pPage, const uint8_t *pData, int32_t iLen, GIFFEEDINFO *pInfo, void *pUser);
 static int32_t readMem(GIFFILE *pFile, uint8_t *pBuf, int32_t iLen);
 static int32_t seekMem(GIFFILE *pFile, int32_t iPosition);
 int GIF_getInfo(GIFIMAGE *pPage, GIFINFO *pInfo);
+int GIF_buildIndex(GIFIMAGE *pPage, GIFFRAME *pFrames, int iMaxFrames);
+int GIF_seekFrame(GIFIMAGE *pPage, int iFrame);
+int GIF_gotoFrame(GIFIMAGE *pPage, int iFrame);
+#ifdef __LINUX__
+int GIF_playParallel(GIFIMAGE *pPage, int iThreads, void *pUser);
+int32_t GIF_writeFast(GIFIMAGE *pPage, uint8_t *pOut, int32_t iOutSize);
+int GIF_startDecodeAhead(GIFIMAGE *pPage, int iFrames, int iLoops);
+int GIF_getDecodedFrame(GIFIMAGE *pPage, GIFRINGFRAME *pFrame);
+void GIF_releaseDecodedFrame(GIFIMAGE *pPage);
+void GIF_stopDecodeAhead(GIFIMAGE *pPage);
+#endif
+static void GIFSaveSnapshot(GIFIMAGE *pPage);
+static int GIFBakeReplay(GIFIMAGE *pPage);
+static void GIFBakeSave(GIFIMAGE *pPage);
+void GIF_cookPixels(uint8_t *pSrc, uint8_t *pDst, int iTrans, int iLen, uint32_t *pPalette, uint16_t *pRGB565);
+int GIF_setSIMD(int iLevel);
 #if defined( PICO_BUILD ) || defined( __LINUX__ ) || defined( __MCUXPRESSO )
 static int32_t readFile(GIFFILE *pFile, uint8_t *pBuf, int32_t iLen);
 static int32_t seekFile(GIFFILE *pFile, int32_t iPosition);
 static void closeFile(void *handle);
+#ifdef __LINUX__
+static void closeMapped(void *handle);
+#endif
 
 
 // C API
@@ -62,6 +192,30 @@ int GIF_openRAM(GIFIMAGE *pGIF, uint8_t *pData, int iDataSize, GIF_DRAW_CALLBACK
     pGIF->GIFFile.pData = pData;
     return GIFInit(pGIF);
 } /* GIF_openRAM() */
+//
+// Open a fast GIF container (see GIF_writeFast) from memory or FLASH
+// It must have been written for the palette type passed to GIF_begin()
+//
+int GIF_openFast(GIFIMAGE *pGIF, uint8_t *pData, int iDataSize, GIF_DRAW_CALLBACK *pfnDraw)
+{
+    if (!GIFIsFast(pData, iDataSize)) {
+        pGIF->iError = GIF_BAD_FILE;
+        return 0;
+    }
+    return GIF_openRAM(pGIF, pData, iDataSize, pfnDraw);
+} /* GIF_openFast() */
+//
+// Start decoding a GIF which arrives in pieces (see GIFOpenFeed)
+//
+int GIF_openFeed(GIFIMAGE *pGIF, uint8_t *pBuf, int32_t iBufSize, GIF_DRAW_CALLBACK *pfnDraw)
+{
+    return GIFOpenFeed(pGIF, pBuf, iBufSize, pfnDraw);
+} /* GIF_openFeed() */
+
+int GIF_feed(GIFIMAGE *pGIF, const uint8_t *pData, int32_t iLen, GIFFEEDINFO *pInfo, void *pUser)
+{
+    return GIFFeed(pGIF, pData, iLen, pInfo, pUser);
+} /* GIF_feed() */
 
 #ifdef __LINUX__
 int GIF_openFile(GIFIMAGE *pGIF, const char *szFilename, GIF_DRAW_CALLBACK *pfnDraw)
@@ -80,12 +234,68 @@ int GIF_openFile(GIFIMAGE *pGIF, const char *szFilename, GIF_DRAW_CALLBACK *pfnD
     fseek((FILE *)pGIF->GIFFile.fHandle, 0, SEEK_SET);
     return GIFInit(pGIF);
 } /* GIF_openFile() */
+//
+// Open a file by mapping it into memory
+// The data is then accessed directly (like GIF_openRAM) instead of with fread
+//
+int GIF_openMapped(GIFIMAGE *pGIF, const char *szFilename, GIF_DRAW_CALLBACK *pfnDraw)
+{
+    GIFMAP *pMap;
+    struct stat st;
+    int fd;
+
+    pGIF->iError = GIF_SUCCESS;
+    fd = open(szFilename, O_RDONLY);
+    if (fd < 0) {
+        pGIF->iError = GIF_FILE_NOT_OPEN;
+        return 0;
+    }
+    pMap = (GIFMAP *)malloc(sizeof(GIFMAP));
+    if (pMap == NULL || fstat(fd, &st) != 0 || st.st_size <= 0 || st.st_size > 0x7fffffff) {
+        close(fd);
+        free(pMap);
+        pGIF->iError = GIF_FILE_NOT_OPEN;
+        return 0;
+    }
+    pMap->iSize = (size_t)st.st_size;
+    pMap->pData = mmap(NULL, pMap->iSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping stays valid without the file descriptor
+    if (pMap->pData == MAP_FAILED) {
+        free(pMap);
+        pGIF->iError = GIF_FILE_NOT_OPEN;
+        return 0;
+    }
+    // playback reads the file from start to end
+    madvise(pMap->pData, pMap->iSize, MADV_SEQUENTIAL);
+    madvise(pMap->pData, pMap->iSize, MADV_WILLNEED);
+    pGIF->pfnRead = readMem;
+    pGIF->pfnSeek = seekMem;
+    pGIF->pfnDraw = pfnDraw;
+    pGIF->pfnOpen = NULL;
+    pGIF->pfnClose = closeMapped;
+    pGIF->GIFFile.fHandle = pMap;
+    pGIF->GIFFile.iSize = (int32_t)pMap->iSize;
+    pGIF->GIFFile.pData = (uint8_t *)pMap->pData;
+    if (!GIFInit(pGIF)) {
+        closeMapped(pMap);
+        pGIF->pfnClose = NULL;
+        return 0;
+    }
+    return 1;
+} /* GIF_openMapped() */
 #endif
 
 void GIF_close(GIFIMAGE *pGIF)
 {
+#ifdef __LINUX__
+    GIF_stopDecodeAhead(pGIF); // the decoder thread may still be using the file
+#endif
     if (pGIF->pfnClose)
         (*pGIF->pfnClose)(pGIF->GIFFile.fHandle);
+    GIFFreeLineBuf(pGIF);
+    GIFFreeWork(pGIF);
+    pGIF->ucFeedState = GIF_FEED_OFF;
+    pGIF->bStepFrame = 0;
 } /* GIF_close() */
 
 void GIF_begin(GIFIMAGE *pGIF, unsigned char ucPaletteType)
@@ -96,7 +306,11 @@ void GIF_begin(GIFIMAGE *pGIF, unsigned char ucPaletteType)
 
 void GIF_reset(GIFIMAGE *pGIF)
 {
+    if (GIFMoreFrames(pGIF)) // resetting after the last frame is the same as looping
+        pGIF->iBakeNext = -1;
+    GIFDropStep(pGIF);
     (*pGIF->pfnSeek)(&pGIF->GIFFile, 0);
+    pGIF->iCurrentFrame = 0;
 } /* GIF_reset() */
 //
 // Return value:
@@ -110,32 +324,59 @@ int rc;
 
     if (delayMilliseconds)
        *delayMilliseconds = 0; // clear any old valid
+    if (pGIF->ucFeedState != GIF_FEED_OFF) { // frames come from GIF_feed() in push mode
+        pGIF->iError = GIF_INVALID_PARAMETER;
+        return -1;
+    }
+    GIFDropStep(pGIF); // the frame is decoded again as a whole
     if (pGIF->GIFFile.iPos >= pGIF->GIFFile.iSize-1) // no more data exists
     {   
         (*pGIF->pfnSeek)(&pGIF->GIFFile, 0); // seek to start
+        pGIF->iCurrentFrame = 0;
     }
-    if (GIFParseInfo(pGIF, 0))
+    if (pGIF->ucBakeState && GIFBakeReplay(pGIF)) // drawn from the decoded frame cache
     {
         pGIF->pUser = pUser;
-        if (pGIF->iError == GIF_EMPTY_FRAME) // don't try to decode it
+    }
+    else if (GIFParseInfo(pGIF, 0))
+    {
+        pGIF->pUser = pUser;
+        if (pGIF->iError == GIF_EMPTY_FRAME) { // don't try to decode it
+            GIFReleaseWork(pGIF);
             return 0;
+        }
         if (pGIF->pTurboBuffer) { // the presence of the Turbo buffer indicates Turbo mode
             rc = DecodeLZWTurbo(pGIF, 0);
         } else {
             rc = DecodeLZW(pGIF, 0);
         }
+        GIFReleaseWork(pGIF); // a pool workspace is only borrowed for one frame
         if (rc != 0) // problem
             return 0;
+        GIFBakeSave(pGIF);
+        pGIF->iCurrentFrame++;
+        if (pGIF->pSnapBuf)
+            GIFSaveSnapshot(pGIF);
     }
     else
     {
+        GIFReleaseWork(pGIF);
         return 0; // error parsing the frame info, we may be at the end of the file
     }
+    if (pGIF->pStretchBuf)
+        GIFStretchFrame(pGIF);
     // Return 1 for more frames or 0 if this was the last frame
     if (delayMilliseconds) // if not NULL, return the frame delay time
         *delayMilliseconds = pGIF->iFrameDelay;
-    return (pGIF->GIFFile.iPos < pGIF->GIFFile.iSize-1);
+    return GIFMoreFrames(pGIF);
 } /* GIF_playFrame() */
+//
+// Decode part of a frame (see GIFDecodeStep)
+//
+int GIF_decodeStep(GIFIMAGE *pGIF, int iRows, int32_t iMicros, int *delayMilliseconds, void *pUser)
+{
+    return GIFDecodeStep(pGIF, iRows, iMicros, delayMilliseconds, pUser);
+} /* GIF_decodeStep() */
 
 int GIF_getCanvasWidth(GIFIMAGE *pGIF)
 {
@@ -165,11 +406,178 @@ int32_t iOldPos;
 
 } /* GIF_getComment() */
 
+//
+// Return the area of the canvas changed by the last frame
+// returns 0 (and an empty rectangle) if no pixels changed
+//
+int GIF_getDirtyRect(GIFIMAGE *pGIF, int *pX, int *pY, int *pWidth, int *pHeight)
+{
+    return GIFGetDirtyRect(pGIF, pX, pY, pWidth, pHeight);
+} /* GIF_getDirtyRect() */
+
 int GIF_getLastError(GIFIMAGE *pGIF)
 {
     return pGIF->iError;
 } /* GIF_getLastError() */
 
+int GIF_setStripBuf(GIFIMAGE *pGIF, void *pStripBuf, int iLines)
+{
+    if (iLines < 0)
+        return GIF_INVALID_PARAMETER;
+    pGIF->pStripBuf = (uint8_t *)pStripBuf;
+    pGIF->iStripLines = iLines;
+    return GIF_SUCCESS;
+} /* GIF_setStripBuf() */
+
+int GIF_setSpanBuf(GIFIMAGE *pGIF, uint16_t *pSpans, int iMaxSpans)
+{
+    if (pSpans && iMaxSpans < 1)
+        return GIF_INVALID_PARAMETER;
+    pGIF->pSpanBuf = pSpans;
+    pGIF->iSpanMax = (pSpans) ? iMaxSpans : 0;
+    return GIF_SUCCESS;
+} /* GIF_setSpanBuf() */
+
+int GIF_setCompareOnWrite(GIFIMAGE *pGIF, int bCompare)
+{
+    pGIF->bCompare = (bCompare != 0);
+    return GIF_SUCCESS;
+} /* GIF_setCompareOnWrite() */
+
+int GIF_setScale(GIFIMAGE *pGIF, int iScale, int iFilter)
+{
+    int iShift;
+
+    for (iShift=0; iShift<4 && (1 << iShift) != iScale; iShift++) {}
+    if (iShift == 4 || (iFilter != GIF_SCALE_NEAREST && iFilter != GIF_SCALE_BOX))
+        return GIF_INVALID_PARAMETER;
+    pGIF->ucScale = (uint8_t)iShift;
+    pGIF->ucScaleFilter = (uint8_t)iFilter;
+    return GIF_SUCCESS;
+} /* GIF_setScale() */
+
+int GIF_setViewport(GIFIMAGE *pGIF, int x, int y, int w, int h)
+{
+    if (x < 0 || y < 0 || w < 0 || h < 0 || x + w > 32767 || y + h > 32767)
+        return GIF_INVALID_PARAMETER;
+    if (w == 0 || h == 0)
+        x = y = w = h = 0;
+    pGIF->iViewX = (uint16_t)x; pGIF->iViewY = (uint16_t)y;
+    pGIF->iViewWidth = (uint16_t)w; pGIF->iViewHeight = (uint16_t)h;
+    return GIF_SUCCESS;
+} /* GIF_setViewport() */
+
+int GIF_setStretch(GIFIMAGE *pGIF, void *pOut, int iWidth, int iHeight, int iPitch, int iFilter, uint32_t *pTable)
+{
+    return GIFSetStretch(pGIF, pOut, iWidth, iHeight, iPitch, iFilter, pTable);
+} /* GIF_setStretch() */
+
+int GIF_getStretchRect(GIFIMAGE *pGIF, int *pX, int *pY, int *pWidth, int *pHeight)
+{
+    return GIFGetStretchRect(pGIF, pX, pY, pWidth, pHeight);
+} /* GIF_getStretchRect() */
+
+int GIF_setReadBuf(GIFIMAGE *pGIF, void *pBuf, int32_t iBufSize)
+{
+    if (pBuf && iBufSize < MAX_CHUNK_SIZE+1)
+        return GIF_INVALID_PARAMETER;
+    pGIF->pReadBuf = (uint8_t *)pBuf;
+    pGIF->iReadBufSize = (pBuf) ? iBufSize : 0;
+    pGIF->iReadBufLen = 0;
+    return GIF_SUCCESS;
+} /* GIF_setReadBuf() */
+
+int GIF_setPaletteCache(GIFIMAGE *pGIF, void *pBuf, int32_t iSize)
+{
+    return GIFSetPaletteCache(pGIF, pBuf, iSize);
+} /* GIF_setPaletteCache() */
+
+int GIF_setLineBuf(GIFIMAGE *pGIF, void *pBuf, int32_t iSize)
+{
+    return GIFSetLineBuf(pGIF, pBuf, iSize);
+} /* GIF_setLineBuf() */
+
+void GIF_setAllocator(GIFIMAGE *pGIF, GIF_ALLOC_CALLBACK *pfnAlloc, GIF_FREE_CALLBACK *pfnFree)
+{
+    GIFFreeLineBuf(pGIF); // allocated by the old functions
+    GIFFreeWork(pGIF);
+    pGIF->pfnAlloc = pfnAlloc;
+    pGIF->pfnFree = pfnFree;
+} /* GIF_setAllocator() */
+
+int GIF_setWorkspace(GIFIMAGE *pGIF, void *pBuf, int32_t iSize)
+{
+    return GIFSetWorkspace(pGIF, pBuf, iSize);
+} /* GIF_setWorkspace() */
+
+int32_t GIF_getWorkspaceSize(GIFIMAGE *pGIF)
+{
+    return GIFWorkSize(pGIF);
+} /* GIF_getWorkspaceSize() */
+
+int32_t GIF_getWorkPoolSize(int iSlots, int32_t iSlotSize)
+{
+    return GIFWorkPoolSize(iSlots, iSlotSize);
+} /* GIF_getWorkPoolSize() */
+
+GIFWORKPOOL *GIF_initWorkPool(void *pMem, int32_t iMemSize, int iSlots, int32_t iSlotSize)
+{
+    return GIFInitWorkPool(pMem, iMemSize, iSlots, iSlotSize);
+} /* GIF_initWorkPool() */
+
+void GIF_closeWorkPool(GIFWORKPOOL *pPool)
+{
+    GIFCloseWorkPool(pPool);
+} /* GIF_closeWorkPool() */
+
+void GIF_setWorkPoolLock(GIFWORKPOOL *pPool, GIF_LOCK_CALLBACK *pfnLock, void *pUser)
+{
+    GIFSetWorkPoolLock(pPool, pfnLock, pUser);
+} /* GIF_setWorkPoolLock() */
+
+int GIF_setWorkPool(GIFIMAGE *pGIF, GIFWORKPOOL *pPool)
+{
+    return GIFSetWorkPool(pGIF, pPool);
+} /* GIF_setWorkPool() */
+
+int32_t GIF_getReadCount(GIFIMAGE *pGIF)
+{
+    return pGIF->iReadCount;
+} /* GIF_getReadCount() */
+
+int32_t GIF_getBytesMoved(GIFIMAGE *pGIF)
+{
+    return pGIF->iBytesMoved;
+} /* GIF_getBytesMoved() */
+
+int GIF_setSnapshotBuf(GIFIMAGE *pGIF, void *pBuf, int32_t iBufSize, int iInterval)
+{
+    if (iBufSize < 0 || iInterval < 0)
+        return GIF_INVALID_PARAMETER;
+    pGIF->pSnapBuf = (uint8_t *)pBuf;
+    pGIF->iSnapBufSize = (pBuf) ? iBufSize : 0;
+    pGIF->iSnapInterval = iInterval;
+    pGIF->iSnapSize = 0; // slots are laid out on the next save
+    pGIF->iSnapCount = 0;
+    return GIF_SUCCESS;
+} /* GIF_setSnapshotBuf() */
+
+int GIF_setBakeBuf(GIFIMAGE *pGIF, void *pBuf, int32_t iBufSize)
+{
+    if (iBufSize < 0)
+        return GIF_INVALID_PARAMETER;
+    pGIF->pBakeBuf = (uint8_t *)pBuf;
+    pGIF->iBakeBufSize = (pBuf) ? iBufSize : 0;
+    pGIF->ucBakeState = (pBuf) ? GIF_BAKE_WAITING : GIF_BAKE_OFF;
+    pGIF->iBakeFrames = 0;
+    return GIF_SUCCESS;
+} /* GIF_setBakeBuf() */
+
+int GIF_getBakedFrames(GIFIMAGE *pGIF)
+{
+    return (pGIF->ucBakeState == GIF_BAKE_COMPLETE) ? pGIF->iBakeFrames : 0;
+} /* GIF_getBakedFrames() */
+
 #endif // !__cplusplus
 //
 // Helper functions for memory based images
@@ -217,6 +625,14 @@ static void closeFile(void *handle)
 {
     fclose((FILE *)handle);
 } /* closeFile() */
+#ifdef __LINUX__
+static void closeMapped(void *handle)
+{
+    GIFMAP *pMap = (GIFMAP *)handle;
+    munmap(pMap->pData, pMap->iSize);
+    free(pMap);
+} /* closeMapped() */
+#endif
 
 static int32_t seekFile(GIFFILE *pFile, int32_t iPosition)
 {
@@ -254,15 +670,438 @@ static int32_t readFile(GIFFILE *pFile, uint8_t *pBuf, int32_t iLen)
 static int GIFInit(GIFIMAGE *pGIF)
 {
     pGIF->GIFFile.iPos = 0; // start at beginning of file
+    pGIF->pFrameIndex = NULL; // any old index belongs to a different file
+    pGIF->iFrameCount = 0;
+    pGIF->iCurrentFrame = 0;
+    pGIF->iSnapSize = 0; // snapshot layout is set up on the first save
+    pGIF->iBakeNext = -1; // the frame buffer hasn't seen a full pass of this file
+    pGIF->iBakeFrames = 0;
+    if (pGIF->ucBakeState)
+        pGIF->ucBakeState = GIF_BAKE_WAITING;
+    pGIF->iReadBufLen = 0; // the read buffer contents belong to the old file
+    pGIF->iReadCount = pGIF->iBytesMoved = 0;
+    pGIF->bCookedStale = 1; // the cooked pixels haven't been generated yet
+    if (pGIF->ucFeedState != GIF_FEED_HEADER) // called from feed() in push mode; otherwise opening a file ends it
+        pGIF->ucFeedState = GIF_FEED_OFF;
+    pGIF->bStepFrame = 0;
+    // a fast GIF container in memory is used directly (no de-chunking or palette conversion)
+    pGIF->bFastGIF = (pGIF->pfnRead == readMem && !pGIF->ucFeedState && GIFIsFast(pGIF->GIFFile.pData, pGIF->GIFFile.iSize));
     if (!GIFParseInfo(pGIF, 1)) // gather info for the first frame
        return 0; // something went wrong; not a GIF file?
     (*pGIF->pfnSeek)(&pGIF->GIFFile, 0); // seek back to start of the file
-    if (pGIF->iCanvasWidth > MAX_WIDTH || pGIF->iCanvasHeight > 32767) { // too big or corrupt
+    if (pGIF->iSrcCanvasHeight > 32767) { // too big or corrupt
         pGIF->iError = GIF_TOO_WIDE;
         return 0;
     }
+    if (!GIFPrepareLineBuf(pGIF)) // sets iError
+        return 0;
   return 1;
 } /* GIFInit() */
+//
+// Line buffer
+// The decoder needs one line of the canvas (plus 15 bytes to align it).
+// The caller's buffer from setLineBuf() is used if it's big enough,
+// then the built-in ucLineBuf (MAX_WIDTH pixels), then memory from the
+// allocator given to setAllocator() (malloc without one), which is kept
+// until close(). Like the workspace, it's freed with the free function
+// given to setAllocator() or with free().
+//
+static int GIFSetLineBuf(GIFIMAGE *pPage, void *pBuf, int32_t iSize)
+{
+    if (pBuf && iSize < 16)
+        return GIF_INVALID_PARAMETER;
+    pPage->pLineBuf = (uint8_t *)pBuf;
+    pPage->iLineBufSize = (pBuf) ? iSize : 0;
+    return GIF_SUCCESS;
+} /* GIFSetLineBuf() */
+
+static void GIFFreeLineBuf(GIFIMAGE *pPage)
+{
+    if (pPage->pLineAlloc) {
+        if (pPage->pfnFree)
+            (*pPage->pfnFree)(pPage->pLineAlloc);
+        else
+            free(pPage->pLineAlloc);
+    }
+    pPage->pLineAlloc = NULL;
+    pPage->iLineAllocSize = 0;
+} /* GIFFreeLineBuf() */
+//
+// Pick the line buffer for the canvas width of the file just opened
+// returns 1 for success, 0 if none of them is wide enough
+//
+static int GIFPrepareLineBuf(GIFIMAGE *pPage)
+{
+    int32_t iSize = pPage->iSrcCanvasWidth + 15;
+    uint8_t *p;
+    uint32_t u32;
+
+    if (pPage->pLineBuf && pPage->iLineBufSize >= iSize) {
+        p = pPage->pLineBuf;
+#ifdef GIF_SPLIT_WORKSPACE
+    } else { // the line is at the end of the workspace (see GIFPrepareWork)
+        pPage->pLineBufAligned = NULL;
+        return 1;
+    }
+#else
+    } else if (iSize <= (int32_t)sizeof(pPage->work.ucLineBuf)) {
+        p = pPage->work.ucLineBuf;
+    } else {
+        if (pPage->iLineAllocSize < iSize) { // the one from the last file (if any) is too small
+            GIFFreeLineBuf(pPage);
+            pPage->pLineAlloc = (uint8_t *)((pPage->pfnAlloc) ? (*pPage->pfnAlloc)(iSize) : malloc(iSize));
+            if (pPage->pLineAlloc == NULL) {
+                pPage->iError = GIF_ERROR_MEMORY;
+                return 0;
+            }
+            pPage->iLineAllocSize = iSize;
+        }
+        p = pPage->pLineAlloc;
+    }
+#endif // GIF_SPLIT_WORKSPACE
+    u32 = (uint32_t)(intptr_t)p;
+    u32 &= 15; // align on 16-byte boundary
+    if (u32 > 0) {
+        p += (16-u32);
+    }
+    pPage->pLineBufAligned = p;
+    return 1;
+} /* GIFPrepareLineBuf() */
+//
+// Workspace
+// Bytes needed to decode the current file in the current mode.
+// Classic mode uses the code tables, the LZW buffer and a line of the
+// canvas; Turbo mode (which has its tables in the Turbo buffer) uses all
+// of it as one larger LZW buffer, plus 16 bytes for reads past the end.
+// A fast GIF container needs no LZW buffer, so in Turbo mode it's just
+// the line. The line isn't counted when the setLineBuf() one is used.
+//
+static int32_t GIFWorkSize(GIFIMAGE *pPage)
+{
+    int32_t iLine = pPage->iSrcCanvasWidth + 15;
+
+    if (pPage->pLineBuf && pPage->iLineBufSize >= iLine)
+        iLine = 0;
+    if (pPage->pTurboBuffer && !GIF_SUSPENDS(pPage)) { // frames decoded in pieces use the classic decoder
+        if (pPage->bFastGIF)
+            return iLine;
+        iLine += (int32_t)offsetof(GIFWORK, ucLineBuf);
+        return (iLine > LZW_BUF_SIZE_TURBO + 16) ? iLine : LZW_BUF_SIZE_TURBO + 16;
+    }
+    return (int32_t)offsetof(GIFWORK, ucLineBuf) + iLine;
+} /* GIFWorkSize() */
+
+static int GIFSetWorkspace(GIFIMAGE *pPage, void *pBuf, int32_t iSize)
+{
+#ifdef GIF_SPLIT_WORKSPACE
+    if (pBuf && (iSize <= 0 || ((intptr_t)pBuf & 3)))
+        return GIF_INVALID_PARAMETER;
+    pPage->pWorkBuf = (uint8_t *)pBuf;
+    pPage->iWorkBufSize = (pBuf) ? iSize : 0; // picked again for each frame
+    return GIF_SUCCESS;
+#else
+    (void)pPage; (void)pBuf; (void)iSize;
+    return GIF_UNSUPPORTED_FEATURE; // the workspace is part of GIFIMAGE
+#endif
+} /* GIFSetWorkspace() */
+
+static void GIFFreeWork(GIFIMAGE *pPage)
+{
+#ifdef GIF_SPLIT_WORKSPACE
+    GIFReleaseWork(pPage);
+    if (pPage->pWorkAlloc) {
+        if (pPage->pfnFree)
+            (*pPage->pfnFree)(pPage->pWorkAlloc);
+        else
+            free(pPage->pWorkAlloc);
+    }
+    pPage->pWorkAlloc = NULL;
+    pPage->iWorkAllocSize = 0;
+    pPage->pWork = NULL;
+#else
+    (void)pPage;
+#endif
+} /* GIFFreeWork() */
+//
+// Make sure the workspace is big enough to decode a frame in the current mode
+// The caller's memory (setWorkspace) is used if it's big enough, otherwise
+// memory from the allocator (or malloc) which is kept until close().
+// returns 1 for success, 0 for not enough memory
+//
+static int GIFPrepareWork(GIFIMAGE *pPage)
+{
+#ifdef GIF_SPLIT_WORKSPACE
+    int32_t iSize = GIFWorkSize(pPage);
+    uint8_t *p;
+    uint32_t u32;
+
+    if (pPage->pPoolSlot && iSize > pPage->pWorkPool->iSlotSize) // the mode changed
+        GIFReleaseWork(pPage);
+    // a frame decoded in pieces stays unfinished between calls, so it doesn't borrow
+    if (pPage->pPoolSlot == NULL && pPage->pWorkPool && iSize <= pPage->pWorkPool->iSlotSize && !GIF_SUSPENDS(pPage))
+        pPage->pPoolSlot = GIFPoolGet(pPage->pWorkPool); // kept until the frame is finished
+    if (pPage->pPoolSlot) {
+        p = pPage->pPoolSlot;
+    } else if (pPage->pWorkBuf && pPage->iWorkBufSize >= iSize) {
+        p = pPage->pWorkBuf;
+    } else {
+        if (pPage->iWorkAllocSize < iSize || pPage->pWorkAlloc == NULL) {
+            GIFFreeWork(pPage);
+            p = (uint8_t *)((pPage->pfnAlloc) ? (*pPage->pfnAlloc)(iSize ? iSize : 1) : malloc(iSize ? iSize : 1));
+            if (p == NULL) {
+                pPage->iError = GIF_ERROR_MEMORY;
+                return 0;
+            }
+            pPage->pWorkAlloc = p;
+            pPage->iWorkAllocSize = iSize;
+        }
+        p = pPage->pWorkAlloc;
+    }
+    if (pPage->pTurboBuffer && pPage->bFastGIF && !GIF_SUSPENDS(pPage)) { // only the line
+        pPage->pWork = NULL;
+    } else {
+        pPage->pWork = (GIFWORK *)p;
+        p = pPage->pWork->ucLineBuf;
+    }
+    if (pPage->pLineBuf == NULL || pPage->iLineBufSize < pPage->iSrcCanvasWidth + 15) {
+        u32 = (uint32_t)(intptr_t)p;
+        u32 &= 15; // align on 16-byte boundary
+        if (u32 > 0) {
+            p += (16-u32);
+        }
+        pPage->pLineBufAligned = p;
+    }
+#else
+    (void)pPage;
+#endif
+    return 1;
+} /* GIFPrepareWork() */
+//
+// Workspace pool
+// Instances given the same pool (setWorkPool) borrow a workspace from it
+// for each frame they decode, so the memory needed depends on how many
+// frames are decoded at once, not on how many files are open. The pool
+// and its slots live in the caller's memory (see GIF_getWorkPoolSize).
+// An instance which finds it empty uses its own workspace instead of
+// waiting. On Linux it's thread safe; elsewhere it is too once the caller
+// supplies a lock (GIF_setWorkPoolLock).
+//
+static int32_t GIFWorkPoolSize(int iSlots, int32_t iSlotSize)
+{
+    if (iSlots < 1)
+        return 0;
+    if (iSlotSize <= 0)
+        iSlotSize = (int32_t)sizeof(GIFWORK) + 16; // any classic or Turbo file up to MAX_WIDTH
+    iSlotSize = (iSlotSize + 15) & ~15;
+    return (int32_t)((sizeof(GIFWORKPOOL) + iSlots * sizeof(uint8_t *) + 15) & ~15) + 15 + iSlots * iSlotSize;
+} /* GIFWorkPoolSize() */
+//
+// Set up a pool of iSlots workspaces of iSlotSize bytes (0 = sizeof(GIFWORK) + 16)
+// in pMem; returns NULL if iMemSize is too small (see GIFWorkPoolSize)
+//
+static GIFWORKPOOL *GIFInitWorkPool(void *pMem, int32_t iMemSize, int iSlots, int32_t iSlotSize)
+{
+    GIFWORKPOOL *pPool;
+    uint8_t *p;
+    int i;
+
+    if (pMem == NULL || ((intptr_t)pMem & 7) || iSlots < 1 || iMemSize < GIFWorkPoolSize(iSlots, iSlotSize))
+        return NULL;
+    if (iSlotSize <= 0)
+        iSlotSize = (int32_t)sizeof(GIFWORK) + 16;
+    iSlotSize = (iSlotSize + 15) & ~15;
+    pPool = (GIFWORKPOOL *)pMem;
+    memset(pPool, 0, sizeof(GIFWORKPOOL));
+    pPool->pFree = (uint8_t **)&pPool[1];
+    p = (uint8_t *)&pPool->pFree[iSlots];
+    p += (16 - ((intptr_t)p & 15)) & 15; // slots are 16-byte aligned
+    for (i=0; i<iSlots; i++) {
+        pPool->pFree[i] = &p[i * iSlotSize];
+    }
+    pPool->iSlotSize = iSlotSize;
+    pPool->iSlots = pPool->iFree = iSlots;
+#ifdef __LINUX__
+    pthread_mutex_init(&pPool->mutex, NULL);
+#endif
+    return pPool;
+} /* GIFInitWorkPool() */
+
+static void GIFCloseWorkPool(GIFWORKPOOL *pPool)
+{
+#ifdef __LINUX__
+    if (pPool) {
+        pthread_mutex_destroy(&pPool->mutex);
+    }
+#else
+    (void)pPool;
+#endif
+} /* GIFCloseWorkPool() */
+//
+// Have the pool call pfnLock(pUser, 1) / pfnLock(pUser, 0) around every
+// change to its free list; this makes it safe to share between threads or
+// tasks on systems without pthreads. NULL removes the lock. Set it before
+// any instance uses the pool.
+//
+static void GIFSetWorkPoolLock(GIFWORKPOOL *pPool, GIF_LOCK_CALLBACK *pfnLock, void *pUser)
+{
+    if (pPool) {
+        pPool->pfnLock = pfnLock;
+        pPool->pLockUser = pUser;
+    }
+} /* GIFSetWorkPoolLock() */
+#ifdef GIF_SPLIT_WORKSPACE
+static void GIFPoolLock(GIFWORKPOOL *pPool, int bLock)
+{
+    if (pPool->pfnLock) {
+        (*pPool->pfnLock)(pPool->pLockUser, bLock);
+        return;
+    }
+#ifdef __LINUX__
+    if (bLock)
+        pthread_mutex_lock(&pPool->mutex);
+    else
+        pthread_mutex_unlock(&pPool->mutex);
+#endif
+} /* GIFPoolLock() */
+//
+// Take a workspace from the pool
+// returns NULL if there isn't one free (the caller uses its own)
+//
+static uint8_t *GIFPoolGet(GIFWORKPOOL *pPool)
+{
+    uint8_t *p = NULL;
+
+    GIFPoolLock(pPool, 1);
+    if (pPool->iFree)
+        p = pPool->pFree[--pPool->iFree];
+    else
+        pPool->iMisses++;
+    GIFPoolLock(pPool, 0);
+    return p;
+} /* GIFPoolGet() */
+
+static void GIFPoolPut(GIFWORKPOOL *pPool, uint8_t *p)
+{
+    GIFPoolLock(pPool, 1);
+    pPool->pFree[pPool->iFree++] = p;
+    GIFPoolLock(pPool, 0);
+} /* GIFPoolPut() */
+#endif // GIF_SPLIT_WORKSPACE
+//
+// Give a borrowed workspace back to the pool once a frame is finished
+//
+static void GIFReleaseWork(GIFIMAGE *pPage)
+{
+#ifdef GIF_SPLIT_WORKSPACE
+    if (pPage->pPoolSlot) {
+        GIFPoolPut(pPage->pWorkPool, pPage->pPoolSlot);
+        pPage->pPoolSlot = NULL;
+        pPage->pWork = NULL;
+    }
+#else
+    (void)pPage;
+#endif
+} /* GIFReleaseWork() */
+
+static int GIFSetWorkPool(GIFIMAGE *pPage, GIFWORKPOOL *pPool)
+{
+#ifdef GIF_SPLIT_WORKSPACE
+    GIFReleaseWork(pPage);
+    pPage->pWorkPool = pPool;
+    return GIF_SUCCESS;
+#else
+    (void)pPage; (void)pPool;
+    return GIF_UNSUPPORTED_FEATURE; // the workspace is part of GIFIMAGE
+#endif
+} /* GIFSetWorkPool() */
+//
+// Converted palette cache
+// Local color tables are looked up by a hash of their raw bytes and the
+// output type; a match just points pLocalPal at the cached entries.
+// Slots are replaced round-robin.
+//
+static int GIFSetPaletteCache(GIFIMAGE *pPage, void *pBuf, int32_t iSize)
+{
+    if (pBuf && iSize < (int32_t)sizeof(GIFPALSLOT))
+        return GIF_INVALID_PARAMETER;
+    pPage->pPalCache = (GIFPALSLOT *)pBuf;
+    pPage->iPalSlots = (pBuf) ? (int)(iSize / (int32_t)sizeof(GIFPALSLOT)) : 0;
+    pPage->iPalNext = 0;
+    if (pBuf)
+        memset(pBuf, 0, pPage->iPalSlots * sizeof(GIFPALSLOT));
+    pPage->pLocalPal = pPage->pLocalPalette; // don't point into the old cache
+    return GIF_SUCCESS;
+} /* GIFSetPaletteCache() */
+//
+// Convert iColors raw RGB888 entries to the output palette type
+//
+static void GIFConvertPalette(GIFIMAGE *pPage, uint8_t *p, int iColors, uint16_t *pDst)
+{
+    int i;
+
+    if (pPage->ucPaletteType == GIF_PALETTE_RGB565_LE || pPage->ucPaletteType == GIF_PALETTE_RGB565_BE) {
+        for (i=0; i<iColors; i++) {
+            uint16_t usRGB565;
+            usRGB565 = ((p[0] >> 3) << 11); // R
+            usRGB565 |= ((p[1] >> 2) << 5); // G
+            usRGB565 |= (p[2] >> 3); // B
+            if (pPage->ucPaletteType == GIF_PALETTE_RGB565_LE)
+                pDst[i] = usRGB565;
+            else
+                pDst[i] = __builtin_bswap16(usRGB565); // SPI wants MSB first
+            p += 3;
+        }
+    } else if (pPage->ucPaletteType == GIF_PALETTE_1BPP || pPage->ucPaletteType == GIF_PALETTE_1BPP_OLED) {
+        uint8_t *pPal1 = (uint8_t *)pDst;
+        for (i=0; i<iColors; i++) {
+            uint16_t usGray;
+            usGray = p[0]; // R
+            usGray += p[1]*2; // G is twice as important
+            usGray += p[2]; // B
+            pPal1[i] = (usGray >= 512); // bright enough = 1
+            p += 3;
+        }
+    } else { // just copy it as-is
+        memcpy(pDst, p, iColors * 3);
+    }
+} /* GIFConvertPalette() */
+//
+// Make the local color table at pRaw the active local palette
+//
+static void GIFLocalPalette(GIFIMAGE *pPage, uint8_t *pRaw, int iColors)
+{
+    GIFPALSLOT *pSlot;
+    uint32_t u32, u32Hash = 2166136261u; // FNV-1a, 3 bytes (one entry) at a time
+    int i, iLen = iColors * 3;
+
+    if (pPage->pPalCache == NULL) {
+        GIFConvertPalette(pPage, pRaw, iColors, pPage->pLocalPalette);
+        pPage->pLocalPal = pPage->pLocalPalette;
+        return;
+    }
+    for (i=0; i<iLen; i+=3) {
+        u32 = pRaw[i] | (pRaw[i+1] << 8) | (pRaw[i+2] << 16);
+        u32Hash = (u32Hash ^ u32) * 16777619u;
+    }
+    u32Hash ^= pPage->ucPaletteType;
+    for (i=0; i<pPage->iPalSlots; i++) {
+        pSlot = &pPage->pPalCache[i];
+        if (pSlot->u32Hash == u32Hash && pSlot->iColors == iColors && pSlot->ucPaletteType == pPage->ucPaletteType &&
+            memcmp(pSlot->ucRaw, pRaw, iLen) == 0) {
+            pPage->pLocalPal = pSlot->usPalette; // no conversion or copy needed
+            return;
+        }
+    }
+    pSlot = &pPage->pPalCache[pPage->iPalNext];
+    if (++pPage->iPalNext >= pPage->iPalSlots)
+        pPage->iPalNext = 0;
+    pSlot->u32Hash = u32Hash;
+    pSlot->iColors = (uint16_t)iColors;
+    pSlot->ucPaletteType = pPage->ucPaletteType;
+    memcpy(pSlot->ucRaw, pRaw, iLen);
+    GIFConvertPalette(pPage, pRaw, iColors, pSlot->usPalette);
+    pPage->pLocalPal = pSlot->usPalette;
+} /* GIFLocalPalette() */
 
 //
 // Parse the GIF header, gather the size and palette info
@@ -279,6 +1118,10 @@ static int GIFParseInfo(GIFIMAGE *pPage, int bInfoOnly)
     int32_t iStartPos = pPage->GIFFile.iPos; // starting file position
     int iReadSize;
     
+    if (!bInfoOnly && !GIFPrepareWork(pPage)) // a frame is about to be decoded
+        return 0;
+    if (pPage->bFastGIF) // everything is already parsed
+        return GIFParseFast(pPage, bInfoOnly);
     pPage->bUseLocalPalette = 0; // assume no local palette
     pPage->bEndOfFrame = 0; // we're just getting started
     pPage->iFrameDelay = 0; // may not have a gfx extension block
@@ -288,7 +1131,7 @@ static int GIFParseInfo(GIFIMAGE *pPage, int bInfoOnly)
     if (iStartPos + iReadSize > pPage->GIFFile.iSize)
        iReadSize = (pPage->GIFFile.iSize - iStartPos - 1);
     p = pPage->ucFileBuf;
-    iBytesRead =  (*pPage->pfnRead)(&pPage->GIFFile, pPage->ucFileBuf, iReadSize); // 255 is plenty for now
+    iBytesRead =  GIFRead(pPage, pPage->ucFileBuf, iReadSize); // 255 is plenty for now
 
     if (iBytesRead != iReadSize) // we're at the end of the file
     {
@@ -302,8 +1145,9 @@ static int GIFParseInfo(GIFIMAGE *pPage, int bInfoOnly)
            pPage->iError = GIF_BAD_FILE;
            return 0;
         }
-        pPage->iCanvasWidth = pPage->iWidth = INTELSHORT(&p[6]);
-        pPage->iCanvasHeight = pPage->iHeight = INTELSHORT(&p[8]);
+        pPage->iSrcCanvasWidth = INTELSHORT(&p[6]);
+        pPage->iSrcCanvasHeight = INTELSHORT(&p[8]);
+        GIFScaleCanvas(pPage);
         pPage->iBpp = ((p[10] & 0x70) >> 4) + 1;
         iColorTableBits = (p[10] & 7) + 1; // Log2(size) of the color table
         pPage->iGlobalPalSize = (1 << iColorTableBits);
@@ -313,9 +1157,9 @@ static int GIFParseInfo(GIFIMAGE *pPage, int bInfoOnly)
         if (p[10] & 0x80) // global color table?
         { // by default, convert to byte-reversed RGB565 for immediate use
             // Read enough additional data for the color table
-            i = (*pPage->pfnRead)(&pPage->GIFFile, &pPage->ucFileBuf[iBytesRead], 3*(1<<iColorTableBits));
+            i = GIFRead(pPage, &pPage->ucFileBuf[iBytesRead], 3*(1<<iColorTableBits));
             iBytesRead += i;
-            if (iColorTableBits != 1 && i < 3*(1<<iColorTableBits)) { // file too small
+            if (iColorTableBits != 1 && iBytesRead < iOffset + 3*(1<<iColorTableBits)) { // file too small
                 pPage->iError = GIF_BAD_FILE;
                 return 0;
             }
@@ -382,7 +1226,7 @@ static int GIFParseInfo(GIFIMAGE *pPage, int bInfoOnly)
                             iBytesRead -= iOffset;
                             iStartPos += iOffset;
                             iOffset = 0;
-                            iBytesRead += (*pPage->pfnRead)(&pPage->GIFFile, &pPage->ucFileBuf[iBytesRead], c+32);
+                            iBytesRead += GIFRead(pPage, &pPage->ucFileBuf[iBytesRead], c+32);
                         }
                         if (c == 11) // fixed block length
                         { // Netscape app block contains the repeat count
@@ -429,7 +1273,7 @@ static int GIFParseInfo(GIFIMAGE *pPage, int bInfoOnly)
                             iBytesRead -= iOffset;
                             iStartPos += iOffset;
                             iOffset = 0;
-                            iBytesRead += (*pPage->pfnRead)(&pPage->GIFFile, &pPage->ucFileBuf[iBytesRead], c+32);
+                            iBytesRead += GIFRead(pPage, &pPage->ucFileBuf[iBytesRead], c+32);
                         }
                         if (pPage->iCommentPos == 0) // Save first block info
                         {
@@ -465,15 +1309,16 @@ static int GIFParseInfo(GIFIMAGE *pPage, int bInfoOnly)
     if (p[iOffset] == ',')
         iOffset++;
     // This particular frame's size and position on the main frame (if animated)
-    pPage->iX = INTELSHORT(&p[iOffset]);
-    pPage->iY = INTELSHORT(&p[iOffset+2]);
-    pPage->iWidth = INTELSHORT(&p[iOffset+4]);
-    pPage->iHeight = INTELSHORT(&p[iOffset+6]);
-    if (pPage->iWidth > pPage->iCanvasWidth || pPage->iHeight > pPage->iCanvasHeight ||
-        pPage->iWidth + pPage->iX > pPage->iCanvasWidth || pPage->iHeight + pPage->iY > pPage->iCanvasHeight) {
+    pPage->iSrcX = INTELSHORT(&p[iOffset]);
+    pPage->iSrcY = INTELSHORT(&p[iOffset+2]);
+    pPage->iSrcWidth = INTELSHORT(&p[iOffset+4]);
+    pPage->iSrcHeight = INTELSHORT(&p[iOffset+6]);
+    if (pPage->iSrcWidth > pPage->iSrcCanvasWidth || pPage->iSrcHeight > pPage->iSrcCanvasHeight ||
+        pPage->iSrcWidth + pPage->iSrcX > pPage->iSrcCanvasWidth || pPage->iSrcHeight + pPage->iSrcY > pPage->iSrcCanvasHeight) {
         pPage->iError = GIF_DECODE_ERROR; // must be a corrupt file to encounter this error here
         return 0;
     }
+    GIFScaleFrame(pPage);
     iOffset += 8;
     
     /* Image descriptor
@@ -489,35 +1334,9 @@ static int GIFParseInfo(GIFIMAGE *pPage, int bInfoOnly)
         j = (1<<((pPage->ucMap & 7)+1));
         pPage->iLocalPalSize = j;
         // Read enough additional data for the color table
-        iBytesRead += (*pPage->pfnRead)(&pPage->GIFFile, &pPage->ucFileBuf[iBytesRead], j*3);            
-        if (pPage->ucPaletteType == GIF_PALETTE_RGB565_LE || pPage->ucPaletteType == GIF_PALETTE_RGB565_BE)
-        {
-            for (i=0; i<j; i++)
-            {
-                uint16_t usRGB565;
-                usRGB565 = ((p[iOffset] >> 3) << 11); // R
-                usRGB565 |= ((p[iOffset+1] >> 2) << 5); // G
-                usRGB565 |= (p[iOffset+2] >> 3); // B
-                if (pPage->ucPaletteType == GIF_PALETTE_RGB565_LE)
-                    pPage->pLocalPalette[i] = usRGB565;
-                else
-                    pPage->pLocalPalette[i] = __builtin_bswap16(usRGB565); // SPI wants MSB first
-                iOffset += 3;
-            }
-        } else if (pPage->ucPaletteType == GIF_PALETTE_1BPP || pPage->ucPaletteType == GIF_PALETTE_1BPP_OLED) {
-            uint8_t *pPal1 = (uint8_t*)pPage->pLocalPalette;
-            for (i=0; i<j; i++) {
-                uint16_t usGray;
-                usGray = p[iOffset]; // R
-                usGray += p[iOffset+1]*2; // G is twice as important
-                usGray += p[iOffset+2]; // B
-                pPal1[i] = (usGray >= 512); // bright enough = 1
-                iOffset += 3;
-            }
-        } else { // just copy it as-is
-            memcpy(pPage->pLocalPalette, &p[iOffset], j * 3);
-            iOffset += j*3;
-        }
+        iBytesRead += GIFRead(pPage, &pPage->ucFileBuf[iBytesRead], j*3);            
+        GIFLocalPalette(pPage, &p[iOffset], j);
+        iOffset += j*3;
         pPage->bUseLocalPalette = 1;
     }
     pPage->ucCodeStart = p[iOffset++]; /* initial code size */
@@ -525,7 +1344,12 @@ static int GIFParseInfo(GIFIMAGE *pPage, int bInfoOnly)
     pPage->iBpp = cGIFBits[pPage->ucCodeStart];
     // we are re-using the same buffer turning GIF file data
     // into "pure" LZW
+   pPage->pLZW = GIF_WORK(pPage)->ucLZW;
    pPage->iLZWSize = 0; // we're starting with no LZW data yet
+   if (pPage->ucFeedState) { // push mode; the sub-blocks are taken as they arrive (see GIFGetMoreData)
+       GIFSeek(pPage, iStartPos + iOffset);
+       return 1;
+   }
    c = 1; // get chunk length
    while (c && iOffset < iBytesRead)
    {
@@ -534,17 +1358,17 @@ static int GIFParseInfo(GIFIMAGE *pPage, int bInfoOnly)
 //     Serial.printf("Chunk size = %d\n", c);
      if (c <= (iBytesRead - iOffset))
      {
-       memcpy(&pPage->ucLZW[pPage->iLZWSize], &p[iOffset], c);
+       memcpy(&GIF_WORK(pPage)->ucLZW[pPage->iLZWSize], &p[iOffset], c);
        pPage->iLZWSize += c;
        iOffset += c;
      }
      else // partial chunk in our buffer
      {
        int iPartialLen = (iBytesRead - iOffset);
-       memcpy(&pPage->ucLZW[pPage->iLZWSize], &p[iOffset], iPartialLen);
+       memcpy(&GIF_WORK(pPage)->ucLZW[pPage->iLZWSize], &p[iOffset], iPartialLen);
        pPage->iLZWSize += iPartialLen;
        iOffset += iPartialLen;
-       (*pPage->pfnRead)(&pPage->GIFFile, &pPage->ucLZW[pPage->iLZWSize], c - iPartialLen);
+       GIFRead(pPage, &GIF_WORK(pPage)->ucLZW[pPage->iLZWSize], c - iPartialLen);
        pPage->iLZWSize += (c - iPartialLen);
      }
      if (c == 0)
@@ -555,30 +1379,196 @@ static int GIFParseInfo(GIFIMAGE *pPage, int bInfoOnly)
    if (iOffset < iBytesRead)
    {
 //     Serial.printf("Need to seek back %d bytes\n", iBytesRead - iOffset);
-     (*pPage->pfnSeek)(&pPage->GIFFile, iStartPos + iOffset); // position file to new spot
+     GIFSeek(pPage, iStartPos + iOffset); // position file to new spot
    }
     return 1; // we are now at the start of the chunk data
 } /* GIFParseInfo() */
 //
-// Gather info about an animated GIF file
+// Read a 32-bit little endian value from a fast GIF container
 //
-int GIF_getInfo(GIFIMAGE *pPage, GIFINFO *pInfo)
+static uint32_t GIFFastLong(const uint8_t *p)
 {
-    int iOff, iNumFrames;
-    int iDelay, iMaxDelay, iMinDelay, iTotalDelay;
-    int iReadAmount;
-    int iDataAvailable = 0;
-    int iDataRemaining = 0;
- //   uint32_t lFileOff = 0;
-    int bDone = 0;
-    int bExt;
-    uint8_t c, *cBuf;
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+} /* GIFFastLong() */
+//
+// Number of bytes per palette entry after conversion to the output type
+//
+static int GIFFastPalBytes(uint8_t ucPaletteType)
+{
+    if (ucPaletteType == GIF_PALETTE_RGB565_LE || ucPaletteType == GIF_PALETTE_RGB565_BE)
+        return 2;
+    if (ucPaletteType == GIF_PALETTE_1BPP || ucPaletteType == GIF_PALETTE_1BPP_OLED)
+        return 1;
+    return 3; // RGB888 & RGB8888 keep the original entries
+} /* GIFFastPalBytes() */
+//
+// Returns true if the data starts with a fast GIF container header
+//
+static int GIFIsFast(const uint8_t *pData, int32_t iSize)
+{
+    return (pData != NULL && iSize >= GIF_FAST_HEADER_SIZE && memcmp(pData, "FGIF", 4) == 0);
+} /* GIFIsFast() */
+//
+// GIFParseInfo() for a fast GIF container
+// The file position selects the frame: 0 = header + first frame, otherwise
+// the offset of a frame table entry (see GIF_buildIndex). After a frame, the
+// position moves to the next entry or to the end of the file after the last one.
+// The frame's LZW stream is decoded in place (no copy into ucLZW)
+//
+static int GIFParseFast(GIFIMAGE *pPage, int bInfoOnly)
+{
+    const uint8_t *pData = pPage->GIFFile.pData;
+    const uint8_t *pEntry;
+    uint32_t u32Size = (uint32_t)pPage->GIFFile.iSize;
+    uint32_t u32Table, u32Off, u32Len;
+    int iFrame, iFrames, iPalBytes, iColors;
 
-    iMaxDelay = iTotalDelay = 0;
-    iMinDelay = 10000;
-    iNumFrames = 1;
-    iDataRemaining = pPage->GIFFile.iSize;
-    cBuf = (uint8_t *) pPage->ucFileBuf;
+    iPalBytes = GIFFastPalBytes(pPage->ucPaletteType);
+    iFrames = (int)GIFFastLong(&pData[16]);
+    u32Table = GIFFastLong(&pData[20]);
+    pPage->bUseLocalPalette = 0;
+    pPage->bEndOfFrame = 1; // all of the data is already here
+    if (pPage->GIFFile.iPos == 0) { // start of the file
+        if (pData[4] != GIF_FAST_VERSION) {
+            pPage->iError = GIF_UNSUPPORTED_FEATURE;
+            return 0;
+        }
+        if (pData[5] != pPage->ucPaletteType) { // the palettes were converted for another output type
+            pPage->iError = GIF_INVALID_PARAMETER;
+            return 0;
+        }
+        if (iFrames < 0 || u32Table > u32Size || (uint32_t)iFrames > (u32Size - u32Table) / GIF_FAST_ENTRY_SIZE) {
+            pPage->iError = GIF_BAD_FILE;
+            return 0;
+        }
+        pPage->iSrcCanvasWidth = INTELSHORT(&pData[6]);
+        pPage->iSrcCanvasHeight = INTELSHORT(&pData[8]);
+        GIFScaleCanvas(pPage);
+        pPage->ucBackground = pData[10];
+        pPage->iBpp = pData[11];
+        pPage->iRepeatCount = (int16_t)INTELSHORT(&pData[12]);
+        pPage->ucGIFBits = 0;
+        iColors = INTELSHORT(&pData[14]);
+        pPage->iGlobalPalSize = iColors;
+        u32Off = GIFFastLong(&pData[24]);
+        if (iColors > MAX_COLORS || u32Off > u32Size || (uint32_t)(iColors * iPalBytes) > u32Size - u32Off) {
+            pPage->iError = GIF_BAD_FILE;
+            return 0;
+        }
+        memcpy(pPage->pPalette, &pData[u32Off], iColors * iPalBytes);
+        u32Off = GIFFastLong(&pData[28]);
+        if (u32Off != 0 && u32Off < u32Size && pData[u32Off] < u32Size - u32Off) {
+            pPage->iCommentPos = (int)u32Off + 1;
+            pPage->sCommentLen = pData[u32Off];
+        } else {
+            pPage->iCommentPos = 0;
+            pPage->sCommentLen = 0;
+        }
+    }
+    if (bInfoOnly)
+        return 1;
+    if ((uint32_t)pPage->GIFFile.iPos < u32Table)
+        iFrame = 0;
+    else
+        iFrame = (int)(((uint32_t)pPage->GIFFile.iPos - u32Table) / GIF_FAST_ENTRY_SIZE);
+    if (iFrame >= iFrames) { // end of the animation
+        pPage->iError = GIF_EMPTY_FRAME;
+        return 1;
+    }
+    pEntry = &pData[u32Table + iFrame * GIF_FAST_ENTRY_SIZE];
+    pPage->iSrcX = INTELSHORT(&pEntry[0]);
+    pPage->iSrcY = INTELSHORT(&pEntry[2]);
+    pPage->iSrcWidth = INTELSHORT(&pEntry[4]);
+    pPage->iSrcHeight = INTELSHORT(&pEntry[6]);
+    if (pPage->iSrcWidth + pPage->iSrcX > pPage->iSrcCanvasWidth || pPage->iSrcHeight + pPage->iSrcY > pPage->iSrcCanvasHeight ||
+        pEntry[15] > 8) {
+        pPage->iError = GIF_DECODE_ERROR;
+        return 0;
+    }
+    GIFScaleFrame(pPage);
+    pPage->iFrameDelay = INTELSHORT(&pEntry[8]);
+    pPage->ucGIFBits = pEntry[12];
+    pPage->ucTransparent = pEntry[13];
+    pPage->ucMap = pEntry[14];
+    pPage->ucCodeStart = pEntry[15];
+    pPage->iBpp = cGIFBits[pPage->ucCodeStart];
+    iColors = INTELSHORT(&pEntry[16]);
+    if (iColors) { // local palette
+        u32Off = GIFFastLong(&pEntry[20]);
+        if (iColors > MAX_COLORS || u32Off > u32Size || (uint32_t)(iColors * iPalBytes) > u32Size - u32Off) {
+            pPage->iError = GIF_DECODE_ERROR;
+            return 0;
+        }
+        memcpy(pPage->pLocalPalette, &pData[u32Off], iColors * iPalBytes);
+        pPage->pLocalPal = pPage->pLocalPalette;
+        pPage->iLocalPalSize = iColors;
+        pPage->bUseLocalPalette = 1;
+    }
+    u32Off = GIFFastLong(&pEntry[24]);
+    u32Len = GIFFastLong(&pEntry[28]);
+    if (u32Off > u32Size || u32Len > u32Size - u32Off || u32Size - u32Off - u32Len < GIF_FAST_LZW_PAD) {
+        pPage->iError = GIF_DECODE_ERROR;
+        return 0;
+    }
+    pPage->pLZW = (uint8_t *)&pData[u32Off];
+    pPage->iLZWSize = (int)u32Len;
+    pPage->iLZWOff = 0;
+    if (iFrame + 1 < iFrames)
+        pPage->GIFFile.iPos = (int32_t)(u32Table + (iFrame + 1) * GIF_FAST_ENTRY_SIZE);
+    else
+        pPage->GIFFile.iPos = pPage->GIFFile.iSize;
+    return 1;
+} /* GIFParseFast() */
+//
+// GIF_getInfo() for a fast GIF container; the same rules are applied
+// to the graphic control delays kept in the frame table
+//
+static int GIFFastInfo(GIFIMAGE *pPage, GIFINFO *pInfo)
+{
+    const uint8_t *pEntry;
+    int i, iDelay, iFrames;
+
+    iFrames = (int)GIFFastLong(&pPage->GIFFile.pData[16]);
+    pEntry = &pPage->GIFFile.pData[GIFFastLong(&pPage->GIFFile.pData[20])];
+    pInfo->iFrameCount = iFrames;
+    pInfo->iMaxDelay = pInfo->iDuration = 0;
+    pInfo->iMinDelay = 10000;
+    for (i=0; i<iFrames; i++) {
+        iDelay = INTELSHORT(&pEntry[10]);
+        if (iDelay != 0xffff) { // has a graphic control extension
+            if (iDelay < 2) // too fast, provide a default
+                iDelay = 2;
+            iDelay *= 10;
+            pInfo->iDuration += iDelay;
+            if (iDelay > pInfo->iMaxDelay) pInfo->iMaxDelay = iDelay;
+            else if (iDelay < pInfo->iMinDelay) pInfo->iMinDelay = iDelay;
+        }
+        pEntry += GIF_FAST_ENTRY_SIZE;
+    }
+    return 1;
+} /* GIFFastInfo() */
+//
+// Gather info about an animated GIF file
+//
+int GIF_getInfo(GIFIMAGE *pPage, GIFINFO *pInfo)
+{
+    int iOff, iNumFrames;
+    int iDelay, iMaxDelay, iMinDelay, iTotalDelay;
+    int iReadAmount;
+    int iDataAvailable = 0;
+    int iDataRemaining = 0;
+ //   uint32_t lFileOff = 0;
+    int bDone = 0;
+    int bExt;
+    uint8_t c, *cBuf;
+
+    if (pPage->bFastGIF)
+        return GIFFastInfo(pPage, pInfo);
+    iMaxDelay = iTotalDelay = 0;
+    iMinDelay = 10000;
+    iNumFrames = 1;
+    iDataRemaining = pPage->GIFFile.iSize;
+    cBuf = (uint8_t *) pPage->ucFileBuf;
     (*pPage->pfnSeek)(&pPage->GIFFile, 0);
     iDataAvailable = (*pPage->pfnRead)(&pPage->GIFFile, cBuf, FILE_BUF_SIZE);
     iDataRemaining -= iDataAvailable;
@@ -749,426 +1739,2407 @@ gifpagesz:
     pInfo->iDuration = iTotalDelay;
     return 1;
 } /* GIF_getInfo() */
-
 //
-// Unpack more chunk data for decoding
-// returns 1 to signify more data available for this image
-// 0 indicates there is no more data
+// Read a byte at an absolute file offset for GIF_buildIndex()
+// ucFileBuf is used as a read window to keep the number of reads low
+// returns -1 beyond the end of the file
 //
-static int GIFGetMoreData(GIFIMAGE *pPage)
+static int GIFIndexByte(GIFIMAGE *pPage, int32_t *pWinStart, int *pWinLen, int32_t iOffset)
 {
-    int iDelta = (pPage->iLZWSize - pPage->iLZWOff);
-    int iLZWBufSize;
-    unsigned char c = 1;
-    
-    // Turbo mode uses combined buffers to read more compressed data
-    iLZWBufSize = (pPage->pTurboBuffer) ? LZW_BUF_SIZE_TURBO : LZW_BUF_SIZE;
-    // move any existing data down
-    if (pPage->bEndOfFrame ||  iDelta >= (iLZWBufSize - MAX_CHUNK_SIZE) || iDelta <= 0)
-        return 1; // frame is finished or buffer is already full; no need to read more data
-    if (pPage->iLZWOff != 0)
-    {
-// NB: memcpy() fails on some systems because the src and dest ptrs overlap
-// so copy the bytes in a simple loop to avoid problems
-      for (int i=0; i<pPage->iLZWSize - pPage->iLZWOff; i++) {
-         pPage->ucLZW[i] = pPage->ucLZW[i + pPage->iLZWOff];
-      }
-      pPage->iLZWSize -= pPage->iLZWOff;
-      pPage->iLZWOff = 0;
+    if (pPage->pfnRead == readMem) // memory or mapped file
+        return (iOffset >= 0 && iOffset < pPage->GIFFile.iSize) ? pPage->GIFFile.pData[iOffset] : -1;
+    if (iOffset < *pWinStart || iOffset >= *pWinStart + *pWinLen) { // need to move the window
+        if (iOffset < 0 || iOffset >= pPage->GIFFile.iSize)
+            return -1;
+        (*pPage->pfnSeek)(&pPage->GIFFile, iOffset);
+        *pWinStart = iOffset;
+        *pWinLen = (*pPage->pfnRead)(&pPage->GIFFile, pPage->ucFileBuf, FILE_BUF_SIZE);
+        if (*pWinLen <= 0) {
+            *pWinLen = 0;
+            return -1;
+        }
     }
-    while (c && pPage->GIFFile.iPos < pPage->GIFFile.iSize && pPage->iLZWSize < (iLZWBufSize-MAX_CHUNK_SIZE))
-    {
-        (*pPage->pfnRead)(&pPage->GIFFile, &c, 1); // current length
-        (*pPage->pfnRead)(&pPage->GIFFile, &pPage->ucLZW[pPage->iLZWSize], c);
-        pPage->iLZWSize += c;
+    return pPage->ucFileBuf[iOffset - *pWinStart];
+} /* GIFIndexByte() */
+//
+// GIF_buildIndex() for a fast GIF container
+// The start offset of each frame is its frame table entry
+//
+static int GIFFastIndex(GIFIMAGE *pPage, GIFFRAME *pFrames, int iMaxFrames)
+{
+    const uint8_t *pEntry;
+    uint32_t u32Table;
+    int i, iFrames;
+
+    iFrames = (int)GIFFastLong(&pPage->GIFFile.pData[16]);
+    if (pFrames == NULL)
+        return iFrames;
+    if (iFrames > iMaxFrames)
+        iFrames = iMaxFrames;
+    u32Table = GIFFastLong(&pPage->GIFFile.pData[20]);
+    for (i=0; i<iFrames; i++) {
+        pEntry = &pPage->GIFFile.pData[u32Table + i * GIF_FAST_ENTRY_SIZE];
+        pFrames[i].iStartOffset = pFrames[i].iDescOffset = (int32_t)(u32Table + i * GIF_FAST_ENTRY_SIZE);
+        pFrames[i].iPalOffset = (INTELSHORT(&pEntry[16])) ? (int32_t)GIFFastLong(&pEntry[20]) : 0;
+        pFrames[i].iDataOffset = (int32_t)GIFFastLong(&pEntry[24]);
+        pFrames[i].iX = INTELSHORT(&pEntry[0]);
+        pFrames[i].iY = INTELSHORT(&pEntry[2]);
+        pFrames[i].iWidth = INTELSHORT(&pEntry[4]);
+        pFrames[i].iHeight = INTELSHORT(&pEntry[6]);
+        pFrames[i].iDelay = (INTELSHORT(&pEntry[10]) == 0xffff) ? 0 : INTELSHORT(&pEntry[8]);
+        pFrames[i].ucDisposalMethod = (pEntry[12] & 0x1c) >> 2;
+        pFrames[i].ucHasTransparency = pEntry[12] & 1;
+        pFrames[i].ucTransparent = pEntry[13];
+        pFrames[i].ucMap = pEntry[14];
     }
-    if (c == 0) // end of frame
-        pPage->bEndOfFrame = 1;
-    return (c != 0 && pPage->GIFFile.iPos < pPage->GIFFile.iSize); // more data available?
-} /* GIFGetMoreData() */
+    pPage->pFrameIndex = pFrames;
+    pPage->iFrameCount = iFrames;
+    return iFrames;
+} /* GIFFastIndex() */
 //
-// Draw and convert pixels when the user wants fully rendered output
+// Walk all of the blocks in the file and record where each frame starts
+// along with its size, position, palette, delay and transparency info.
+// If pFrames is NULL, the frames are only counted (to size the array).
+// The index is kept by the GIFIMAGE structure to be used by GIF_seekFrame()
+// returns the number of frames found
 //
-static void DrawCooked(GIFIMAGE *pPage, GIFDRAW *pDraw, void *pDest)
+int GIF_buildIndex(GIFIMAGE *pPage, GIFFRAME *pFrames, int iMaxFrames)
 {
-    uint8_t c, *s, *d8, *pEnd;
-    uint8_t *pActivePalette;
-    
-    pActivePalette = (pPage->bUseLocalPalette) ? (uint8_t *)pPage->pLocalPalette : (uint8_t *)pPage->pPalette;
-    // d8 points to the line in the full sized canvas where the new opaque pixels will be merged
-    d8 = &pPage->pFrameBuffer[pDraw->iX + (pDraw->iY + pDraw->y) * pPage->iCanvasWidth];
-    s = pDraw->pPixels; // s points to the newly decoded pixels of this line of the current frame
-    pEnd = s + pDraw->iWidth; // faster way to loop over the source pixels - eliminates a counter variable
-    
-    if (pPage->ucPaletteType == GIF_PALETTE_1BPP || pPage->ucPaletteType == GIF_PALETTE_1BPP_OLED) { // 1-bit mono
-        uint8_t *d = NULL;
-        uint8_t *pPal = pActivePalette;
-        uint8_t uc, ucMask;
-        int iPitch = 0;
-         if (pPage->ucPaletteType == GIF_PALETTE_1BPP) { // horizontal pixels
-             d = pPage->pFrameBuffer;
-             iPitch = (pPage->iCanvasWidth+7)/8;
-             d += (pPage->iCanvasWidth * pPage->iCanvasHeight);
-             d += pDraw->iX/8; // starting column
-             d += (pDraw->iY + pDraw->y) * iPitch;
-             // Apply the new pixels to the main image and generate 1-bpp output
-             if (pDraw->ucHasTransparency) { // if transparency used
-                 uint8_t ucTransparent = pDraw->ucTransparent;
-                 if (pDraw->ucDisposalMethod == 2) {
-                     // Make an attempt to do disposal method 2 (restore to background color)
-                     // even though we can't touch pixels outside of the current frame size.
-                     // (the previous frame may be larger or in a different position)
-                     uint8_t u8BG = pPal[pDraw->ucBackground];
-                     if (u8BG == 1) u8BG = 0xff; // set all bits to use mask
-                     uc = *d; ucMask = (0x80 >> (pDraw->iX & 7));;
-                     while (s < pEnd) {
-                         c = *s++;
-                         if (c != ucTransparent) {
-                             if (pPal[c])
-                                 uc |= ucMask;
-                             else
-                                 uc &= ~ucMask;
-                             *d8++ = c;
-                         } else {
-                             uc |= (u8BG & ucMask); // transparent pixel is restored to background color
-                             *d8++ = pDraw->ucBackground;
-                         }
-                         ucMask >>= 1;
-                         if (ucMask == 0) { // write the completed byte
-                             *d++ = uc;
-                             uc = *d;
-                             ucMask = 0x80;
-                         }
-                     }
-                     *d = uc; // write last partial byte
-                 } else { // no disposal, just write non-transparent pixels
-                     uc = *d; ucMask = (0x80 >> (pDraw->iX & 7));
-                     while (s < pEnd) {
-                         c = *s++;
-                         if (c != ucTransparent) {
-                             if (pPal[c])
-                                 uc |= ucMask;
-                             else
-                                 uc &= ~ucMask;
-                             *d8 = c;
-                         }
-                         d8++;
-                         ucMask >>= 1;
-                         if (ucMask == 0) {
-                             *d++ = uc;
-                             uc = *d;
-                             ucMask = 0x80;
-                         }
-                     }
-                     *d = uc;
-                 }
-             } else { // convert everything as opaque
-                 uc = *d; ucMask = (0x80 >> (pDraw->iX & 7)); // left pixel is MSB
-                 while (s < pEnd) {
-                     c = *d8++ = *s++; // just write the new opaque pixels over the old
-                     if (pPal[c]) // if non-zero, set white pixel
-                        uc |= ucMask;
-                     else
-                        uc &= ~ucMask;
-                     ucMask >>= 1;
-                     if (ucMask == 0) { // time to write the current byte
-                        *d++ = uc;
-                        uc = *d;
-                        ucMask = 0x80;
-                     }
-                 }
-                 *d = uc;
-             }
-         } else { // vertical pixels
-             d = pPage->pFrameBuffer;
-             d += (pPage->iCanvasWidth * pPage->iCanvasHeight);
-             d += pDraw->iX; // starting column
-             d += ((pDraw->iY + pDraw->y)>>3) * pPage->iCanvasWidth;
-             ucMask = 1 << ((pDraw->iY + pDraw->y) & 7);
-             // Apply the new pixels to the main image and generate 1-bpp output
-             if (pDraw->ucHasTransparency) { // if transparency used
-                 uint8_t ucTransparent = pDraw->ucTransparent;
-                 if (pDraw->ucDisposalMethod == 2) {
-                     // Make an attempt to do disposal method 2 (restore to background color)
-                     // even though we can't touch pixels outside of the current frame size.
-                     // (the previous frame may be larger or in a different position)
-                     uint8_t u8BG = pPal[pDraw->ucBackground];
-                     u8BG *= ucMask; // set the right bit
-                     while (s < pEnd) {
-                         c = *s++;
-                         uc = *d & ~ucMask; // clear old pixel
-                         if (c != ucTransparent) {
-                             uc |= (pPal[c] * ucMask);
-                             *d8++ = c;
-                         } else {
-                             uc |= u8BG; // transparent pixel is restored to background color
-                             *d8++ = pDraw->ucBackground;
-                         }
-                         *d++ = uc; // write back the updated pixel
-                     }
-                 } else { // no disposal, just write non-transparent pixels
-                     while (s < pEnd) {
-                         c = *s++;
-                         uc = *d & ~ucMask;
-                         if (c != ucTransparent) {
-                             *d = uc | (pPal[c] * ucMask);
-                             *d8 = c;
-                         }
-                         d++;
-                         d8++;
-                     }
-                 }
-             } else { // convert everything as opaque
-                 while (s < pEnd) {
-                     c = *d8++ = *s++; // just write the new opaque pixels over the old
-                     uc = *d & ~ucMask;
-                     *d++ = uc | (pPal[c] * ucMask);
-                 }
-             }
-         }
-    } else if (pPage->ucPaletteType == GIF_PALETTE_RGB565_LE || pPage->ucPaletteType == GIF_PALETTE_RGB565_BE) {
-        uint16_t *d, *pPal = (uint16_t *)pActivePalette;
-        d = (uint16_t *)pDest; // dest pointer to the cooked pixels
-        // Apply the new pixels to the main image
-        if (pDraw->ucHasTransparency) { // if transparency used
-            uint8_t ucTransparent = pDraw->ucTransparent;
-            if (pDraw->ucDisposalMethod == 2) {
-                // Make an attempt to do disposal method 2 (restore to background color)
-                // even though we can't touch pixels outside of the current frame size.
-                // (the previous frame may be larger or in a different position)
-                uint16_t u16BG = pPal[pDraw->ucBackground];
-                while (s < pEnd) {
-                    c = *s++;
-                    if (c != ucTransparent) {
-                        *d++ = pPal[c];
-                        *d8++ = c;
-                    } else {
-                        *d++ = u16BG; // transparent pixel is restored to background color
-                        *d8++ = pDraw->ucBackground;
-                    }
-                }
-            } else { // no disposal, just write non-transparent pixels
-                while (s < pEnd) {
-                    c = *s++;
-                    if (c != ucTransparent) {
-                        *d = pPal[c];
-                        *d8 = c;
-                    }
-                    d++;
-                    d8++;
-                }
-            }
-        } else { // convert all pixels through the palette without transparency
-#if REGISTER_WIDTH == 64
-            // parallelize the writes
-            // optimizing for the write buffer helps; reading 4 bytes at a time vs 1 doesn't on M1
-            while (s < pEnd - 3) { // group 4 pixels
-                BIGUINT bu;
-                uint8_t s0, s1, s2, s3;
-                uint16_t d1, d2, d3;
-                *(uint32_t *)d8 = *(uint32_t *)s; // just copy new opaque pixels over the old
-                s0 = s[0]; s1 = s[1]; s2 = s[2]; s3 = s[3];
-                bu = pPal[s0]; // not much difference on Apple M1
-                d1 = pPal[s1]; // but other processors may gain
-                d2 = pPal[s2]; // from unrolling the reads
-                d3 = pPal[s3];
-                bu |= (BIGUINT)d1 << 16;
-                bu |= (BIGUINT)d2 << 32;
-                bu |= (BIGUINT)d3 << 48;
-                s += 4;
-                d8 += 4;
-                *(BIGUINT *)d = bu;
-                d += 4;
-            }
-#endif
-            while (s < pEnd) {
-                c = *d8++ = *s++; // just write the new opaque pixels over the old
-                *d++ = pPal[c]; // and create the cooked pixels through the palette
+    int32_t iOff, iWinStart = 0, iOldPos;
+    int iWinLen = 0, iFrames = 0;
+    int c, iLen;
+    uint8_t ucGIFBits = 0, ucTransparent = 0;
+    uint16_t iDelay = 0;
+    GIFFRAME *pF;
+
+    if (pPage->bFastGIF) // the frame table is already there
+        return GIFFastIndex(pPage, pFrames, iMaxFrames);
+    iOldPos = pPage->GIFFile.iPos;
+    iOff = 13; // skip the header and logical screen descriptor
+    c = GIFIndexByte(pPage, &iWinStart, &iWinLen, 10);
+    if (c < 0) {
+        pPage->iError = GIF_EARLY_EOF;
+        return 0;
+    }
+    if (c & 0x80) // global color table
+        iOff += 3 * (2 << (c & 7));
+    pF = pFrames;
+    c = GIFIndexByte(pPage, &iWinStart, &iWinLen, iOff);
+    while (c >= 0 && (pFrames == NULL || iFrames < iMaxFrames)) {
+        int32_t iStart = iOff;
+        int32_t iDesc, iPal = 0, iData;
+        uint8_t ucMap;
+        iDelay = 0; // may not have a graphic control extension
+        while (c == 0x21) { // extension blocks
+            if (GIFIndexByte(pPage, &iWinStart, &iWinLen, iOff+1) == 0xf9 && GIFIndexByte(pPage, &iWinStart, &iWinLen, iOff+2) == 4) {
+                ucGIFBits = (uint8_t)GIFIndexByte(pPage, &iWinStart, &iWinLen, iOff+3);
+                iDelay = (uint16_t)(GIFIndexByte(pPage, &iWinStart, &iWinLen, iOff+4) | (GIFIndexByte(pPage, &iWinStart, &iWinLen, iOff+5) << 8)) * 10;
+                if (iDelay <= 1) // same substitution as GIFParseInfo()
+                    iDelay = 100;
+                if (ucGIFBits & 1)
+                    ucTransparent = (uint8_t)GIFIndexByte(pPage, &iWinStart, &iWinLen, iOff+6);
             }
+            iOff += 2; // skip to the first sub-block
+            while ((iLen = GIFIndexByte(pPage, &iWinStart, &iWinLen, iOff)) > 0)
+                iOff += iLen + 1;
+            if (iLen < 0) // truncated
+                goto index_done;
+            iOff++; // skip the block terminator
+            c = GIFIndexByte(pPage, &iWinStart, &iWinLen, iOff);
         }
-    } else { // 24bpp or 32bpp
-        uint8_t pixel, *d, *pPal;
-        int x;
-        d = (uint8_t *)pDest;
-        pPal = pActivePalette;
-        if (pDraw->ucHasTransparency) {
-            uint8_t ucTransparent = pDraw->ucTransparent;
-            if (pDraw->ucDisposalMethod == 2) {
-                // Make an attempt to do disposal method 2 (restore to background color)
-                // even though we can't touch pixels outside of the current frame size.
-                // (the previous frame may be larger or in a different position)
-                uint8_t * bg = &pPal[pDraw->ucBackground * 3];
-                if (pDraw->ucPaletteType == GIF_PALETTE_RGB888) {
-                while (s < pEnd) {
-                    pixel = *s++;
-                    if (pixel != ucTransparent) {
-                        *d8++ = pixel;
-                        d[0] = pPal[(pixel * 3) + 0];
-                        d[1] = pPal[(pixel * 3) + 1];
-                        d[2] = pPal[(pixel * 3) + 2];
-                        d += 3;
-                    } else {
-                        *d8++ = pDraw->ucBackground;
-                        d[0] = bg[0];
-                        d[1] = bg[1];
-                        d[2] = bg[2];
-                        d += 3;
-                    }
-                } // while
-                } else { // must be RGB8888
-                while (s < pEnd) {
-                    pixel = *s++;
-                    if (pixel != ucTransparent) {
-                        *d8++ = pixel;
-                        d[0] = pPal[(pixel * 3) + 0];
-                        d[1] = pPal[(pixel * 3) + 1];
-                        d[2] = pPal[(pixel * 3) + 2];
-                        d[3] = 0xff;
-                        d += 4;
-                    } else {
-                        *d8++ = pDraw->ucBackground;
-                        d[0] = bg[0];
-                        d[1] = bg[1];
-                        d[2] = bg[2];
-                        d[3] = 0xff;
-                        d += 4;
-                    }
-                } // while
-                }
-            } else { // no disposal, just write non-transparent pixels
-                if (pPage->ucPaletteType == GIF_PALETTE_RGB888) {
-                    for (x=0; x<pPage->iWidth; x++) {
-                        pixel = *s++;
-                        if (pixel != ucTransparent) {
-                            *d8 = pixel;
-                            d[0] = pPal[(pixel * 3) + 0]; // convert to RGB888 pixels
-                            d[1] = pPal[(pixel * 3) + 1];
-                            d[2] = pPal[(pixel * 3) + 2];
-                        }
-                        d8++;
-                        d += 3;
-                    }
-                } else { // must be RGBA32
-                    for (x=0; x<pPage->iWidth; x++) {
-                        pixel = *s++;
-                        if (pixel != ucTransparent) {
-                            *d8 = pixel;
-                            d[0] = pPal[(pixel * 3) + 0]; // convert to RGB8888 pixels
-                            d[1] = pPal[(pixel * 3) + 1];
-                            d[2] = pPal[(pixel * 3) + 2];
-                            d[3] = 0xff;
-                        }
-                        d8++;
-                        d += 4;
-                    }
-                }
-            }
-        } else { // no transparency
-            if (pPage->ucPaletteType == GIF_PALETTE_RGB888) {
-                for (x=0; x<pPage->iWidth; x++) {
-                    pixel = *d8++ = *s++;
-                    *d++ = pPal[(pixel * 3) + 0]; // convert to RGB888 pixels
-                    *d++ = pPal[(pixel * 3) + 1];
-                    *d++ = pPal[(pixel * 3) + 2];
-                }
-            } else { // must be RGBA32
-                for (x=0; x<pPage->iWidth; x++) {
-                    pixel = *d8++ = *s++;
-                    *d++ = pPal[(pixel * 3) + 0]; // convert to RGB8888 pixels
-                    *d++ = pPal[(pixel * 3) + 1];
-                    *d++ = pPal[(pixel * 3) + 2];
-                    *d++ = 0xff;
+        if (c != 0x2c) // end of file (';') or corrupt data
+            break;
+        iDesc = iOff;
+        ucMap = (uint8_t)GIFIndexByte(pPage, &iWinStart, &iWinLen, iOff+9);
+        iOff += 10;
+        if (ucMap & 0x80) { // local color table
+            iPal = iOff;
+            iOff += 3 * (2 << (ucMap & 7));
+        }
+        iOff++; // skip the LZW code size byte
+        iData = iOff;
+        while ((iLen = GIFIndexByte(pPage, &iWinStart, &iWinLen, iOff)) > 0)
+            iOff += iLen + 1;
+        if (iLen < 0) // truncated frame data, don't use this frame
+            break;
+        iOff++; // skip the block terminator
+        if (pFrames) {
+            pF->iStartOffset = iStart;
+            pF->iDescOffset = iDesc;
+            pF->iPalOffset = iPal;
+            pF->iDataOffset = iData;
+            pF->iX = (uint16_t)(GIFIndexByte(pPage, &iWinStart, &iWinLen, iDesc+1) | (GIFIndexByte(pPage, &iWinStart, &iWinLen, iDesc+2) << 8));
+            pF->iY = (uint16_t)(GIFIndexByte(pPage, &iWinStart, &iWinLen, iDesc+3) | (GIFIndexByte(pPage, &iWinStart, &iWinLen, iDesc+4) << 8));
+            pF->iWidth = (uint16_t)(GIFIndexByte(pPage, &iWinStart, &iWinLen, iDesc+5) | (GIFIndexByte(pPage, &iWinStart, &iWinLen, iDesc+6) << 8));
+            pF->iHeight = (uint16_t)(GIFIndexByte(pPage, &iWinStart, &iWinLen, iDesc+7) | (GIFIndexByte(pPage, &iWinStart, &iWinLen, iDesc+8) << 8));
+            pF->iDelay = iDelay;
+            // Like the decoder, a frame without a graphic control extension keeps the previous values
+            pF->ucDisposalMethod = (ucGIFBits & 0x1c) >> 2;
+            pF->ucHasTransparency = ucGIFBits & 1;
+            pF->ucTransparent = ucTransparent;
+            pF->ucMap = ucMap;
+            pF++;
+        }
+        iFrames++;
+        c = GIFIndexByte(pPage, &iWinStart, &iWinLen, iOff);
+    }
+index_done:
+    (*pPage->pfnSeek)(&pPage->GIFFile, iOldPos);
+    if (pFrames) {
+        pPage->pFrameIndex = pFrames;
+        pPage->iFrameCount = iFrames;
+    }
+    return iFrames;
+} /* GIF_buildIndex() */
+//
+// Position the file so that the next call to playFrame() decodes the given frame
+// Requires a frame index from GIF_buildIndex()
+// The disposal info of the previous frame is restored from the index so that
+// COOKED output handles disposal method 2 correctly. The canvas itself still
+// contains whatever was drawn last.
+//
+int GIF_seekFrame(GIFIMAGE *pPage, int iFrame)
+{
+    GIFFRAME *pF;
+
+    if (pPage->pFrameIndex == NULL || iFrame < 0 || iFrame >= pPage->iFrameCount || pPage->ucFeedState != GIF_FEED_OFF) {
+        pPage->iError = GIF_INVALID_PARAMETER;
+        return GIF_INVALID_PARAMETER;
+    }
+    GIFDropStep(pPage);
+    pPage->bStretchAll = 1; // the canvas no longer follows from the last stretched frame
+    pF = &pPage->pFrameIndex[iFrame];
+    if (iFrame > 0) {
+        GIFFRAME *pPrev = pF - 1;
+        pPage->ucPrevDisp = pPrev->ucDisposalMethod;
+        pPage->iPrevX = GIF_SCALED(pPage, pPrev->iX);
+        pPage->iPrevY = GIF_SCALED(pPage, pPrev->iY);
+        pPage->iPrevW = GIF_SCALED(pPage, pPrev->iX + pPrev->iWidth) - pPage->iPrevX;
+        pPage->iPrevH = GIF_SCALED(pPage, pPrev->iY + pPrev->iHeight) - pPage->iPrevY;
+    } else {
+        pPage->ucPrevDisp = 0;
+    }
+    // frames without a graphic control extension inherit these values
+    pPage->ucGIFBits = (uint8_t)((pF->ucDisposalMethod << 2) | pF->ucHasTransparency);
+    pPage->ucTransparent = pF->ucTransparent;
+    (*pPage->pfnSeek)(&pPage->GIFFile, pF->iStartOffset);
+    pPage->iCurrentFrame = iFrame;
+    pPage->iBakeNext = -1; // the frame buffer no longer follows sequential playback
+    pPage->iError = GIF_SUCCESS;
+    return GIF_SUCCESS;
+} /* GIF_seekFrame() */
+//
+// Return the number of bytes of frame buffer which carry over from one
+// frame to the next (8-bit canvas + any fully cooked output)
+//
+static int32_t GIFCanvasBytes(GIFIMAGE *pPage)
+{
+    int32_t iSize = pPage->iCanvasWidth * pPage->iCanvasHeight;
+
+    if (pPage->ucDrawType == GIF_DRAW_COOKED) {
+        switch (pPage->ucPaletteType) {
+            case GIF_PALETTE_1BPP: // 1-bpp output is always generated in the frame buffer
+                iSize += ((pPage->iCanvasWidth + 7) / 8) * pPage->iCanvasHeight;
+                break;
+            case GIF_PALETTE_1BPP_OLED:
+                iSize += pPage->iCanvasWidth * ((pPage->iCanvasHeight + 7) / 8);
+                break;
+            case GIF_PALETTE_RGB565_LE:
+            case GIF_PALETTE_RGB565_BE:
+                if (!pPage->pfnDraw)
+                    iSize += pPage->iCanvasWidth * pPage->iCanvasHeight * 2;
+                break;
+            case GIF_PALETTE_RGB888:
+                if (!pPage->pfnDraw)
+                    iSize += pPage->iCanvasWidth * pPage->iCanvasHeight * 3;
+                break;
+            case GIF_PALETTE_RGB8888:
+                if (!pPage->pfnDraw)
+                    iSize += pPage->iCanvasWidth * pPage->iCanvasHeight * 4;
+                break;
+        }
+    }
+    return iSize;
+} /* GIFCanvasBytes() */
+//
+// Each snapshot slot starts with the frame number that follows it (-1 = empty)
+// followed by a copy of the frame buffer
+//
+static uint8_t *GIFSnapSlot(GIFIMAGE *pPage, int iSlot)
+{
+    return &pPage->pSnapBuf[iSlot * (sizeof(int32_t) + ((pPage->iSnapSize + 3) & ~3))];
+} /* GIFSnapSlot() */
+//
+// Called after each frame is decoded. Every K frames, the frame buffer is
+// copied into the snapshot buffer so that GIF_gotoFrame() can resume from it
+//
+static void GIFSaveSnapshot(GIFIMAGE *pPage)
+{
+    int32_t iSize;
+    int i, iSlot, iInterval;
+    uint8_t *pSlot;
+
+    if (pPage->pFrameBuffer == NULL)
+        return;
+    iSize = GIFCanvasBytes(pPage);
+    if (iSize != pPage->iSnapSize) { // first use or the output type changed; (re)create the slots
+        pPage->iSnapSize = iSize;
+        pPage->iSnapCount = pPage->iSnapBufSize / (int32_t)(sizeof(int32_t) + ((iSize + 3) & ~3));
+        for (i=0; i<pPage->iSnapCount; i++) {
+            *(int32_t *)GIFSnapSlot(pPage, i) = -1;
+        }
+    }
+    if (pPage->iSnapCount == 0)
+        return;
+    iInterval = pPage->iSnapInterval;
+    if (iInterval == 0) { // spread the slots evenly over the animation
+        if (pPage->iFrameCount == 0) // need the frame index to know the length
+            return;
+        iInterval = (pPage->iFrameCount + pPage->iSnapCount) / (pPage->iSnapCount + 1);
+        if (iInterval < 1) iInterval = 1;
+    }
+    if ((pPage->iCurrentFrame % iInterval) != 0 || (pPage->iFrameCount && pPage->iCurrentFrame >= pPage->iFrameCount))
+        return; // not a snapshot frame (or the last frame)
+    iSlot = (pPage->iCurrentFrame / iInterval) - 1;
+    if (iSlot >= pPage->iSnapCount)
+        return; // out of memory budget
+    pSlot = GIFSnapSlot(pPage, iSlot);
+    if (*(int32_t *)pSlot == pPage->iCurrentFrame)
+        return; // already have it
+    memcpy(&pSlot[sizeof(int32_t)], pPage->pFrameBuffer, iSize);
+    *(int32_t *)pSlot = pPage->iCurrentFrame;
+} /* GIFSaveSnapshot() */
+//
+// Decoded frame cache ("bake")
+// After one full pass through the animation, the next pass is recorded as
+// a series of deltas: for each frame, the bytes of the frame buffer which
+// changed, stored as rows of runs inside the changed rectangle. Later passes
+// replay the deltas instead of decoding the LZW data. Each plane of the frame
+// buffer (8-bit canvas, cooked output) has its own section in a record:
+// u16 first row, rows, first byte, bytes (0 rows = unchanged), then for each
+// row: u16 run count, followed by runs of u16 skip, u16 length, data bytes.
+//
+typedef struct gif_bake_rec_tag
+{
+    int32_t iSize; // total record size (multiple of 4)
+    int32_t iPos; // file position after the frame
+    uint16_t iFrameDelay, iX, iY, iWidth, iHeight;
+    uint16_t iPrevX, iPrevY, iPrevW, iPrevH;
+    uint16_t iDirtyX1, iDirtyY1, iDirtyX2, iDirtyY2;
+    int16_t iRepeatCount;
+    uint8_t ucPrevDisp, ucDisposalMethod, ucGIFBits, ucTransparent, bCookedStale;
+} GIFBAKEREC;
+#define GIF_BAKE_GAP 4 // runs separated by fewer unchanged bytes are merged
+//
+// Return the offset of a frame buffer plane and its size in bytes per row and rows
+// plane 0 = 8-bit canvas, plane 1 = cooked output
+//
+static int32_t GIFBakePlane(GIFIMAGE *pPage, int iPlane, int *pPitch, int *pRows)
+{
+    int w = pPage->iCanvasWidth, h = pPage->iCanvasHeight;
+
+    *pPitch = w; *pRows = h;
+    if (iPlane == 0)
+        return 0;
+    switch (pPage->ucPaletteType) {
+        case GIF_PALETTE_1BPP:
+            *pPitch = (w + 7) / 8;
+            break;
+        case GIF_PALETTE_1BPP_OLED:
+            *pRows = (h + 7) / 8;
+            break;
+        case GIF_PALETTE_RGB565_LE:
+        case GIF_PALETTE_RGB565_BE:
+            *pPitch = w * 2;
+            break;
+        case GIF_PALETTE_RGB888:
+            *pPitch = w * 3;
+            break;
+        default: // RGB8888
+            *pPitch = w * 4;
+            break;
+    }
+    return w * h;
+} /* GIFBakePlane() */
+
+static uint8_t *GIFBakeShort(uint8_t *d, int i)
+{
+    d[0] = (uint8_t)i;
+    d[1] = (uint8_t)(i >> 8);
+    return d + 2;
+} /* GIFBakeShort() */
+#define GIF_BAKE_SHORT(p) ((p)[0] | ((p)[1] << 8))
+//
+// Encode the bytes which differ between the new plane and the old copy
+// The old copy is updated to match. Returns the end of the output or NULL
+// if it doesn't fit before pEnd
+//
+static uint8_t *GIFBakePack(uint8_t *pNew, uint8_t *pOld, int iPitch, int iRows, uint8_t *d, uint8_t *pEnd)
+{
+    int x, y, y0 = -1, y1 = 0, x0 = iPitch, x1 = 0, iStart, iEnd, iLast, iGap, iRuns;
+    uint8_t *s, *o, *pCount;
+
+    for (y=0; y<iRows; y++) { // changed rectangle
+        s = &pNew[y * iPitch]; o = &pOld[y * iPitch];
+        if (memcmp(s, o, iPitch) == 0)
+            continue;
+        if (y0 < 0) y0 = y;
+        y1 = y;
+        for (x=0; x<x0 && s[x] == o[x]; x++) {}
+        x0 = x;
+        for (x=iPitch-1; x>x1 && s[x] == o[x]; x--) {}
+        x1 = x;
+    }
+    if (pEnd - d < 8)
+        return NULL;
+    if (y0 < 0) { // nothing changed
+        memset(d, 0, 8);
+        return d + 8;
+    }
+    d = GIFBakeShort(d, y0); d = GIFBakeShort(d, y1 - y0 + 1);
+    d = GIFBakeShort(d, x0); d = GIFBakeShort(d, x1 - x0 + 1);
+    for (y=y0; y<=y1; y++) {
+        s = &pNew[y * iPitch]; o = &pOld[y * iPitch];
+        if (pEnd - d < 2)
+            return NULL;
+        pCount = d;
+        d += 2;
+        iRuns = 0;
+        iLast = x = x0;
+        while (x <= x1) {
+            while (x <= x1 && s[x] == o[x]) x++;
+            if (x > x1)
+                break;
+            iStart = x;
+            iEnd = x + 1;
+            while (iEnd <= x1) { // extend the run over short gaps of unchanged bytes
+                if (s[iEnd] != o[iEnd]) {
+                    iEnd++;
+                    continue;
                 }
+                for (iGap=iEnd; iGap <= x1 && iGap - iEnd < GIF_BAKE_GAP && s[iGap] == o[iGap]; iGap++) {}
+                if (iGap > x1 || iGap - iEnd >= GIF_BAKE_GAP)
+                    break;
+                iEnd = iGap;
             }
-        } // opaque
+            if (pEnd - d < 4 + (iEnd - iStart))
+                return NULL;
+            d = GIFBakeShort(d, iStart - iLast);
+            d = GIFBakeShort(d, iEnd - iStart);
+            memcpy(d, &s[iStart], iEnd - iStart);
+            memcpy(&o[iStart], &s[iStart], iEnd - iStart);
+            d += iEnd - iStart;
+            iRuns++;
+            iLast = x = iEnd;
+        }
+        GIFBakeShort(pCount, iRuns);
     }
-} /* DrawCooked() */
-#if (defined (ARDUINO_ESP32S3_DEV) || defined(ARDUINO_ESP32P4_DEV)) && !defined(NO_SIMD)
-#ifdef __cplusplus
-extern "C" {
-#endif // __cplusplus
-void s3_merge_transparent(uint8_t *pSrc, uint8_t *pDst, uint8_t *ucTrans, int iLen, uint32_t *pPalette, uint16_t *pRGB565);
-#ifdef __cplusplus
-}
-#endif // __cplusplus
-#endif // ESP32S3/P4 SIMD
-//
-// Merge transparent pixels of a new line of image into the existing framebuffer
+    return d;
+} /* GIFBakePack() */
 //
-// This function is SIMD-optimized on CPUs which support SIMD instructions
-// SIMD instructions are well suited to speed up this operation since they
-// include compare instructions which allow merging of transparent pixels without
-// the use of branching.
+// Apply one plane of a record to the frame buffer
+// returns the start of the next section
 //
-void GIF_mergeTransparent(uint8_t *pSrc, uint8_t *pDst, uint8_t ucTrans, int iLen)
+static uint8_t *GIFBakeUnpack(uint8_t *s, uint8_t *pDst, int iPitch)
 {
-#if defined (HAS_NEON) && !defined(NO_SIMD)
-    uint8x16_t u8x16_src, u8x16_dst, u8x16_mask;
-    const uint8x16_t u8x16_trans = vdupq_n_u8(ucTrans);
-    while (iLen >= 16) {
-        u8x16_src = vld1q_u8(pSrc);
-        u8x16_dst = vld1q_u8(pDst);
-        pSrc += 16;
-        u8x16_mask = vceqq_u8(u8x16_src, u8x16_trans);
-        u8x16_mask = vmvnq_u8(u8x16_mask); // there is no compare-not-equal
-        u8x16_dst = vandq_u8(u8x16_dst, u8x16_mask); // preserve original pixels
-        u8x16_src = vbicq_u8(u8x16_src, u8x16_mask); // preserve opaque src pixels
-        u8x16_dst = vorrq_u8(u8x16_src, u8x16_dst); // combine everything
-        vst1q_u8(pDst, u8x16_dst); // store final pixels
-        pDst += 16;
-        iLen -= 16;
+    int y, iRows, iRuns;
+    uint8_t *d;
+
+    y = GIF_BAKE_SHORT(s);
+    iRows = GIF_BAKE_SHORT(&s[2]);
+    pDst += (y * iPitch) + GIF_BAKE_SHORT(&s[4]);
+    s += 8;
+    for (; iRows > 0; iRows--, pDst += iPitch) {
+        iRuns = GIF_BAKE_SHORT(s);
+        s += 2;
+        for (d = pDst; iRuns > 0; iRuns--) {
+            int iLen = GIF_BAKE_SHORT(&s[2]);
+            d += GIF_BAKE_SHORT(s);
+            memcpy(d, &s[4], iLen);
+            d += iLen;
+            s += 4 + iLen;
+        }
     }
-    // Fall through to the generic C code for the 'tail' bytes
-#endif // Arm NEON
+    return s;
+} /* GIFBakeUnpack() */
+//
+// The cache needs cooked output in the frame buffer without a GIFDRAW callback
+//
+static int GIFBakeUsable(GIFIMAGE *pPage)
+{
+    return (pPage->ucDrawType == GIF_DRAW_COOKED && pPage->pFrameBuffer && pPage->pfnDraw == NULL);
+} /* GIFBakeUsable() */
+//
+// Called by playFrame() before parsing the next frame
+// Starts or finishes recording as needed and returns 1 if the frame was
+// drawn from the cache (everything playFrame() would do is done)
+//
+static int GIFBakeReplay(GIFIMAGE *pPage)
+{
+    int i, iPitch, iRows, k = pPage->iCurrentFrame;
+    int bRun = (k == 0) ? (pPage->iBakeNext > 0) : (pPage->iBakeNext == k); // unbroken pass so far
+    int32_t iScratch;
+    uint8_t *s;
+    GIFBAKEREC rec;
 
-// Generic C version
-    for (int i=0; i<iLen; i++) {
-        uint8_t c = *pSrc++;
-        if (c != ucTrans) {
-            *pDst = c;
+    if (!GIFBakeUsable(pPage)) {
+        pPage->iBakeNext = -1;
+        return 0;
+    }
+    if (pPage->ucBakeState != GIF_BAKE_WAITING && pPage->iBakeCanvas != GIFCanvasBytes(pPage))
+        pPage->ucBakeState = GIF_BAKE_WAITING; // the output format changed; start over
+    if (pPage->ucBakeState == GIF_BAKE_RECORDING) {
+        if (k == 0 && bRun && pPage->iBakeNext == pPage->iBakeFrames)
+            pPage->ucBakeState = GIF_BAKE_COMPLETE; // recorded a whole pass
+        else if (!bRun)
+            pPage->ucBakeState = GIF_BAKE_WAITING;
+    }
+    iScratch = (pPage->iBakeCanvas + 3) & ~3;
+    if (pPage->ucBakeState == GIF_BAKE_COMPLETE && bRun && k < pPage->iBakeFrames) {
+        if (k == 0)
+            pPage->iBakePos = 0;
+        s = &pPage->pBakeBuf[iScratch + pPage->iBakePos];
+        memcpy(&rec, s, sizeof(rec));
+        pPage->iBakePos += rec.iSize;
+        s += sizeof(rec);
+        for (i=0; i<2; i++) {
+            int32_t iOff = GIFBakePlane(pPage, i, &iPitch, &iRows);
+            s = GIFBakeUnpack(s, &pPage->pFrameBuffer[iOff], iPitch);
         }
-        pDst++;
-    } // for i
-} /* GIF_mergeTransparent() */
+        pPage->iFrameDelay = rec.iFrameDelay;
+        pPage->iX = rec.iX; pPage->iY = rec.iY;
+        pPage->iWidth = rec.iWidth; pPage->iHeight = rec.iHeight;
+        pPage->iPrevX = rec.iPrevX; pPage->iPrevY = rec.iPrevY;
+        pPage->iPrevW = rec.iPrevW; pPage->iPrevH = rec.iPrevH;
+        pPage->iDirtyX1 = rec.iDirtyX1; pPage->iDirtyY1 = rec.iDirtyY1;
+        pPage->iDirtyX2 = rec.iDirtyX2; pPage->iDirtyY2 = rec.iDirtyY2;
+        pPage->iRepeatCount = rec.iRepeatCount;
+        pPage->ucPrevDisp = rec.ucPrevDisp;
+        pPage->ucDisposalMethod = rec.ucDisposalMethod;
+        pPage->ucGIFBits = rec.ucGIFBits;
+        pPage->ucTransparent = rec.ucTransparent;
+        pPage->bCookedStale = rec.bCookedStale;
+        pPage->iError = GIF_SUCCESS;
+        GIFSeek(pPage, rec.iPos);
+        pPage->iBakeNext = k + 1;
+        pPage->iCurrentFrame++;
+        if (pPage->pSnapBuf)
+            GIFSaveSnapshot(pPage);
+        return 1;
+    }
+    if (pPage->ucBakeState == GIF_BAKE_WAITING && k == 0 && bRun) { // a full pass came before; record this one
+        pPage->iBakeCanvas = GIFCanvasBytes(pPage);
+        pPage->iBakeUsed = 0;
+        pPage->iBakeFrames = 0;
+        if (((pPage->iBakeCanvas + 3) & ~3) > pPage->iBakeBufSize) {
+            pPage->ucBakeState = GIF_BAKE_COMPLETE; // no room; everything is decoded live
+        } else {
+            memcpy(pPage->pBakeBuf, pPage->pFrameBuffer, pPage->iBakeCanvas);
+            pPage->ucBakeState = GIF_BAKE_RECORDING;
+        }
+    }
+    return 0;
+} /* GIFBakeReplay() */
 //
-// Prepare final RGB565 pixels from a newly decoded line and 8-bit framebuffer
+// Called by playFrame() after a frame is decoded (before iCurrentFrame advances)
+// While recording, the changes to the frame buffer are added to the cache.
+// When the memory budget runs out, the frames recorded so far are kept and
+// the rest are decoded live on every pass.
 //
-void GIF_cookPixels(uint8_t *pSrc, uint8_t *pDst, int iTrans, int iLen, uint32_t *pPalette, uint16_t *pRGB565)
+static void GIFBakeSave(GIFIMAGE *pPage)
 {
-#if (defined (ARDUINO_ESP32S3_DEV) || defined(ARDUINO_ESP32P4_DEV)) && !defined(NO_SIMD)
-    uint8_t ucTrans, *pTrans;
-    if (iTrans == -1) {
-        pTrans = NULL;
-    } else {
-        ucTrans = (uint8_t)iTrans;
-        pTrans = &ucTrans;
+    int i, iPitch, iRows, k = pPage->iCurrentFrame;
+    int32_t iScratch, iOff;
+    uint8_t *pRec, *d, *pEnd;
+    GIFBAKEREC rec;
+
+    if (pPage->ucBakeState == GIF_BAKE_RECORDING && k == pPage->iBakeFrames) {
+        iScratch = (pPage->iBakeCanvas + 3) & ~3;
+        pRec = &pPage->pBakeBuf[iScratch + pPage->iBakeUsed];
+        pEnd = &pPage->pBakeBuf[pPage->iBakeBufSize];
+        d = (pEnd - pRec > (int32_t)sizeof(rec)) ? pRec + sizeof(rec) : NULL;
+        for (i=0; i<2 && d; i++) {
+            iOff = GIFBakePlane(pPage, i, &iPitch, &iRows);
+            d = GIFBakePack(&pPage->pFrameBuffer[iOff], &pPage->pBakeBuf[iOff], iPitch, iRows, d, pEnd);
+        }
+        if (d == NULL) { // out of memory budget
+            pPage->ucBakeState = GIF_BAKE_COMPLETE;
+        } else {
+            memset(&rec, 0, sizeof(rec));
+            rec.iSize = (int32_t)(((d - pRec) + 3) & ~3);
+            rec.iPos = pPage->GIFFile.iPos;
+            rec.iFrameDelay = pPage->iFrameDelay;
+            rec.iX = pPage->iX; rec.iY = pPage->iY;
+            rec.iWidth = pPage->iWidth; rec.iHeight = pPage->iHeight;
+            rec.iPrevX = pPage->iPrevX; rec.iPrevY = pPage->iPrevY;
+            rec.iPrevW = pPage->iPrevW; rec.iPrevH = pPage->iPrevH;
+            rec.iDirtyX1 = pPage->iDirtyX1; rec.iDirtyY1 = pPage->iDirtyY1;
+            rec.iDirtyX2 = pPage->iDirtyX2; rec.iDirtyY2 = pPage->iDirtyY2;
+            rec.iRepeatCount = pPage->iRepeatCount;
+            rec.ucPrevDisp = pPage->ucPrevDisp;
+            rec.ucDisposalMethod = pPage->ucDisposalMethod;
+            rec.ucGIFBits = pPage->ucGIFBits;
+            rec.ucTransparent = pPage->ucTransparent;
+            rec.bCookedStale = pPage->bCookedStale;
+            memcpy(pRec, &rec, sizeof(rec));
+            pPage->iBakeUsed += rec.iSize;
+            pPage->iBakeFrames++;
+        }
     }
-    s3_merge_transparent(pSrc, pDst, pTrans, iLen, pPalette, pRGB565);
-    return;
-#endif // ESP32S3/P4
+    pPage->iBakeNext = (k == 0 || pPage->iBakeNext == k) ? k + 1 : -1;
+} /* GIFBakeSave() */
+//
+// Go to a frame and prepare the frame buffer so that the next call to
+// playFrame() draws it exactly as sequential playback would have.
+// Decoding restarts from the closest earlier snapshot or from the closest
+// earlier frame which repaints the whole canvas with opaque pixels,
+// so only the frames in between are decoded (and drawn if there is a GIFDRAW callback).
+// Requires a frame index and a frame buffer.
+//
+static int GIFGotoFrame(GIFIMAGE *pPage, int iFrame)
+{
+    int i, iStart = 0, iSnap = -1, rc;
+    GIFFRAME *pF;
 
-// Generic C version
-uint16_t *pPal = (uint16_t *)pPalette; // assume 16-bit palette for non-SIMD
-    if (iTrans == -1) { // no transparent color
-        for (int i=0; i<iLen; i++) {
-            uint8_t c = *pSrc++;
-            *pDst++ = c;
-            *pRGB565++ = pPal[c];
+    if (pPage->pFrameIndex == NULL || pPage->pFrameBuffer == NULL || iFrame < 0 || iFrame >= pPage->iFrameCount || pPage->ucFeedState != GIF_FEED_OFF) {
+        pPage->iError = GIF_INVALID_PARAMETER;
+        return GIF_INVALID_PARAMETER;
+    }
+    GIFDropStep(pPage);
+    pPage->bStretchAll = 1; // frames are decoded without being stretched
+    // A full canvas opaque frame doesn't depend on anything before it
+    for (i=iFrame; i>0; i--) {
+        pF = &pPage->pFrameIndex[i];
+        if (!pF->ucHasTransparency && GIF_SCALED(pPage, pF->iX) == 0 && GIF_SCALED(pPage, pF->iY) == 0 &&
+            GIF_SCALED(pPage, pF->iX + pF->iWidth) >= pPage->iCanvasWidth && GIF_SCALED(pPage, pF->iY + pF->iHeight) >= pPage->iCanvasHeight) {
+            iStart = i;
+            break;
         }
-    } else {
-        uint8_t ucTrans = (uint8_t)iTrans;
-        for (int i=0; i<iLen; i++) {
-            uint8_t c = *pSrc++;
-            if (c != ucTrans) {
-                *pDst++ = c;
-            } else {
-                c = *pDst++;
+    }
+    if (pPage->pSnapBuf && pPage->iSnapSize == GIFCanvasBytes(pPage)) {
+        for (i=0; i<pPage->iSnapCount; i++) { // find the closest usable snapshot
+            int32_t iSnapFrame = *(int32_t *)GIFSnapSlot(pPage, i);
+            if (iSnapFrame > iStart && iSnapFrame <= iFrame) {
+                iStart = iSnapFrame;
+                iSnap = i;
             }
-            *pRGB565++ = pPal[c];
-        } // for i
-    } // transparent color
-} /* GIF_cookPixels() */
-
+        }
+    }
+    if (iSnap >= 0) {
+        memcpy(pPage->pFrameBuffer, &GIFSnapSlot(pPage, iSnap)[sizeof(int32_t)], pPage->iSnapSize);
+    } else if (iStart == 0) { // replay from a blank canvas, not from the frame left in the buffer
+        int32_t iPels = pPage->iCanvasWidth * pPage->iCanvasHeight;
+        memset(pPage->pFrameBuffer, pPage->ucBackground, iPels);
+        if ((pPage->ucPaletteType == GIF_PALETTE_RGB565_LE || pPage->ucPaletteType == GIF_PALETTE_RGB565_BE) && GIFCanvasBytes(pPage) == iPels * 3) {
+            uint16_t u16BG = ((uint16_t *)pPage->pPalette)[pPage->ucBackground], *d16 = (uint16_t *)&pPage->pFrameBuffer[iPels];
+            for (i=0; i<iPels; i++)
+                d16[i] = u16BG;
+        } else {
+            pPage->bCookedStale = 1; // the cooked pixels still show the old frame
+        }
+    }
+    rc = GIF_seekFrame(pPage, iStart);
+    while (rc == GIF_SUCCESS && pPage->iCurrentFrame < iFrame) { // decode forward to the requested frame
+        if (!GIFParseInfo(pPage, 0))
+            return pPage->iError;
+        if (pPage->iError != GIF_EMPTY_FRAME) {
+            rc = (pPage->pTurboBuffer) ? DecodeLZWTurbo(pPage, 0) : DecodeLZW(pPage, 0);
+            if (rc != 0)
+                return (pPage->iError != GIF_SUCCESS) ? pPage->iError : (int)GIF_DECODE_ERROR;
+        }
+        pPage->iCurrentFrame++;
+        if (pPage->pSnapBuf)
+            GIFSaveSnapshot(pPage);
+    }
+    return rc;
+} /* GIFGotoFrame() */
+
+int GIF_gotoFrame(GIFIMAGE *pPage, int iFrame)
+{
+    int rc = GIFGotoFrame(pPage, iFrame);
+    GIFReleaseWork(pPage); // borrowed for the frames decoded on the way
+    return rc;
+} /* GIF_gotoFrame() */
+#ifdef __LINUX__
+//
+// Frame-parallel playback
+// The LZW data of each frame is independent; only the composition onto the
+// canvas has to be done in order. Worker threads decode upcoming frames into
+// their own Turbo buffers and the calling thread composites them in order.
+//
+#define GIF_SLOT_EMPTY 0
+#define GIF_SLOT_READY 1
+typedef struct gif_worker_tag
+{
+    GIFIMAGE gif; // private decoder state (must be the first member, see GIFWorkerRead)
+    struct gif_parallel_tag *pCtx;
+    pthread_t tid;
+    int iFrame; // frame this worker decodes next
+    int iState; // empty or ready to be composited
+    int iError; // result of decoding iFrame
+} GIFWORKER;
+
+typedef struct gif_parallel_tag
+{
+    pthread_mutex_t mutex; // protects the worker states
+    pthread_mutex_t ioMutex; // serializes access to a shared file handle
+    pthread_cond_t cond;
+    GIFIMAGE *pMain;
+    int bQuit;
+} GIFPARALLEL;
+//
+// File access for workers when the source isn't in memory
+// Each worker has its own file position, but the file handle is shared
+//
+static int32_t GIFWorkerRead(GIFFILE *pFile, uint8_t *pBuf, int32_t iLen)
+{
+    GIFWORKER *pW = (GIFWORKER *)((uint8_t *)pFile - offsetof(GIFIMAGE, GIFFile));
+    GIFPARALLEL *pCtx = pW->pCtx;
+    int32_t iBytesRead;
+
+    pthread_mutex_lock(&pCtx->ioMutex);
+    (*pCtx->pMain->pfnSeek)(pFile, pFile->iPos);
+    iBytesRead = (*pCtx->pMain->pfnRead)(pFile, pBuf, iLen);
+    pthread_mutex_unlock(&pCtx->ioMutex);
+    return iBytesRead;
+} /* GIFWorkerRead() */
+
+static int32_t GIFWorkerSeek(GIFFILE *pFile, int32_t iPosition)
+{
+    if (iPosition < 0) iPosition = 0;
+    else if (iPosition >= pFile->iSize) iPosition = pFile->iSize-1;
+    pFile->iPos = iPosition; // the real seek happens in GIFWorkerRead
+    return iPosition;
+} /* GIFWorkerSeek() */
+//
+// Worker thread - decode every Nth frame into this worker's Turbo buffer
+//
+static void *GIFWorkerThread(void *pArg)
+{
+    GIFWORKER *pW = (GIFWORKER *)pArg;
+    GIFPARALLEL *pCtx = pW->pCtx;
+    GIFIMAGE *pGIF = &pW->gif;
+    int rc;
+
+    while (1) {
+        pthread_mutex_lock(&pCtx->mutex);
+        while (pW->iState != GIF_SLOT_EMPTY && !pCtx->bQuit)
+            pthread_cond_wait(&pCtx->cond, &pCtx->mutex);
+        if (pCtx->bQuit || pW->iFrame >= pGIF->iFrameCount) {
+            pthread_mutex_unlock(&pCtx->mutex);
+            break;
+        }
+        pthread_mutex_unlock(&pCtx->mutex);
+        rc = GIF_seekFrame(pGIF, pW->iFrame);
+        if (rc == GIF_SUCCESS) {
+            if (!GIFParseInfo(pGIF, 0)) {
+                rc = (pGIF->iError != GIF_SUCCESS) ? pGIF->iError : (int)GIF_DECODE_ERROR;
+            } else if (pGIF->iError != GIF_EMPTY_FRAME) {
+                if (DecodeLZWTurbo(pGIF, GIF_DECODE_ONLY) != 0)
+                    rc = (pGIF->iError != GIF_SUCCESS) ? pGIF->iError : (int)GIF_DECODE_ERROR;
+            }
+        }
+        pthread_mutex_lock(&pCtx->mutex);
+        pW->iError = rc;
+        pW->iState = GIF_SLOT_READY;
+        pthread_cond_broadcast(&pCtx->cond);
+        pthread_mutex_unlock(&pCtx->mutex);
+    }
+    return NULL;
+} /* GIFWorkerThread() */
+//
+// Composite a frame decoded by a worker onto the canvas
+// (disposal, transparency and palette conversion are the same as sequential playback)
+//
+static void GIFCompositeFrame(GIFIMAGE *pPage, GIFIMAGE *pFrame)
+{
+    pPage->iX = pFrame->iX;
+    pPage->iY = pFrame->iY;
+    pPage->iWidth = pFrame->iWidth;
+    pPage->iHeight = pFrame->iHeight;
+    pPage->iSrcX = pFrame->iSrcX;
+    pPage->iSrcY = pFrame->iSrcY;
+    pPage->iSrcWidth = pFrame->iSrcWidth;
+    pPage->iSrcHeight = pFrame->iSrcHeight;
+    pPage->iBpp = pFrame->iBpp;
+    pPage->ucMap = pFrame->ucMap;
+    pPage->ucCodeStart = pFrame->ucCodeStart;
+    pPage->ucGIFBits = pFrame->ucGIFBits;
+    pPage->ucTransparent = pFrame->ucTransparent;
+    pPage->iFrameDelay = pFrame->iFrameDelay;
+    if (pFrame->iRepeatCount != -1)
+        pPage->iRepeatCount = pFrame->iRepeatCount;
+    pPage->bUseLocalPalette = pFrame->bUseLocalPalette;
+    if (pFrame->bUseLocalPalette) {
+        pPage->iLocalPalSize = pFrame->iLocalPalSize;
+        memcpy(pPage->pLocalPalette, pFrame->pLocalPal, sizeof(pPage->pLocalPalette));
+        pPage->pLocalPal = pPage->pLocalPalette;
+    }
+    pPage->ucDisposalMethod = (pPage->ucGIFBits & 0x1c) >> 2;
+    GIFDirtyStart(pPage);
+    GIFDisposePrevious(pPage);
+    pPage->iStripCount = 0;
+    GIFTurboOutput(pPage, pFrame->pTurboBuffer);
+    GIFSavePrevious(pPage);
+} /* GIFCompositeFrame() */
+//
+// Decode and draw every frame of the animation using iThreads worker threads
+// Output goes to the GIFDRAW callback and/or the frame buffer in frame order,
+// exactly like calling playFrame() repeatedly (without delays).
+// A frame index is built (and freed) if one wasn't set with GIF_buildIndex().
+// Returns the number of frames drawn or -1 for an error (see GIF_getLastError)
+//
+int GIF_playParallel(GIFIMAGE *pPage, int iThreads, void *pUser)
+{
+    GIFPARALLEL ctx;
+    GIFWORKER *pWorkers;
+    GIFFRAME *pTempIndex = NULL;
+    int i, iFrame, iStarted = 0, rc = GIF_SUCCESS;
+    int32_t iTurboSize;
+
+    if (pPage->iSrcCanvasWidth * pPage->iSrcCanvasHeight > TURBO_MAX_PIXELS) { // the workers use Turbo mode
+        pPage->iError = GIF_TOO_WIDE;
+        return -1;
+    }
+    if (iThreads < 1 ||
+        (pPage->ucDrawType == GIF_DRAW_COOKED && pPage->pFrameBuffer == NULL && pPage->pfnDraw == NULL) ||
+        (pPage->ucDrawType == GIF_DRAW_RAW && pPage->pfnDraw == NULL)) {
+        pPage->iError = GIF_INVALID_PARAMETER;
+        return -1;
+    }
+    GIFDropStep(pPage);
+    if (pPage->pFrameIndex == NULL) { // need to know where each frame starts
+        i = GIF_buildIndex(pPage, NULL, 0);
+        if (i == 0 || (pTempIndex = (GIFFRAME *)malloc(i * sizeof(GIFFRAME))) == NULL) {
+            pPage->iError = (i == 0) ? GIF_DECODE_ERROR : GIF_ERROR_MEMORY;
+            return -1;
+        }
+        GIF_buildIndex(pPage, pTempIndex, i);
+    }
+    if (iThreads > pPage->iFrameCount)
+        iThreads = pPage->iFrameCount;
+    pWorkers = (GIFWORKER *)calloc(iThreads, sizeof(GIFWORKER));
+    if (pWorkers == NULL) {
+        rc = GIF_ERROR_MEMORY;
+        goto parallel_done;
+    }
+    GIF_seekFrame(pPage, 0); // start from the first frame
+    pPage->pUser = pUser;
+    ctx.pMain = pPage;
+    ctx.bQuit = 0;
+    pthread_mutex_init(&ctx.mutex, NULL);
+    pthread_mutex_init(&ctx.ioMutex, NULL);
+    pthread_cond_init(&ctx.cond, NULL);
+    iTurboSize = TURBO_BUFFER_SIZE + (pPage->iSrcCanvasWidth * pPage->iSrcCanvasHeight);
+    for (i=0; i<iThreads; i++) {
+        GIFWORKER *pW = &pWorkers[i];
+        memcpy(&pW->gif, pPage, sizeof(GIFIMAGE));
+        pW->gif.pTurboBuffer = (uint8_t *)malloc(iTurboSize);
+        pW->gif.pFrameBuffer = NULL;
+        pW->gif.pfnDraw = NULL;
+        pW->gif.pStripBuf = NULL;
+        pW->gif.pSpanBuf = NULL;
+        pW->gif.pPalCache = NULL; // the cache isn't shared between threads
+        pW->gif.pSnapBuf = NULL;
+        pW->gif.pReadBuf = NULL;
+#ifdef GIF_SPLIT_WORKSPACE
+        pW->gif.pWork = NULL; // each worker gets its own (freed below)
+        pW->gif.pWorkPool = NULL;
+        pW->gif.pPoolSlot = pW->gif.pWorkBuf = pW->gif.pWorkAlloc = NULL;
+        pW->gif.iWorkBufSize = pW->gif.iWorkAllocSize = 0;
+#endif
+        if (pPage->pfnRead != readMem) { // the file handle can't be used by multiple threads at once
+            pW->gif.pfnRead = GIFWorkerRead;
+            pW->gif.pfnSeek = GIFWorkerSeek;
+        }
+        pW->pCtx = &ctx;
+        pW->iFrame = i;
+        pW->iState = GIF_SLOT_EMPTY;
+        if (pW->gif.pTurboBuffer == NULL) {
+            rc = GIF_ERROR_MEMORY;
+            break;
+        }
+        if (pthread_create(&pW->tid, NULL, GIFWorkerThread, pW) != 0) {
+            rc = GIF_ERROR_MEMORY;
+            break;
+        }
+        iStarted++;
+    }
+    for (iFrame=0; iFrame < pPage->iFrameCount && rc == GIF_SUCCESS; iFrame++) {
+        GIFWORKER *pW = &pWorkers[iFrame % iThreads];
+        pthread_mutex_lock(&ctx.mutex);
+        while (pW->iState != GIF_SLOT_READY)
+            pthread_cond_wait(&ctx.cond, &ctx.mutex);
+        pthread_mutex_unlock(&ctx.mutex);
+        if (pW->iError != GIF_SUCCESS) {
+            rc = pW->iError;
+            break;
+        }
+        if (pW->gif.iError != GIF_EMPTY_FRAME) {
+            if (!GIFPrepareWork(pPage)) { // scaled lines go through the line buffer (GIF_SPLIT_WORKSPACE)
+                rc = pPage->iError;
+                break;
+            }
+            GIFCompositeFrame(pPage, &pW->gif);
+            GIFReleaseWork(pPage);
+        }
+        pPage->iCurrentFrame = iFrame + 1;
+        if (pPage->pSnapBuf)
+            GIFSaveSnapshot(pPage);
+        pthread_mutex_lock(&ctx.mutex);
+        pW->iFrame += iThreads; // give this worker the next frame in its sequence
+        pW->iState = GIF_SLOT_EMPTY;
+        pthread_cond_broadcast(&ctx.cond);
+        pthread_mutex_unlock(&ctx.mutex);
+    }
+    pthread_mutex_lock(&ctx.mutex);
+    ctx.bQuit = 1;
+    pthread_cond_broadcast(&ctx.cond);
+    pthread_mutex_unlock(&ctx.mutex);
+    for (i=0; i<iStarted; i++) {
+        pthread_join(pWorkers[i].tid, NULL);
+    }
+    for (i=0; i<iThreads; i++) {
+        free(pWorkers[i].gif.pTurboBuffer);
+        GIFFreeWork(&pWorkers[i].gif);
+    }
+    free(pWorkers);
+    pthread_cond_destroy(&ctx.cond);
+    pthread_mutex_destroy(&ctx.ioMutex);
+    pthread_mutex_destroy(&ctx.mutex);
+    (*pPage->pfnSeek)(&pPage->GIFFile, pPage->GIFFile.iSize); // at the end, like sequential playback
+parallel_done:
+    pPage->iBakeNext = -1; // frames were composed outside of playFrame()
+    if (pTempIndex) {
+        free(pTempIndex);
+        pPage->pFrameIndex = NULL;
+        pPage->iFrameCount = 0;
+    }
+    if (rc != GIF_SUCCESS) {
+        pPage->iError = rc;
+        return -1;
+    }
+    pPage->iError = GIF_SUCCESS;
+    return pPage->iCurrentFrame;
+} /* GIF_playParallel() */
+//
+// Store a 16 or 32-bit little endian value in a fast GIF container
+//
+static void GIFFastPut(uint8_t *p, uint32_t u32, int iBytes)
+{
+    while (iBytes--) {
+        *p++ = (uint8_t)u32;
+        u32 >>= 8;
+    }
+} /* GIFFastPut() */
+//
+// Convert the open GIF file into a fast GIF container (see openFast)
+// The palettes are stored converted for the palette type given to GIF_begin()
+// and each frame's LZW data is stored as one stream without the sub-block lengths.
+// Call with pOut = NULL to get the size needed. Playback carries on from
+// the frame it was at; an unfinished decodeStep() frame is started again.
+// Returns the container size or 0 for an error (see GIF_getLastError)
+//
+static int32_t GIFWriteFast(GIFIMAGE *pPage, uint8_t *pOut, int32_t iOutSize)
+{
+    GIFFRAME *pFrames, *pOldIndex;
+    uint8_t *pEntry, ucHeader[13], c;
+    int i, iFrames, iOldCount, iPalBytes, iGCE;
+    int32_t iOff, iLen, iSize, iStart, iOldPos, iOldComment;
+    int rc = GIF_SUCCESS, iOldFrame;
+    int16_t iRepeat = -1, sOldCommentLen;
+
+    if (pPage->bFastGIF || pPage->pDecodeAhead || pPage->ucFeedState != GIF_FEED_OFF) {
+        pPage->iError = GIF_INVALID_PARAMETER;
+        return 0;
+    }
+    GIFDropStep(pPage);
+    iOldPos = pPage->GIFFile.iPos;
+    iOldFrame = pPage->iCurrentFrame;
+    iOldComment = pPage->iCommentPos;
+    sOldCommentLen = pPage->sCommentLen;
+    if (pOut) { // make sure it fits before writing anything
+        iSize = GIF_writeFast(pPage, NULL, 0);
+        if (iSize == 0)
+            return 0;
+        if (iSize > iOutSize) {
+            pPage->iError = GIF_INVALID_PARAMETER; // the output buffer is too small
+            return 0;
+        }
+    }
+    iFrames = GIF_buildIndex(pPage, NULL, 0);
+    if (iFrames == 0 || (pFrames = (GIFFRAME *)malloc(iFrames * sizeof(GIFFRAME))) == NULL) {
+        pPage->iError = (iFrames == 0) ? GIF_DECODE_ERROR : GIF_ERROR_MEMORY;
+        return 0;
+    }
+    pOldIndex = pPage->pFrameIndex;
+    iOldCount = pPage->iFrameCount;
+    GIF_buildIndex(pPage, pFrames, iFrames);
+    GIFSeek(pPage, 0);
+    GIFRead(pPage, ucHeader, 13);
+    iPalBytes = GIFFastPalBytes(pPage->ucPaletteType);
+    iSize = GIF_FAST_HEADER_SIZE + iFrames * GIF_FAST_ENTRY_SIZE;
+    // global palette (as converted by GIFParseInfo)
+    if (pOut)
+        memcpy(&pOut[iSize], pPage->pPalette, pPage->iGlobalPalSize * iPalBytes);
+    iStart = iSize;
+    iSize += (pPage->iGlobalPalSize * iPalBytes + 3) & ~3;
+    if (pOut) {
+        memset(pOut, 0, GIF_FAST_HEADER_SIZE);
+        memcpy(pOut, "FGIF", 4);
+        pOut[4] = GIF_FAST_VERSION;
+        pOut[5] = pPage->ucPaletteType;
+        GIFFastPut(&pOut[6], pPage->iSrcCanvasWidth, 2);
+        GIFFastPut(&pOut[8], pPage->iSrcCanvasHeight, 2);
+        pOut[10] = pPage->ucBackground;
+        pOut[11] = ((ucHeader[10] & 0x70) >> 4) + 1;
+        GIFFastPut(&pOut[14], pPage->iGlobalPalSize, 2);
+        GIFFastPut(&pOut[16], iFrames, 4);
+        GIFFastPut(&pOut[20], GIF_FAST_HEADER_SIZE, 4);
+        GIFFastPut(&pOut[24], iStart, 4);
+    }
+    // Parse each frame like playback does, so inherited values (GIF bits,
+    // transparent color) are stored exactly as the decoder would see them
+    pPage->ucGIFBits = pPage->ucTransparent = 0;
+    pPage->iCommentPos = 0;
+    for (i=0; i<iFrames && rc == GIF_SUCCESS; i++) {
+        GIFSeek(pPage, pFrames[i].iStartOffset);
+        if (!GIFParseInfo(pPage, 0) || pPage->iError == GIF_EMPTY_FRAME) {
+            rc = GIF_DECODE_ERROR;
+            break;
+        }
+        if (i == 0)
+            iRepeat = pPage->iRepeatCount;
+        // the original delay value is kept for GIF_getInfo()
+        iGCE = 0xffff;
+        iOff = pFrames[i].iStartOffset;
+        GIFSeek(pPage, iOff);
+        while (GIFRead(pPage, ucHeader, 3) == 3 && ucHeader[0] == 0x21) {
+            if (ucHeader[1] == 0xf9 && ucHeader[2] == 4) {
+                GIFRead(pPage, ucHeader, 3);
+                iGCE = ucHeader[1] | (ucHeader[2] << 8);
+            }
+            iOff += 2;
+            GIFSeek(pPage, iOff);
+            while (GIFRead(pPage, &c, 1) == 1 && c != 0) { // skip the sub-blocks
+                iOff += c + 1;
+                GIFSeek(pPage, iOff);
+            }
+            iOff++;
+            GIFSeek(pPage, iOff);
+        }
+        pEntry = (pOut) ? &pOut[GIF_FAST_HEADER_SIZE + i * GIF_FAST_ENTRY_SIZE] : NULL;
+        if (pEntry) {
+            memset(pEntry, 0, GIF_FAST_ENTRY_SIZE);
+            GIFFastPut(&pEntry[0], pPage->iSrcX, 2);
+            GIFFastPut(&pEntry[2], pPage->iSrcY, 2);
+            GIFFastPut(&pEntry[4], pPage->iSrcWidth, 2);
+            GIFFastPut(&pEntry[6], pPage->iSrcHeight, 2);
+            GIFFastPut(&pEntry[8], pPage->iFrameDelay, 2);
+            GIFFastPut(&pEntry[10], iGCE, 2);
+            pEntry[12] = pPage->ucGIFBits;
+            pEntry[13] = pPage->ucTransparent;
+            pEntry[14] = pPage->ucMap;
+            pEntry[15] = pPage->ucCodeStart;
+        }
+        if (pPage->bUseLocalPalette) {
+            iLen = pPage->iLocalPalSize * iPalBytes;
+            if (pEntry) {
+                memcpy(&pOut[iSize], pPage->pLocalPal, iLen);
+                GIFFastPut(&pEntry[16], pPage->iLocalPalSize, 2);
+                GIFFastPut(&pEntry[20], iSize, 4);
+            }
+            iSize += (iLen + 3) & ~3;
+        }
+        // de-chunk the LZW data straight from the file
+        iStart = iSize;
+        iOff = pFrames[i].iDataOffset;
+        GIFSeek(pPage, iOff);
+        while (GIFRead(pPage, &c, 1) == 1 && c != 0) {
+            if (pOut) {
+                if (GIFRead(pPage, &pOut[iSize], c) != c)
+                    rc = GIF_EARLY_EOF;
+            }
+            iSize += c;
+            iOff += c + 1;
+            GIFSeek(pPage, iOff);
+        }
+        if (pEntry) {
+            memset(&pOut[iSize], 0, GIF_FAST_LZW_PAD); // the bit reader reads ahead
+            GIFFastPut(&pEntry[24], iStart, 4);
+            GIFFastPut(&pEntry[28], iSize - iStart, 4);
+        }
+        iSize = (iSize + GIF_FAST_LZW_PAD + 3) & ~3;
+    }
+    if (rc == GIF_SUCCESS && pPage->iCommentPos != 0) { // keep the first comment
+        if (pOut) {
+            pOut[iSize] = (uint8_t)pPage->sCommentLen;
+            GIFSeek(pPage, pPage->iCommentPos);
+            GIFRead(pPage, &pOut[iSize + 1], pPage->sCommentLen);
+            GIFFastPut(&pOut[28], iSize, 4);
+        }
+        iSize += 1 + pPage->sCommentLen;
+    }
+    if (pOut)
+        GIFFastPut(&pOut[12], (uint16_t)iRepeat, 2);
+    if (rc == GIF_SUCCESS) { // parse the last frame played again (the first one after open)
+        i = (iOldFrame > 0 && iOldFrame <= iFrames) ? iOldFrame - 1 : 0;
+        GIFSeek(pPage, pFrames[i].iStartOffset);
+        pPage->ucGIFBits = (uint8_t)((pFrames[i].ucDisposalMethod << 2) | pFrames[i].ucHasTransparency);
+        pPage->ucTransparent = pFrames[i].ucTransparent;
+        GIFParseInfo(pPage, 0);
+    }
+    free(pFrames);
+    pPage->pFrameIndex = pOldIndex;
+    pPage->iFrameCount = iOldCount;
+    pPage->iRepeatCount = iRepeat;
+    pPage->iCommentPos = iOldComment;
+    pPage->sCommentLen = sOldCommentLen;
+    GIFSeek(pPage, iOldPos);
+    pPage->iCurrentFrame = iOldFrame;
+    pPage->iError = rc;
+    return (rc == GIF_SUCCESS) ? iSize : 0;
+} /* GIFWriteFast() */
+
+int32_t GIF_writeFast(GIFIMAGE *pPage, uint8_t *pOut, int32_t iOutSize)
+{
+    int32_t iSize = GIFWriteFast(pPage, pOut, iOutSize);
+    GIFReleaseWork(pPage); // borrowed to parse the frames
+    return iSize;
+} /* GIF_writeFast() */
+//
+// Decode-ahead playback
+// A background thread decodes and composes frames into a ring of canvases
+// while the presenter shows the current one. The ring is a single producer,
+// single consumer queue; the two sides only share the head/tail counters.
+// When the ring is full the decoder raises bWaiting and sleeps; only then
+// does the presenter take the mutex to wake it after freeing a slot.
+//
+typedef struct gif_ring_tag
+{
+    GIFIMAGE *pGIF;
+    pthread_t tid;
+    uint8_t *pSlots; // iSlots canvases of iSlotSize bytes
+    GIFRINGFRAME *pInfo; // frame info for each slot
+    int32_t iCanvasSize, iSlotSize;
+    int iSlots;
+    int iLoops; // number of times to play the animation (0 = forever)
+    uint32_t u32Head; // frames produced (written by the decoder thread)
+    uint32_t u32Tail; // frames consumed (written by the presenter)
+    int bQuit; // presenter asks the decoder to stop
+    int bDone; // decoder finished (end of loops or an error)
+    int bWaiting; // decoder is asleep (or about to be) waiting for a free slot
+    pthread_mutex_t mutex; // only used to wait for a free slot
+    pthread_cond_t cond; // signalled when a slot is freed or bQuit is set
+} GIFRING;
+
+static void *GIFDecodeAheadThread(void *pArg)
+{
+    GIFRING *pRing = (GIFRING *)pArg;
+    GIFIMAGE *pPage = pRing->pGIF;
+    GIFRINGFRAME *pInfo;
+    int iLoop = 0, bFirst = 1, rc;
+    uint32_t u32Head = pRing->u32Head;
+
+    while (!__atomic_load_n(&pRing->bQuit, __ATOMIC_ACQUIRE)) {
+        if (u32Head - __atomic_load_n(&pRing->u32Tail, __ATOMIC_ACQUIRE) >= (uint32_t)pRing->iSlots) {
+            pthread_mutex_lock(&pRing->mutex); // ring is full, wait for the presenter
+            __atomic_store_n(&pRing->bWaiting, 1, __ATOMIC_SEQ_CST); // set before the tail is checked again
+            while (u32Head - __atomic_load_n(&pRing->u32Tail, __ATOMIC_SEQ_CST) >= (uint32_t)pRing->iSlots && !__atomic_load_n(&pRing->bQuit, __ATOMIC_ACQUIRE))
+                pthread_cond_wait(&pRing->cond, &pRing->mutex);
+            __atomic_store_n(&pRing->bWaiting, 0, __ATOMIC_RELAXED);
+            pthread_mutex_unlock(&pRing->mutex);
+            continue;
+        }
+        if (pPage->GIFFile.iPos >= pPage->GIFFile.iSize-1) { // end of the animation
+            if (pRing->iLoops && ++iLoop >= pRing->iLoops)
+                break;
+            (*pPage->pfnSeek)(&pPage->GIFFile, 0);
+            pPage->iCurrentFrame = 0;
+        }
+        if (!GIFParseInfo(pPage, 0)) {
+            if (pPage->iError == GIF_EMPTY_FRAME) { // trailing data; treat it as the end
+                (*pPage->pfnSeek)(&pPage->GIFFile, pPage->GIFFile.iSize);
+                continue;
+            }
+            break;
+        }
+        if (pPage->iError == GIF_EMPTY_FRAME) {
+            (*pPage->pfnSeek)(&pPage->GIFFile, pPage->GIFFile.iSize);
+            continue;
+        }
+        rc = (pPage->pTurboBuffer) ? DecodeLZWTurbo(pPage, 0) : DecodeLZW(pPage, 0);
+        GIFReleaseWork(pPage); // not needed while the frame waits in the ring
+        if (rc != 0)
+            break;
+        pPage->iCurrentFrame++;
+        if (pPage->pSnapBuf)
+            GIFSaveSnapshot(pPage);
+        pInfo = &pRing->pInfo[u32Head % pRing->iSlots];
+        pInfo->pCanvas = &pRing->pSlots[(u32Head % pRing->iSlots) * pRing->iSlotSize];
+        memcpy(pInfo->pCanvas, pPage->pFrameBuffer, pRing->iCanvasSize);
+        if (bFirst) { // the presenter has nothing yet, the whole canvas is new
+            pInfo->iX = pInfo->iY = 0;
+            pInfo->iWidth = pPage->iCanvasWidth; pInfo->iHeight = pPage->iCanvasHeight;
+            bFirst = 0;
+        } else { // only the pixels which changed value
+            int x, y, w, h;
+            GIFGetDirtyRect(pPage, &x, &y, &w, &h);
+            pInfo->iX = (uint16_t)x; pInfo->iY = (uint16_t)y;
+            pInfo->iWidth = (uint16_t)w; pInfo->iHeight = (uint16_t)h;
+        }
+        pInfo->iFrame = pPage->iCurrentFrame - 1;
+        pInfo->iDelay = pPage->iFrameDelay;
+        u32Head++;
+        __atomic_store_n(&pRing->u32Head, u32Head, __ATOMIC_RELEASE); // publish the frame
+    }
+    GIFReleaseWork(pPage);
+    __atomic_store_n(&pRing->bDone, 1, __ATOMIC_RELEASE);
+    return NULL;
+} /* GIFDecodeAheadThread() */
+//
+// Start decoding frames on a background thread
+// iFrames = number of composed frames to keep ready (ring size)
+// iLoops = number of times to play the animation (0 = forever)
+// Requires a frame buffer; the GIFDRAW callback (if any) is called from the decoder thread.
+// No other decode functions may be used until GIF_stopDecodeAhead()
+//
+int GIF_startDecodeAhead(GIFIMAGE *pPage, int iFrames, int iLoops)
+{
+    GIFRING *pRing;
+
+    if (iFrames < 1 || iLoops < 0 || pPage->pFrameBuffer == NULL || pPage->pDecodeAhead != NULL) {
+        pPage->iError = GIF_INVALID_PARAMETER;
+        return GIF_INVALID_PARAMETER;
+    }
+    GIFDropStep(pPage); // the thread starts with that frame
+    pRing = (GIFRING *)calloc(1, sizeof(GIFRING));
+    if (pRing == NULL) {
+        pPage->iError = GIF_ERROR_MEMORY;
+        return GIF_ERROR_MEMORY;
+    }
+    pRing->pGIF = pPage;
+    pRing->iSlots = iFrames;
+    pRing->iLoops = iLoops;
+    pRing->iCanvasSize = GIFCanvasBytes(pPage);
+    pRing->iSlotSize = (pRing->iCanvasSize + 15) & ~15;
+    pRing->pSlots = (uint8_t *)malloc((size_t)pRing->iSlotSize * iFrames);
+    pRing->pInfo = (GIFRINGFRAME *)calloc(iFrames, sizeof(GIFRINGFRAME));
+    if (pRing->pSlots == NULL || pRing->pInfo == NULL) {
+        free(pRing->pSlots);
+        free(pRing->pInfo);
+        free(pRing);
+        pPage->iError = GIF_ERROR_MEMORY;
+        return GIF_ERROR_MEMORY;
+    }
+    pPage->iError = GIF_SUCCESS;
+    pPage->iBakeNext = -1; // frames are composed outside of playFrame()
+    pthread_mutex_init(&pRing->mutex, NULL);
+    pthread_cond_init(&pRing->cond, NULL);
+    if (pthread_create(&pRing->tid, NULL, GIFDecodeAheadThread, pRing) != 0) {
+        pthread_cond_destroy(&pRing->cond);
+        pthread_mutex_destroy(&pRing->mutex);
+        free(pRing->pSlots);
+        free(pRing->pInfo);
+        free(pRing);
+        pPage->iError = GIF_ERROR_MEMORY;
+        return GIF_ERROR_MEMORY;
+    }
+    pPage->pDecodeAhead = pRing;
+    return GIF_SUCCESS;
+} /* GIF_startDecodeAhead() */
+//
+// Get the oldest composed frame without waiting
+// returns 1 if a frame is ready, 0 if the decoder hasn't finished the next one yet
+// and -1 if there are no more frames (end of the loops or a decode error)
+// The frame's canvas remains valid until GIF_releaseDecodedFrame()
+//
+int GIF_getDecodedFrame(GIFIMAGE *pPage, GIFRINGFRAME *pFrame)
+{
+    GIFRING *pRing = (GIFRING *)pPage->pDecodeAhead;
+    uint32_t u32Tail;
+
+    if (pRing == NULL)
+        return -1;
+    u32Tail = pRing->u32Tail;
+    if (__atomic_load_n(&pRing->u32Head, __ATOMIC_ACQUIRE) == u32Tail) { // nothing ready
+        if (!__atomic_load_n(&pRing->bDone, __ATOMIC_ACQUIRE))
+            return 0;
+        if (__atomic_load_n(&pRing->u32Head, __ATOMIC_ACQUIRE) == u32Tail)
+            return -1; // the decoder stopped and the ring is empty
+    }
+    memcpy(pFrame, &pRing->pInfo[u32Tail % pRing->iSlots], sizeof(GIFRINGFRAME));
+    return 1;
+} /* GIF_getDecodedFrame() */
+//
+// Give the oldest frame's canvas back to the decoder thread
+//
+void GIF_releaseDecodedFrame(GIFIMAGE *pPage)
+{
+    GIFRING *pRing = (GIFRING *)pPage->pDecodeAhead;
+
+    if (pRing == NULL || pRing->u32Tail == __atomic_load_n(&pRing->u32Head, __ATOMIC_ACQUIRE))
+        return;
+    __atomic_store_n(&pRing->u32Tail, pRing->u32Tail + 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&pRing->bWaiting, __ATOMIC_SEQ_CST)) { // the decoder is waiting for this slot
+        pthread_mutex_lock(&pRing->mutex);
+        pthread_cond_signal(&pRing->cond);
+        pthread_mutex_unlock(&pRing->mutex);
+    }
+} /* GIF_releaseDecodedFrame() */
+//
+// Stop the decoder thread and free the ring
+//
+void GIF_stopDecodeAhead(GIFIMAGE *pPage)
+{
+    GIFRING *pRing = (GIFRING *)pPage->pDecodeAhead;
+
+    if (pRing == NULL)
+        return;
+    pthread_mutex_lock(&pRing->mutex);
+    __atomic_store_n(&pRing->bQuit, 1, __ATOMIC_RELEASE);
+    pthread_cond_signal(&pRing->cond);
+    pthread_mutex_unlock(&pRing->mutex);
+    pthread_join(pRing->tid, NULL);
+    pthread_cond_destroy(&pRing->cond);
+    pthread_mutex_destroy(&pRing->mutex);
+    free(pRing->pSlots);
+    free(pRing->pInfo);
+    free(pRing);
+    pPage->pDecodeAhead = NULL;
+} /* GIF_stopDecodeAhead() */
+#endif // __LINUX__
+
+//
+// Read data for the decoder
+// Without a read buffer, this is a plain call to the read callback.
+// With one, the file is read in large slabs and small requests
+// (sub-block lengths, headers) are copied out of the slab.
+//
+static int32_t GIFRead(GIFIMAGE *pPage, uint8_t *pBuf, int32_t iLen)
+{
+    int32_t iPos, iCount, iTotal = 0;
+
+    if (pPage->pReadBuf == NULL || pPage->pfnRead == readMem) {
+        pPage->iReadCount++;
+        return (*pPage->pfnRead)(&pPage->GIFFile, pBuf, iLen);
+    }
+    while (iLen > 0) {
+        iPos = pPage->GIFFile.iPos;
+        if (iPos < pPage->iReadBufPos || iPos >= pPage->iReadBufPos + pPage->iReadBufLen) { // not in the slab
+            if (iPos >= pPage->GIFFile.iSize)
+                break;
+            // The physical file position may have been moved by other code, so always seek
+            (*pPage->pfnSeek)(&pPage->GIFFile, iPos);
+            pPage->iReadCount++;
+            if (iLen >= pPage->iReadBufSize) { // big request, skip the slab
+                iCount = (*pPage->pfnRead)(&pPage->GIFFile, pBuf, iLen);
+                return iTotal + ((iCount > 0) ? iCount : 0);
+            }
+            pPage->iReadBufPos = iPos;
+            pPage->iReadBufLen = (*pPage->pfnRead)(&pPage->GIFFile, pPage->pReadBuf, pPage->iReadBufSize);
+            pPage->GIFFile.iPos = iPos; // our position is still the start of the slab
+            if (pPage->iReadBufLen <= 0) {
+                pPage->iReadBufLen = 0;
+                break;
+            }
+        }
+        iCount = pPage->iReadBufPos + pPage->iReadBufLen - iPos;
+        if (iCount > iLen) iCount = iLen;
+        memcpy(pBuf, &pPage->pReadBuf[iPos - pPage->iReadBufPos], iCount);
+        pPage->GIFFile.iPos += iCount;
+        pBuf += iCount;
+        iLen -= iCount;
+        iTotal += iCount;
+    }
+    return iTotal;
+} /* GIFRead() */
+//
+// Set the decoder's file position
+// With a read buffer, the data may already be in the slab so the
+// (possibly slow) seek callback is deferred until the next slab read
+//
+static void GIFSeek(GIFIMAGE *pPage, int32_t iPosition)
+{
+    if (pPage->pReadBuf == NULL || pPage->pfnRead == readMem) {
+        (*pPage->pfnSeek)(&pPage->GIFFile, iPosition);
+        return;
+    }
+    if (iPosition < 0) iPosition = 0;
+    else if (iPosition >= pPage->GIFFile.iSize) iPosition = pPage->GIFFile.iSize-1;
+    pPage->GIFFile.iPos = iPosition;
+} /* GIFSeek() */
+//
+// Unpack more chunk data for decoding
+// returns 1 to signify more data available for this image
+// 0 indicates there is no more data
+//
+static int GIFGetMoreData(GIFIMAGE *pPage)
+{
+    int iDelta = (pPage->iLZWSize - pPage->iLZWOff);
+    int iLZWBufSize;
+    unsigned char c = 1;
+    
+    // Turbo mode uses combined buffers to read more compressed data
+    iLZWBufSize = (pPage->pTurboBuffer && !GIF_SUSPENDS(pPage)) ? LZW_BUF_SIZE_TURBO : LZW_BUF_SIZE;
+    // move any existing data down (in push mode the buffer can run dry between feed() calls)
+    if (pPage->bEndOfFrame ||  iDelta >= (iLZWBufSize - MAX_CHUNK_SIZE) || (iDelta <= 0 && !pPage->ucFeedState))
+        return 1; // frame is finished or buffer is already full; no need to read more data
+    if (pPage->iLZWOff != 0)
+    {
+      // the src and dest overlap, so this needs memmove (not memcpy)
+      memmove(GIF_WORK(pPage)->ucLZW, &GIF_WORK(pPage)->ucLZW[pPage->iLZWOff], iDelta);
+      pPage->iBytesMoved += iDelta;
+      pPage->iLZWSize -= pPage->iLZWOff;
+      pPage->iLZWOff = 0;
+    }
+    if (pPage->ucFeedState) { // push mode; only take sub-blocks which have arrived in full
+        const uint8_t *pData = pPage->GIFFile.pData;
+        int32_t iPos = pPage->GIFFile.iPos, iSize = pPage->GIFFile.iSize;
+        while (c && iPos < iSize && iPos + 1 + pData[iPos] <= iSize && pPage->iLZWSize < (iLZWBufSize-MAX_CHUNK_SIZE))
+        {
+            c = pData[iPos++]; // current length
+            memcpy(&GIF_WORK(pPage)->ucLZW[pPage->iLZWSize], &pData[iPos], c);
+            iPos += c;
+            pPage->iLZWSize += c;
+        }
+        pPage->GIFFile.iPos = iPos;
+    } else if (pPage->pfnRead == readMem) { // memory or mapped file; de-chunk straight from the source
+        const uint8_t *pData = pPage->GIFFile.pData;
+        int32_t iPos = pPage->GIFFile.iPos, iSize = pPage->GIFFile.iSize;
+        while (c && iPos < iSize && pPage->iLZWSize < (iLZWBufSize-MAX_CHUNK_SIZE))
+        {
+            int iLen;
+            c = pData[iPos++]; // current length
+            iLen = (c <= iSize - iPos) ? c : (iSize - iPos);
+            memcpy(&GIF_WORK(pPage)->ucLZW[pPage->iLZWSize], &pData[iPos], iLen);
+            iPos += iLen;
+            pPage->iLZWSize += iLen;
+            if (iLen < c) { // the file is truncated; decode what's there
+                pPage->bEndOfFrame = 1;
+                break;
+            }
+        }
+        pPage->GIFFile.iPos = iPos;
+    } else {
+        while (c && pPage->GIFFile.iPos < pPage->GIFFile.iSize && pPage->iLZWSize < (iLZWBufSize-MAX_CHUNK_SIZE))
+        {
+            // with a read buffer (see GIF_setReadBuf) these come from the buffered slab
+            GIFRead(pPage, &c, 1); // current length
+            GIFRead(pPage, &GIF_WORK(pPage)->ucLZW[pPage->iLZWSize], c);
+            pPage->iLZWSize += c;
+        }
+    }
+    if (c == 0) // end of frame
+        pPage->bEndOfFrame = 1;
+    return (c != 0 && pPage->GIFFile.iPos < pPage->GIFFile.iSize); // more data available?
+} /* GIFGetMoreData() */
+//
+// Return the number of bytes in one line of pixels sent to GIFDRAW
+// (RAW = 8-bit pixels, COOKED = pixels converted through the palette)
+//
+static int GIFOutputPitch(GIFIMAGE *pPage)
+{
+    if (pPage->ucDrawType == GIF_DRAW_RAW)
+        return pPage->iWidth;
+    switch (pPage->ucPaletteType) {
+        case GIF_PALETTE_RGB565_LE:
+        case GIF_PALETTE_RGB565_BE:
+            return pPage->iWidth * 2;
+        case GIF_PALETTE_RGB888:
+            return pPage->iWidth * 3;
+        case GIF_PALETTE_RGB8888:
+            return pPage->iWidth * 4;
+        case GIF_PALETTE_1BPP:
+            return (pPage->iCanvasWidth + 7) / 8; // pixels point into the 1-bpp canvas
+        default: // GIF_PALETTE_1BPP_OLED
+            return pPage->iCanvasWidth;
+    }
+} /* GIFOutputPitch() */
+//
+// Dirty rectangle tracking
+// With a frame buffer, the pixels which change value on the canvas are
+// found as each line is merged, so the display only needs to be updated in
+// that area. Without a frame buffer, the whole frame is reported.
+// A cooked pixel can change color without its index changing (the frame
+// buffer hasn't been painted yet, a local palette was used or disposal
+// only restored the canvas indices). Until an opaque full canvas frame
+// repaints everything, every pixel written counts as changed.
+//
+static void GIFDirtyStart(GIFIMAGE *pPage)
+{
+    if (pPage->bUseLocalPalette)
+        pPage->bCookedStale = 1;
+    pPage->bDirtyAll = (pPage->ucDrawType == GIF_DRAW_COOKED && pPage->bCookedStale);
+    if (!pPage->bUseLocalPalette && !(pPage->ucGIFBits & 1) && pPage->iX == 0 && pPage->iY == 0 && pPage->iWidth >= pPage->iCanvasWidth && pPage->iHeight >= pPage->iCanvasHeight)
+        pPage->bCookedStale = 0; // every pixel is repainted with the global palette
+    if (pPage->pFrameBuffer) { // empty until pixels change
+        pPage->iDirtyX1 = pPage->iCanvasWidth; pPage->iDirtyY1 = pPage->iCanvasHeight;
+        pPage->iDirtyX2 = pPage->iDirtyY2 = 0;
+    } else {
+        pPage->iDirtyX1 = pPage->iX; pPage->iDirtyY1 = pPage->iY;
+        pPage->iDirtyX2 = pPage->iX + pPage->iWidth; pPage->iDirtyY2 = pPage->iY + pPage->iHeight;
+    }
+} /* GIFDirtyStart() */
+
+//
+// Compare-on-write only applies to COOKED output of more than 1 bit per pixel
+// and needs the span buffer to tell the GIFDRAW callback which pixels changed
+//
+#define GIF_COMPARING(p) ((p)->bCompare && (p)->pSpanBuf && (p)->ucDrawType == GIF_DRAW_COOKED && \
+        (p)->ucPaletteType != GIF_PALETTE_1BPP && (p)->ucPaletteType != GIF_PALETTE_1BPP_OLED)
+
+static int GIFGetDirtyRect(GIFIMAGE *pPage, int *pX, int *pY, int *pWidth, int *pHeight)
+{
+    int bDirty = (pPage->iDirtyX2 > pPage->iDirtyX1 && pPage->iDirtyY2 > pPage->iDirtyY1);
+
+    *pX = (bDirty) ? pPage->iDirtyX1 : 0;
+    *pY = (bDirty) ? pPage->iDirtyY1 : 0;
+    *pWidth = (bDirty) ? pPage->iDirtyX2 - pPage->iDirtyX1 : 0;
+    *pHeight = (bDirty) ? pPage->iDirtyY2 - pPage->iDirtyY1 : 0;
+    return bDirty;
+} /* GIFGetDirtyRect() */
+
+static void GIFDirtyAdd(GIFIMAGE *pPage, int x1, int y, int x2)
+{
+    if (x1 < pPage->iDirtyX1) pPage->iDirtyX1 = (uint16_t)x1;
+    if (x2 > pPage->iDirtyX2) pPage->iDirtyX2 = (uint16_t)x2;
+    if (y < pPage->iDirtyY1) pPage->iDirtyY1 = (uint16_t)y;
+    if (y >= pPage->iDirtyY2) pPage->iDirtyY2 = (uint16_t)(y + 1);
+} /* GIFDirtyAdd() */
+//
+// Track a line of the canvas about to be filled with color c (disposal method 2)
+//
+static void GIFDirtyFill(GIFIMAGE *pPage, uint8_t *d, uint8_t c, int x, int y, int iLen)
+{
+    int x1, x2;
+
+    if (iLen <= 0)
+        return;
+    if (pPage->bDirtyAll) {
+        x1 = 0; x2 = iLen - 1;
+    } else {
+        for (x1=0; x1<iLen && d[x1] == c; x1++) {}
+        if (x1 == iLen)
+            return;
+        for (x2=iLen-1; d[x2] == c; x2--) {}
+    }
+    GIFDirtyAdd(pPage, x + x1, y, x + x2 + 1);
+} /* GIFDirtyFill() */
+//
+// Stretched output
+// Each output column and row has a table entry with its source index << 8
+// and the bilinear fraction (0 for NEAREST). The entries never decrease,
+// so the output range fed by a range of canvas pixels is found by a binary search.
+//
+static int GIFSetStretch(GIFIMAGE *pPage, void *pOut, int iWidth, int iHeight, int iPitch, int iFilter, uint32_t *pTable)
+{
+    if (pOut && (iWidth < 1 || iHeight < 1 || iWidth > 32767 || iHeight > 32767 || pTable == NULL ||
+        (iFilter != GIF_SCALE_NEAREST && iFilter != GIF_SCALE_BILINEAR)))
+        return GIF_INVALID_PARAMETER;
+    pPage->pStretchBuf = (uint8_t *)pOut;
+    pPage->pStretchTab = (pOut) ? pTable : NULL;
+    pPage->iStretchWidth = (uint16_t)iWidth;
+    pPage->iStretchHeight = (uint16_t)iHeight;
+    pPage->iStretchPitch = iPitch;
+    pPage->ucStretchFilter = (uint8_t)iFilter;
+    pPage->iStretchSrcW = pPage->iStretchSrcH = 0; // rebuild the table on the next frame
+    pPage->bStretchAll = 1;
+    return GIF_SUCCESS;
+} /* GIFSetStretch() */
+
+static int GIFGetStretchRect(GIFIMAGE *pPage, int *pX, int *pY, int *pWidth, int *pHeight)
+{
+    int bDirty = (pPage->iStretchX2 > pPage->iStretchX1 && pPage->iStretchY2 > pPage->iStretchY1);
+
+    *pX = (bDirty) ? pPage->iStretchX1 : 0;
+    *pY = (bDirty) ? pPage->iStretchY1 : 0;
+    *pWidth = (bDirty) ? pPage->iStretchX2 - pPage->iStretchX1 : 0;
+    *pHeight = (bDirty) ? pPage->iStretchY2 - pPage->iStretchY1 : 0;
+    return bDirty;
+} /* GIFGetStretchRect() */
+//
+// Fill the table entries for iDst output pixels taken from iSrc source pixels
+// Output pixel centers are mapped onto source pixel centers
+//
+static void GIFStretchTable(uint32_t *pTab, int iDst, int iSrc, int bBilinear)
+{
+    int i, iPos;
+
+    for (i=0; i<iDst; i++) {
+        if (bBilinear) {
+            iPos = (int)((((int64_t)(i*2 + 1) * iSrc) << 8) / (2 * iDst)) - 128; // 8.8 fixed point
+            if (iPos < 0) iPos = 0;
+            if ((iPos >> 8) >= iSrc-1) iPos = (iSrc-1) << 8; // no right/bottom neighbor
+        } else {
+            iPos = (int)(((int64_t)(i*2 + 1) * iSrc) / (2 * iDst)) << 8;
+        }
+        pTab[i] = (uint32_t)iPos;
+    }
+} /* GIFStretchTable() */
+//
+// Return the first output pixel whose last source pixel is >= iSrc
+//
+static int GIFStretchFind(uint32_t *pTab, int iDst, int iSrc, int bBilinear)
+{
+    int iLo = 0, iHi = iDst, i, iLast;
+
+    while (iLo < iHi) {
+        i = (iLo + iHi) >> 1;
+        iLast = (pTab[i] >> 8) + (bBilinear && (pTab[i] & 0xff) != 0);
+        if (iLast < iSrc)
+            iLo = i + 1;
+        else
+            iHi = i;
+    }
+    return iLo;
+} /* GIFStretchFind() */
+//
+// Blend 4 RGB565 pixels with 8-bit fractions
+//
+static uint16_t GIFBlend565(uint16_t a, uint16_t b, uint16_t c, uint16_t d, int fx, int fy, int bBigEndian)
+{
+    int w00 = (256-fx)*(256-fy), w01 = fx*(256-fy), w10 = (256-fx)*fy, w11 = fx*fy;
+    int r, g, bl;
+
+    if (bBigEndian) {
+        a = __builtin_bswap16(a); b = __builtin_bswap16(b);
+        c = __builtin_bswap16(c); d = __builtin_bswap16(d);
+    }
+    r = ((a >> 11) * w00 + (b >> 11) * w01 + (c >> 11) * w10 + (d >> 11) * w11 + 32768) >> 16;
+    g = (((a >> 5) & 0x3f) * w00 + ((b >> 5) & 0x3f) * w01 + ((c >> 5) & 0x3f) * w10 + ((d >> 5) & 0x3f) * w11 + 32768) >> 16;
+    bl = ((a & 0x1f) * w00 + (b & 0x1f) * w01 + (c & 0x1f) * w10 + (d & 0x1f) * w11 + 32768) >> 16;
+    a = (uint16_t)((r << 11) | (g << 5) | bl);
+    return (bBigEndian) ? __builtin_bswap16(a) : a;
+} /* GIFBlend565() */
+//
+// Redo the part of the stretched output which depends on the canvas pixels
+// changed by the last frame (or all of it after a size change or a seek)
+//
+static void GIFStretchFrame(GIFIMAGE *pPage)
+{
+    int x, y, x1, y1, x2, y2, iBpp, iPitch, bBilinear = (pPage->ucStretchFilter == GIF_SCALE_BILINEAR);
+    int cw = pPage->iCanvasWidth, ch = pPage->iCanvasHeight;
+    uint32_t *pTabX = pPage->pStretchTab, *pTabY = &pTabX[pPage->iStretchWidth];
+    uint8_t *pCooked, *s0, *s1, *d;
+
+    pPage->iStretchX1 = pPage->iStretchY1 = pPage->iStretchX2 = pPage->iStretchY2 = 0;
+    if (pPage->ucDrawType != GIF_DRAW_COOKED || pPage->pFrameBuffer == NULL || pPage->pfnDraw ||
+        pPage->ucPaletteType == GIF_PALETTE_1BPP || pPage->ucPaletteType == GIF_PALETTE_1BPP_OLED) {
+        pPage->iError = GIF_INVALID_PARAMETER; // there's no complete cooked canvas to resize
+        return;
+    }
+    if (pPage->iStretchSrcW != cw || pPage->iStretchSrcH != ch) { // new canvas or output size
+        GIFStretchTable(pTabX, pPage->iStretchWidth, cw, bBilinear);
+        GIFStretchTable(pTabY, pPage->iStretchHeight, ch, bBilinear);
+        pPage->iStretchSrcW = (uint16_t)cw;
+        pPage->iStretchSrcH = (uint16_t)ch;
+        pPage->bStretchAll = 1;
+    }
+    if (pPage->bStretchAll) {
+        x1 = y1 = 0;
+        x2 = pPage->iStretchWidth;
+        y2 = pPage->iStretchHeight;
+        pPage->bStretchAll = 0;
+    } else {
+        int dx, dy, dw, dh;
+        if (!GIFGetDirtyRect(pPage, &dx, &dy, &dw, &dh))
+            return; // nothing changed
+        x1 = GIFStretchFind(pTabX, pPage->iStretchWidth, dx, bBilinear);
+        x2 = GIFStretchFind(pTabX, pPage->iStretchWidth, dx + dw + bBilinear, bBilinear);
+        y1 = GIFStretchFind(pTabY, pPage->iStretchHeight, dy, bBilinear);
+        y2 = GIFStretchFind(pTabY, pPage->iStretchHeight, dy + dh + bBilinear, bBilinear);
+        if (x2 <= x1 || y2 <= y1)
+            return; // the changes fall between the sampled pixels
+    }
+    pPage->iStretchX1 = (uint16_t)x1; pPage->iStretchY1 = (uint16_t)y1;
+    pPage->iStretchX2 = (uint16_t)x2; pPage->iStretchY2 = (uint16_t)y2;
+    iBpp = (pPage->ucPaletteType == GIF_PALETTE_RGB888) ? 3 : ((pPage->ucPaletteType == GIF_PALETTE_RGB8888) ? 4 : 2);
+    iPitch = cw * iBpp;
+    pCooked = &pPage->pFrameBuffer[cw * ch];
+    for (y=y1; y<y2; y++) {
+        int fy = pTabY[y] & 0xff;
+        s0 = &pCooked[(pTabY[y] >> 8) * iPitch];
+        s1 = (fy) ? s0 + iPitch : s0;
+        d = &pPage->pStretchBuf[(y * pPage->iStretchPitch) + (x1 * iBpp)];
+        if (!bBilinear) {
+            if (iBpp == 2) {
+                uint16_t *d16 = (uint16_t *)d, *s16 = (uint16_t *)s0;
+                for (x=x1; x<x2; x++)
+                    *d16++ = s16[pTabX[x] >> 8];
+            } else {
+                for (x=x1; x<x2; x++) {
+                    memcpy(d, &s0[(pTabX[x] >> 8) * iBpp], iBpp);
+                    d += iBpp;
+                }
+            }
+        } else if (iBpp == 2) {
+            uint16_t *d16 = (uint16_t *)d, *t = (uint16_t *)s0, *b = (uint16_t *)s1;
+            int bBigEndian = (pPage->ucPaletteType == GIF_PALETTE_RGB565_BE);
+            for (x=x1; x<x2; x++) {
+                int i = pTabX[x] >> 8, fx = pTabX[x] & 0xff, j = i + (fx != 0);
+                *d16++ = GIFBlend565(t[i], t[j], b[i], b[j], fx, fy, bBigEndian);
+            }
+        } else { // RGB888 / RGB8888, blend each byte
+            for (x=x1; x<x2; x++) {
+                int i = (pTabX[x] >> 8) * iBpp, fx = pTabX[x] & 0xff, j = i + ((fx != 0) ? iBpp : 0), c;
+                int w00 = (256-fx)*(256-fy), w01 = fx*(256-fy), w10 = (256-fx)*fy, w11 = fx*fy;
+                for (c=0; c<iBpp; c++)
+                    *d++ = (uint8_t)((s0[i+c] * w00 + s0[j+c] * w01 + s1[i+c] * w10 + s1[j+c] * w11 + 32768) >> 16);
+            }
+        }
+    }
+} /* GIFStretchFrame() */
+//
+// Track the pixels of a new line which will change the canvas
+// (called before the line is merged into the frame buffer)
+//
+static void GIFDirtyRow(GIFIMAGE *pPage, GIFDRAW *pDraw)
+{
+    uint8_t *s = pDraw->pPixels, *d, ucTrans = pDraw->ucTransparent, ucBG = pDraw->ucBackground;
+    int x1, x2, iLen = pDraw->iWidth, y = pDraw->iY + pDraw->y;
+    int bTrans = pDraw->ucHasTransparency, bDispose = (bTrans && pDraw->ucDisposalMethod == 2);
+    int bAll = pPage->bDirtyAll;
+// a transparent pixel leaves the canvas alone unless it's restored to the background color
+#define GIF_DIRTY(x) ((bTrans && s[x] == ucTrans) ? (bDispose && (bAll || d[x] != ucBG)) : (bAll || s[x] != d[x]))
+
+    d = &pPage->pFrameBuffer[pDraw->iX + y * pPage->iCanvasWidth];
+    if (!bTrans && !bAll && memcmp(s, d, iLen) == 0)
+        return; // nothing changed on this line
+    for (x1=0; x1<iLen && !GIF_DIRTY(x1); x1++) {}
+    if (x1 == iLen)
+        return;
+    for (x2=iLen-1; x2>x1 && !GIF_DIRTY(x2); x2--) {}
+    GIFDirtyAdd(pPage, pDraw->iX + x1, y, pDraw->iX + x2 + 1);
+#undef GIF_DIRTY
+} /* GIFDirtyRow() */
+//
+// DrawCooked() kernels
+// Each palette type has a kernel for opaque lines, for lines with transparent
+// pixels and for lines whose transparent pixels are restored to the background
+// color (disposal method 2). The mode is a constant in each instance, so the
+// row loops are compiled without the branches which don't apply and
+// transparent pixels are handled with masks instead of branches.
+// GIFInitDraw() picks the kernel once per frame.
+// Disposal method 2 is only an attempt since we can't touch pixels outside
+// of the current frame size (the previous frame may be larger or in a
+// different position).
+//
+#define GIF_COOK_OPAQUE 0
+#define GIF_COOK_TRANSPARENT 1
+#define GIF_COOK_DISPOSE 2
+// s = the newly decoded pixels of this line of the current frame
+// d8 = the line in the full sized canvas where the new opaque pixels will be merged
+#define GIF_COOK_START \
+    uint8_t c, *s = pDraw->pPixels, *pEnd = s + pDraw->iWidth; \
+    uint8_t ucTrans = pDraw->ucTransparent, ucBG = pDraw->ucBackground; \
+    uint8_t *d8 = &pPage->pFrameBuffer[pDraw->iX + (pDraw->iY + pDraw->y) * pPage->iCanvasWidth]; \
+    uint32_t u32Mask; // all 1's for an opaque pixel
+// pick a if the pixel is opaque, otherwise b (without a branch)
+#define GIF_COOK_SELECT(a, b) (((a) & u32Mask) | ((b) & ~u32Mask))
+#define GIF_COOK_MASK(c) u32Mask = (iMode == GIF_COOK_OPAQUE) ? 0xffffffff : (0 - (uint32_t)((c) != ucTrans))
+// the new canvas pixel
+#define GIF_COOK_INDEX(c) (uint8_t)GIF_COOK_SELECT(c, (iMode == GIF_COOK_DISPOSE) ? ucBG : *d8)
+
+static GIF_INLINE void GIFCook1Bpp(GIFIMAGE *pPage, GIFDRAW *pDraw, void *pDest, const int iMode, const int iBpp)
+{
+    GIF_COOK_START
+    uint8_t *pPal = (pPage->bUseLocalPalette) ? (uint8_t *)pPage->pLocalPal : (uint8_t *)pPage->pPalette;
+    uint8_t uc, ucMask, ucOld, u8BG, *d;
+    int iPitch = (pPage->iCanvasWidth+7)/8;
+
+    (void)pDest; (void)iBpp; // horizontal pixels (MSB on left) after the 8-bit canvas
+    d = &pPage->pFrameBuffer[(pPage->iCanvasWidth * pPage->iCanvasHeight) + pDraw->iX/8 + (pDraw->iY + pDraw->y) * iPitch];
+    u8BG = 0 - pPal[ucBG]; // set all bits to use mask
+    uc = *d; ucMask = (0x80 >> (pDraw->iX & 7));
+    while (s < pEnd) {
+        c = *s++;
+        GIF_COOK_MASK(c);
+        ucOld = uc & ucMask;
+        if (iMode == GIF_COOK_DISPOSE)
+            ucOld |= (u8BG & ucMask); // transparent pixel is restored to background color
+        uc = (uc & ~ucMask) | (uint8_t)GIF_COOK_SELECT(ucMask & (0 - pPal[c]), ucOld); // entries are 0 or 1 (white)
+        *d8 = GIF_COOK_INDEX(c);
+        d8++;
+        ucMask >>= 1;
+        if (ucMask == 0) { // write the completed byte
+            *d++ = uc;
+            uc = *d;
+            ucMask = 0x80;
+        }
+    }
+    *d = uc; // write last partial byte
+} /* GIFCook1Bpp() */
+
+static GIF_INLINE void GIFCook1BppOLED(GIFIMAGE *pPage, GIFDRAW *pDraw, void *pDest, const int iMode, const int iBpp)
+{
+    GIF_COOK_START
+    uint8_t *pPal = (pPage->bUseLocalPalette) ? (uint8_t *)pPage->pLocalPal : (uint8_t *)pPage->pPalette;
+    uint8_t ucMask, u8BG, *d;
+
+    (void)pDest; (void)iBpp; // vertical pixels (LSB on top) after the 8-bit canvas
+    d = &pPage->pFrameBuffer[(pPage->iCanvasWidth * pPage->iCanvasHeight) + pDraw->iX + ((pDraw->iY + pDraw->y)>>3) * pPage->iCanvasWidth];
+    ucMask = 1 << ((pDraw->iY + pDraw->y) & 7);
+    u8BG = pPal[ucBG] * ucMask; // set the right bit
+    while (s < pEnd) {
+        c = *s++;
+        GIF_COOK_MASK(c);
+        *d = (*d & ~ucMask) | (uint8_t)GIF_COOK_SELECT(pPal[c] * ucMask, (iMode == GIF_COOK_DISPOSE) ? u8BG : (*d & ucMask));
+        *d8 = GIF_COOK_INDEX(c);
+        d++;
+        d8++;
+    }
+} /* GIFCook1BppOLED() */
+
+static GIF_INLINE void GIFCook565(GIFIMAGE *pPage, GIFDRAW *pDraw, void *pDest, const int iMode, const int iBpp)
+{
+    GIF_COOK_START
+    uint16_t *pPal = (pPage->bUseLocalPalette) ? pPage->pLocalPal : pPage->pPalette;
+    uint16_t *d = (uint16_t *)pDest, u16BG = pPal[ucBG];
+
+    (void)iBpp;
+    if (iMode == GIF_COOK_OPAQUE) { // convert all pixels through the palette
+#if defined (HAS_SSE2) && !defined(NO_SIMD)
+        GIF_cookPixels(s, d8, -1, pDraw->iWidth, (uint32_t *)pPal, d);
+        s = pEnd; // all of the pixels have been converted
+#endif // x86 SSE2/AVX2
+#if REGISTER_WIDTH == 64
+        // parallelize the writes
+        // optimizing for the write buffer helps; reading 4 bytes at a time vs 1 doesn't on M1
+        while (s < pEnd - 3) { // group 4 pixels
+            BIGUINT bu;
+            uint8_t s0, s1, s2, s3;
+            uint16_t d1, d2, d3;
+            *(uint32_t *)d8 = *(uint32_t *)s; // just copy new opaque pixels over the old
+            s0 = s[0]; s1 = s[1]; s2 = s[2]; s3 = s[3];
+            bu = pPal[s0]; // not much difference on Apple M1
+            d1 = pPal[s1]; // but other processors may gain
+            d2 = pPal[s2]; // from unrolling the reads
+            d3 = pPal[s3];
+            bu |= (BIGUINT)d1 << 16;
+            bu |= (BIGUINT)d2 << 32;
+            bu |= (BIGUINT)d3 << 48;
+            s += 4;
+            d8 += 4;
+            *(BIGUINT *)d = bu;
+            d += 4;
+        }
+#endif
+    }
+    while (s < pEnd) {
+        c = *s++;
+        GIF_COOK_MASK(c);
+        *d = (uint16_t)GIF_COOK_SELECT(pPal[c], (iMode == GIF_COOK_DISPOSE) ? u16BG : *d);
+        *d8 = GIF_COOK_INDEX(c);
+        d++;
+        d8++;
+    }
+} /* GIFCook565() */
+//
+// RGB888 (iBpp = 3) or RGB8888 (iBpp = 4, alpha = 0xff)
+//
+static GIF_INLINE void GIFCookRGB(GIFIMAGE *pPage, GIFDRAW *pDraw, void *pDest, const int iMode, const int iBpp)
+{
+    GIF_COOK_START
+    uint8_t *pPal = (pPage->bUseLocalPalette) ? (uint8_t *)pPage->pLocalPal : (uint8_t *)pPage->pPalette;
+    uint8_t *p, *d = (uint8_t *)pDest, *bg = &pPal[ucBG * 3];
+
+    while (s < pEnd) {
+        c = *s++;
+        GIF_COOK_MASK(c);
+        // a transparent pixel copies itself unless it's restored to the background color
+        p = (u32Mask) ? &pPal[c * 3] : ((iMode == GIF_COOK_DISPOSE) ? bg : d);
+        d[0] = p[0];
+        d[1] = p[1];
+        d[2] = p[2];
+        if (iBpp == 4)
+            d[3] = (iMode == GIF_COOK_DISPOSE) ? 0xff : (uint8_t)GIF_COOK_SELECT(0xff, d[3]);
+        *d8 = GIF_COOK_INDEX(c);
+        d8++;
+        d += iBpp;
+    }
+} /* GIFCookRGB() */
+//
+// One function per palette type and mode for GIFInitDraw() to choose from
+//
+#define GIF_COOK_MODES(name, kernel, iBpp) \
+static void name##Opaque(GIFIMAGE *pPage, GIFDRAW *pDraw, void *pDest) { kernel(pPage, pDraw, pDest, GIF_COOK_OPAQUE, iBpp); } \
+static void name##Transparent(GIFIMAGE *pPage, GIFDRAW *pDraw, void *pDest) { kernel(pPage, pDraw, pDest, GIF_COOK_TRANSPARENT, iBpp); } \
+static void name##Dispose(GIFIMAGE *pPage, GIFDRAW *pDraw, void *pDest) { kernel(pPage, pDraw, pDest, GIF_COOK_DISPOSE, iBpp); }
+
+GIF_COOK_MODES(GIFCookLine565, GIFCook565, 2)
+GIF_COOK_MODES(GIFCookLine888, GIFCookRGB, 3)
+GIF_COOK_MODES(GIFCookLine8888, GIFCookRGB, 4)
+GIF_COOK_MODES(GIFCookLine1Bpp, GIFCook1Bpp, 1)
+GIF_COOK_MODES(GIFCookLineOLED, GIFCook1BppOLED, 1)
+
+// indexed by palette type, then mode
+static GIF_COOK_LINE * const pfnCookLines[GIF_PALETTE_1BPP_OLED+1][3] = {
+    {GIFCookLine565Opaque, GIFCookLine565Transparent, GIFCookLine565Dispose}, // RGB565_LE
+    {GIFCookLine565Opaque, GIFCookLine565Transparent, GIFCookLine565Dispose}, // RGB565_BE
+    {GIFCookLine888Opaque, GIFCookLine888Transparent, GIFCookLine888Dispose},
+    {GIFCookLine8888Opaque, GIFCookLine8888Transparent, GIFCookLine8888Dispose},
+    {GIFCookLine1BppOpaque, GIFCookLine1BppTransparent, GIFCookLine1BppDispose},
+    {GIFCookLineOLEDOpaque, GIFCookLineOLEDTransparent, GIFCookLineOLEDDispose}
+};
+//
+// Select the DrawCooked() kernel for the frame described by pDraw
+//
+static void GIFSelectCook(GIFIMAGE *pPage, GIFDRAW *pDraw)
+{
+    int iType = pPage->ucPaletteType, iMode = GIF_COOK_OPAQUE;
+
+    if (iType > GIF_PALETTE_1BPP_OLED)
+        iType = GIF_PALETTE_RGB8888;
+    if (pDraw->ucHasTransparency)
+        iMode = (pDraw->ucDisposalMethod == 2) ? GIF_COOK_DISPOSE : GIF_COOK_TRANSPARENT;
+    pPage->pfnCookLine = pfnCookLines[iType][iMode];
+} /* GIFSelectCook() */
+//
+// Draw and convert pixels when the user wants fully rendered output
+//
+static void DrawCooked(GIFIMAGE *pPage, GIFDRAW *pDraw, void *pDest)
+{
+    if (GIF_COMPARING(pPage) && pDraw->pSpans) { // only convert the pixels which changed
+        GIFDrawChanged(pPage, pDraw, pDest);
+        return;
+    }
+    GIFDirtyRow(pPage, pDraw);
+    (*pPage->pfnCookLine)(pPage, pDraw, pDest);
+} /* DrawCooked() */
+#if (defined (ARDUINO_ESP32S3_DEV) || defined(ARDUINO_ESP32P4_DEV)) && !defined(NO_SIMD)
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+void s3_merge_transparent(uint8_t *pSrc, uint8_t *pDst, uint8_t *ucTrans, int iLen, uint32_t *pPalette, uint16_t *pRGB565);
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+#endif // ESP32S3/P4 SIMD
+#if defined (HAS_SSE2) && !defined(NO_SIMD)
+static int iGIFSIMD = -1; // x86 kernels in use (GIF_SIMD_xxx), -1 = CPU not tested yet
+//
+// Returns the x86 kernels used by GIF_mergeTransparent and GIF_cookPixels
+// The CPUID result is cached after the first call (see GIF_setSIMD)
+//
+static int GIF_SIMDLevel(void)
+{
+    if (iGIFSIMD < 0) {
+#ifdef HAS_AVX2
+        __builtin_cpu_init();
+        iGIFSIMD = (__builtin_cpu_supports("avx2") != 0) ? GIF_SIMD_AVX2 : GIF_SIMD_SSE2;
+#else
+        iGIFSIMD = GIF_SIMD_SSE2; // part of the x64 baseline
+#endif
+    }
+    return iGIFSIMD;
+} /* GIF_SIMDLevel() */
+#ifdef HAS_AVX2
+//
+// Returns 1 if the CPU (and OS) support AVX2 instructions and they're in use
+//
+static int GIF_hasAVX2(void)
+{
+    return (GIF_SIMDLevel() == GIF_SIMD_AVX2);
+} /* GIF_hasAVX2() */
+//
+// AVX2 version of the transparent pixel merge (32 pixels per iteration)
+// returns the number of pixels processed; the caller handles the tail
+//
+__attribute__((target("avx2")))
+static int GIF_mergeTransparentAVX2(uint8_t *pSrc, uint8_t *pDst, uint8_t ucTrans, int iLen)
+{
+    const __m256i ymmTrans = _mm256_set1_epi8((char)ucTrans);
+    int i;
+    for (i=0; i<=iLen-32; i+=32) {
+        __m256i ymmSrc = _mm256_loadu_si256((const __m256i *)&pSrc[i]);
+        __m256i ymmDst = _mm256_loadu_si256((const __m256i *)&pDst[i]);
+        __m256i ymmMask = _mm256_cmpeq_epi8(ymmSrc, ymmTrans); // FF = transparent
+        ymmDst = _mm256_blendv_epi8(ymmSrc, ymmDst, ymmMask); // keep old pixels where transparent
+        _mm256_storeu_si256((__m256i *)&pDst[i], ymmDst);
+    }
+    return i;
+} /* GIF_mergeTransparentAVX2() */
+//
+// AVX2 version of the merge + RGB565 palette conversion (16 pixels per iteration)
+// The palette lookup uses 32-bit gathers at 16-bit offsets. Entry 255 is
+// excluded from the gather mask so that we never read past a 256 entry palette.
+// returns the number of pixels processed; the caller handles the tail
+//
+__attribute__((target("avx2")))
+static int GIF_cookPixelsAVX2(uint8_t *pSrc, uint8_t *pDst, int iTrans, int iLen, uint16_t *pPal, uint16_t *pRGB565)
+{
+    const __m256i ymmLast = _mm256_set1_epi32(255);
+    const __m256i ymmLastColor = _mm256_set1_epi32(pPal[255]);
+    const __m256i ymmLow16 = _mm256_set1_epi32(0xffff);
+    const __m128i xmmTrans = _mm_set1_epi8((char)iTrans);
+    int i;
+    for (i=0; i<=iLen-16; i+=16) {
+        __m128i xmmPels = _mm_loadu_si128((const __m128i *)&pSrc[i]);
+        __m256i ymmIdx0, ymmIdx1, ymmPix0, ymmPix1, ymmMask;
+        if (iTrans != -1) { // merge with the existing pixels
+            __m128i xmmOld = _mm_loadu_si128((const __m128i *)&pDst[i]);
+            __m128i xmmMask = _mm_cmpeq_epi8(xmmPels, xmmTrans);
+            xmmPels = _mm_or_si128(_mm_and_si128(xmmMask, xmmOld), _mm_andnot_si128(xmmMask, xmmPels));
+        }
+        _mm_storeu_si128((__m128i *)&pDst[i], xmmPels);
+        ymmIdx0 = _mm256_cvtepu8_epi32(xmmPels);
+        ymmIdx1 = _mm256_cvtepu8_epi32(_mm_srli_si128(xmmPels, 8));
+        ymmMask = _mm256_xor_si256(_mm256_cmpeq_epi32(ymmIdx0, ymmLast), _mm256_set1_epi32(-1));
+        ymmPix0 = _mm256_mask_i32gather_epi32(ymmLastColor, (const int *)pPal, ymmIdx0, ymmMask, 2);
+        ymmMask = _mm256_xor_si256(_mm256_cmpeq_epi32(ymmIdx1, ymmLast), _mm256_set1_epi32(-1));
+        ymmPix1 = _mm256_mask_i32gather_epi32(ymmLastColor, (const int *)pPal, ymmIdx1, ymmMask, 2);
+        ymmPix0 = _mm256_and_si256(ymmPix0, ymmLow16);
+        ymmPix1 = _mm256_and_si256(ymmPix1, ymmLow16);
+        // pack works within 128-bit lanes, so fix the order afterwards
+        ymmPix0 = _mm256_permute4x64_epi64(_mm256_packus_epi32(ymmPix0, ymmPix1), 0xd8);
+        _mm256_storeu_si256((__m256i *)&pRGB565[i], ymmPix0);
+    }
+    return i;
+} /* GIF_cookPixelsAVX2() */
+#endif // HAS_AVX2
+//
+// SSE2 version of the merge + RGB565 palette conversion
+// SSE2 has no gather instruction, so the merge is done 16 pixels at a time
+// and the palette lookups are written 4 at a time as 64-bit values
+// returns the number of pixels processed; the caller handles the tail
+//
+static int GIF_cookPixelsSSE2(uint8_t *pSrc, uint8_t *pDst, int iTrans, int iLen, uint16_t *pPal, uint16_t *pRGB565)
+{
+    const __m128i xmmTrans = _mm_set1_epi8((char)iTrans);
+    int i, j;
+    for (i=0; i<=iLen-16; i+=16) {
+        __m128i xmmPels = _mm_loadu_si128((const __m128i *)&pSrc[i]);
+        if (iTrans != -1) {
+            __m128i xmmOld = _mm_loadu_si128((const __m128i *)&pDst[i]);
+            __m128i xmmMask = _mm_cmpeq_epi8(xmmPels, xmmTrans);
+            xmmPels = _mm_or_si128(_mm_and_si128(xmmMask, xmmOld), _mm_andnot_si128(xmmMask, xmmPels));
+        }
+        _mm_storeu_si128((__m128i *)&pDst[i], xmmPels);
+        for (j=0; j<16; j+=4) {
+            const uint8_t *s = &pDst[i+j];
+            uint64_t u64 = pPal[s[0]];
+            u64 |= (uint64_t)pPal[s[1]] << 16;
+            u64 |= (uint64_t)pPal[s[2]] << 32;
+            u64 |= (uint64_t)pPal[s[3]] << 48;
+            memcpy(&pRGB565[i+j], &u64, sizeof(u64));
+        }
+    }
+    return i;
+} /* GIF_cookPixelsSSE2() */
+#endif // HAS_SSE2
+//
+// Merge transparent pixels of a new line of image into the existing framebuffer
+//
+// This function is SIMD-optimized on CPUs which support SIMD instructions
+// SIMD instructions are well suited to speed up this operation since they
+// include compare instructions which allow merging of transparent pixels without
+// the use of branching.
+//
+void GIF_mergeTransparent(uint8_t *pSrc, uint8_t *pDst, uint8_t ucTrans, int iLen)
+{
+#if defined (HAS_NEON) && !defined(NO_SIMD)
+    uint8x16_t u8x16_src, u8x16_dst, u8x16_mask;
+    const uint8x16_t u8x16_trans = vdupq_n_u8(ucTrans);
+    while (iLen >= 16) {
+        u8x16_src = vld1q_u8(pSrc);
+        u8x16_dst = vld1q_u8(pDst);
+        pSrc += 16;
+        u8x16_mask = vceqq_u8(u8x16_src, u8x16_trans);
+        u8x16_mask = vmvnq_u8(u8x16_mask); // there is no compare-not-equal
+        u8x16_dst = vandq_u8(u8x16_dst, u8x16_mask); // preserve original pixels
+        u8x16_src = vbicq_u8(u8x16_src, u8x16_mask); // preserve opaque src pixels
+        u8x16_dst = vorrq_u8(u8x16_src, u8x16_dst); // combine everything
+        vst1q_u8(pDst, u8x16_dst); // store final pixels
+        pDst += 16;
+        iLen -= 16;
+    }
+    // Fall through to the generic C code for the 'tail' bytes
+#endif // Arm NEON
+#if defined (HAS_SSE2) && !defined(NO_SIMD)
+    if (GIF_SIMDLevel() != GIF_SIMD_NONE) {
+        int i = 0;
+#ifdef HAS_AVX2
+        if (GIF_hasAVX2()) {
+            i = GIF_mergeTransparentAVX2(pSrc, pDst, ucTrans, iLen);
+        }
+#endif // HAS_AVX2
+        const __m128i xmmTrans = _mm_set1_epi8((char)ucTrans);
+        for (; i<=iLen-16; i+=16) {
+            __m128i xmmSrc = _mm_loadu_si128((const __m128i *)&pSrc[i]);
+            __m128i xmmDst = _mm_loadu_si128((const __m128i *)&pDst[i]);
+            __m128i xmmMask = _mm_cmpeq_epi8(xmmSrc, xmmTrans); // FF = transparent
+            xmmDst = _mm_and_si128(xmmDst, xmmMask); // preserve original pixels
+            xmmSrc = _mm_andnot_si128(xmmMask, xmmSrc); // preserve opaque src pixels
+            _mm_storeu_si128((__m128i *)&pDst[i], _mm_or_si128(xmmSrc, xmmDst));
+        }
+        pSrc += i; pDst += i;
+        iLen -= i;
+    }
+    // Fall through to the generic C code for the 'tail' bytes
+#endif // x86 SSE2/AVX2
+
+// Generic C version
+    for (int i=0; i<iLen; i++) {
+        uint8_t c = *pSrc++;
+        if (c != ucTrans) {
+            *pDst = c;
+        }
+        pDst++;
+    } // for i
+} /* GIF_mergeTransparent() */
+//
+// Prepare final RGB565 pixels from a newly decoded line and 8-bit framebuffer
+//
+void GIF_cookPixels(uint8_t *pSrc, uint8_t *pDst, int iTrans, int iLen, uint32_t *pPalette, uint16_t *pRGB565)
+{
+#if (defined (ARDUINO_ESP32S3_DEV) || defined(ARDUINO_ESP32P4_DEV)) && !defined(NO_SIMD)
+    uint8_t ucTrans, *pTrans;
+    if (iTrans == -1) {
+        pTrans = NULL;
+    } else {
+        ucTrans = (uint8_t)iTrans;
+        pTrans = &ucTrans;
+    }
+    s3_merge_transparent(pSrc, pDst, pTrans, iLen, pPalette, pRGB565);
+    return;
+#endif // ESP32S3/P4
+
+// Generic C version
+uint16_t *pPal = (uint16_t *)pPalette; // assume 16-bit palette for non-SIMD
+#if defined (HAS_SSE2) && !defined(NO_SIMD)
+    if (GIF_SIMDLevel() != GIF_SIMD_NONE) {
+        int i;
+#ifdef HAS_AVX2
+        if (GIF_hasAVX2()) {
+            i = GIF_cookPixelsAVX2(pSrc, pDst, iTrans, iLen, pPal, pRGB565);
+        } else
+#endif // HAS_AVX2
+        {
+            i = GIF_cookPixelsSSE2(pSrc, pDst, iTrans, iLen, pPal, pRGB565);
+        }
+        pSrc += i; pDst += i; pRGB565 += i;
+        iLen -= i;
+    }
+    // Fall through to the generic C code for the 'tail' pixels
+#endif // x86 SSE2/AVX2
+    if (iTrans == -1) { // no transparent color
+        for (int i=0; i<iLen; i++) {
+            uint8_t c = *pSrc++;
+            *pDst++ = c;
+            *pRGB565++ = pPal[c];
+        }
+    } else {
+        uint8_t ucTrans = (uint8_t)iTrans;
+        for (int i=0; i<iLen; i++) {
+            uint8_t c = *pSrc++;
+            if (c != ucTrans) {
+                *pDst++ = c;
+            } else {
+                c = *pDst++;
+            }
+            *pRGB565++ = pPal[c];
+        } // for i
+    } // transparent color
+} /* GIF_cookPixels() */
+//
+// Select the x86 kernels of GIF_mergeTransparent and GIF_cookPixels
+// GIF_SIMD_AUTO (or any negative value) goes back to the best one the CPU
+// supports; a level above that isn't used. This is for testing each kernel
+// and isn't thread safe.
+// returns the level in use
+//
+int GIF_setSIMD(int iLevel)
+{
+#if defined (HAS_SSE2) && !defined(NO_SIMD)
+    int iMax;
+
+    iGIFSIMD = -1;
+    iMax = GIF_SIMDLevel(); // what the CPU supports
+    if (iLevel >= GIF_SIMD_NONE && iLevel < iMax)
+        iGIFSIMD = iLevel;
+    return iGIFSIMD;
+#else
+    (void)iLevel;
+    return GIF_SIMD_NONE; // no x86 kernels in this build
+#endif
+} /* GIF_setSIMD() */
+
+//
+// Add a [start, length) pair to an opaque span list
+// Returns the new count or -1 once the list is full
+//
+static int GIFAddSpan(uint16_t *pSpans, int iCount, int iMaxSpans, int iStart, int iEnd)
+{
+    if (iCount < 0 || iCount >= iMaxSpans)
+        return -1;
+    pSpans[iCount*2] = (uint16_t)iStart;
+    pSpans[iCount*2+1] = (uint16_t)(iEnd - iStart);
+    return iCount+1;
+} /* GIFAddSpan() */
+#if (defined (HAS_SSE2) || defined (HAS_NEON)) && !defined(NO_SIMD)
+static int GIFTrailingZeros(uint32_t u32)
+{
+#if defined(__GNUC__)
+    return __builtin_ctz(u32);
+#else
+    int i = 0;
+    while (!(u32 & 1)) {
+        u32 >>= 1;
+        i++;
+    }
+    return i;
+#endif
+} /* GIFTrailingZeros() */
+//
+// Turn a 16-pixel opaque bit mask (1 = opaque) into spans
+// *pStart is the start of the span still open from the previous group (-1 = none)
+//
+static int GIFSpanBits(uint32_t u32Opaque, int iBase, int *pStart, uint16_t *pSpans, int iCount, int iMaxSpans)
+{
+    int j;
+    uint32_t u32;
+
+    if (u32Opaque == 0xffff) { // all opaque, just extend the current span
+        if (*pStart < 0)
+            *pStart = iBase;
+        return iCount;
+    }
+    if (u32Opaque == 0) { // all transparent, close the current span
+        if (*pStart >= 0) {
+            iCount = GIFAddSpan(pSpans, iCount, iMaxSpans, *pStart, iBase);
+            *pStart = -1;
+        }
+        return iCount;
+    }
+    j = 0;
+    while (j < 16) { // walk the edges between opaque and transparent runs
+        u32 = (*pStart < 0) ? u32Opaque : (~u32Opaque & 0xffff);
+        u32 >>= j;
+        if (u32 == 0)
+            break;
+        j += GIFTrailingZeros(u32);
+        if (*pStart < 0) {
+            *pStart = iBase + j;
+        } else {
+            iCount = GIFAddSpan(pSpans, iCount, iMaxSpans, *pStart, iBase + j);
+            *pStart = -1;
+        }
+    }
+    return iCount;
+} /* GIFSpanBits() */
+#endif // SIMD
+//
+// Find the opaque spans of a line of 8-bit pixels and optionally merge the
+// opaque pixels into pDst (like GIF_mergeTransparent) in the same pass.
+// The SIMD compare which finds the transparent pixels for the merge gives
+// us a bit mask of them (movemask) almost for free.
+// Returns the number of [start, length) pairs or -1 if they don't fit
+//
+static int GIFMergeSpans(uint8_t *pSrc, uint8_t *pDst, uint8_t ucTrans, int iLen, uint16_t *pSpans, int iMaxSpans)
+{
+    int i = 0, iStart = -1, iCount = 0;
+#if defined (HAS_NEON) && !defined(NO_SIMD)
+    {
+        uint8x16_t u8x16_src, u8x16_mask;
+        const uint8x16_t u8x16_trans = vdupq_n_u8(ucTrans);
+        uint64_t u64;
+        uint32_t u32;
+        for (; i<=iLen-16; i+=16) {
+            u8x16_src = vld1q_u8(&pSrc[i]);
+            u8x16_mask = vceqq_u8(u8x16_src, u8x16_trans); // FF = transparent
+            if (pDst) {
+                uint8x16_t u8x16_dst = vld1q_u8(&pDst[i]);
+                u8x16_dst = vbslq_u8(u8x16_mask, u8x16_dst, u8x16_src);
+                vst1q_u8(&pDst[i], u8x16_dst);
+            }
+            // NEON has no movemask; narrow the mask to 4 bits per pixel instead
+            u64 = ~vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(u8x16_mask), 4)), 0);
+            if (u64 == 0) {
+                u32 = 0;
+            } else if (u64 == 0xffffffffffffffffULL) {
+                u32 = 0xffff;
+            } else {
+                u32 = 0;
+                for (int j=0; j<16; j++)
+                    u32 |= (uint32_t)((u64 >> (j*4)) & 1) << j;
+            }
+            iCount = GIFSpanBits(u32, i, &iStart, pSpans, iCount, iMaxSpans);
+        }
+    }
+#endif // Arm NEON
+#if defined (HAS_SSE2) && !defined(NO_SIMD)
+    {
+        const __m128i xmmTrans = _mm_set1_epi8((char)ucTrans);
+        for (; i<=iLen-16; i+=16) {
+            __m128i xmmSrc = _mm_loadu_si128((const __m128i *)&pSrc[i]);
+            __m128i xmmMask = _mm_cmpeq_epi8(xmmSrc, xmmTrans); // FF = transparent
+            if (pDst) {
+                __m128i xmmDst = _mm_loadu_si128((const __m128i *)&pDst[i]);
+                xmmDst = _mm_and_si128(xmmDst, xmmMask); // preserve original pixels
+                xmmSrc = _mm_andnot_si128(xmmMask, xmmSrc); // preserve opaque src pixels
+                _mm_storeu_si128((__m128i *)&pDst[i], _mm_or_si128(xmmSrc, xmmDst));
+            }
+            iCount = GIFSpanBits(~_mm_movemask_epi8(xmmMask) & 0xffff, i, &iStart, pSpans, iCount, iMaxSpans);
+        }
+    }
+#endif // x86 SSE2
+    // Generic C version (and the 'tail' pixels)
+    for (; i<iLen; i++) {
+        uint8_t c = pSrc[i];
+        if (c != ucTrans) {
+            if (pDst)
+                pDst[i] = c;
+            if (iStart < 0)
+                iStart = i;
+        } else if (iStart >= 0) {
+            iCount = GIFAddSpan(pSpans, iCount, iMaxSpans, iStart, i);
+            iStart = -1;
+        }
+    }
+    if (iStart >= 0)
+        iCount = GIFAddSpan(pSpans, iCount, iMaxSpans, iStart, iLen);
+    return iCount;
+} /* GIFMergeSpans() */
+//
+// Build the opaque span list of the current line (optionally merging it into pDst)
+// A list which doesn't fit in the span buffer is reported as not available
+//
+static void GIFLineSpans(GIFDRAW *pDraw, int iMaxSpans, uint8_t *pDst)
+{
+    int iCount = GIFMergeSpans(pDraw->pPixels, pDst, pDraw->ucTransparent, pDraw->iWidth, pDraw->pSpans, iMaxSpans);
+    if (iCount < 0)
+        pDraw->pSpans = NULL;
+    else
+        pDraw->iSpanCount = iCount;
+} /* GIFLineSpans() */
+//
+// Prepare GIFDRAW.pSpans for the current line before it's drawn
+// RAW lines merged into the frame buffer get their spans from DrawNewPixels
+// Strips hold more than one line, so they don't get a span list
+//
+static void GIFSpanLine(GIFIMAGE *pPage, GIFDRAW *pDraw, int bStrip)
+{
+    if (bStrip)
+        pDraw->pSpans = NULL;
+    else if (pDraw->pSpans && pDraw->ucHasTransparency && pPage->pfnDraw &&
+             !(pPage->pFrameBuffer && pPage->ucDrawType == GIF_DRAW_RAW) && !GIF_COMPARING(pPage))
+        GIFLineSpans(pDraw, pPage->iSpanMax, NULL);
+} /* GIFSpanLine() */
+//
+// Lines without any opaque pixels don't need to be drawn, unless they're
+// erased to the background color (disposal method 2). With compare-on-write
+// the spans are the changed pixels, so a line without any isn't drawn either.
+//
+#define GIF_LINE_VISIBLE(p, d) ((d)->pSpans == NULL || (d)->iSpanCount != 0 || ((d)->ucDisposalMethod == 2 && !GIF_COMPARING(p)))
+//
+// Compare-on-write version of DrawCooked
+// The new line is merged into the 8-bit canvas while finding the pixels
+// whose index changed (the same test as GIFDirtyRow). Only those get
+// converted through the palette and listed in pDraw->pSpans. When the list
+// is full, the last span is stretched to cover the remaining changes.
+//
+static void GIFDrawChanged(GIFIMAGE *pPage, GIFDRAW *pDraw, void *pDest)
+{
+    uint8_t c, *s, *d8, *pPal;
+    uint8_t ucTrans = pDraw->ucTransparent, ucBG = pDraw->ucBackground;
+    int x, i, iLen = pDraw->iWidth, iStart = -1, iCount = 0, iEnd = 0;
+    int iMaxSpans = pPage->iSpanMax, y = pDraw->iY + pDraw->y;
+    int bTrans = pDraw->ucHasTransparency, bDispose = (bTrans && pDraw->ucDisposalMethod == 2);
+    int bAll = pPage->bDirtyAll, bChanged;
+    uint16_t *pSpans = pDraw->pSpans;
+
+    pPal = (pPage->bUseLocalPalette) ? (uint8_t *)pPage->pLocalPal : (uint8_t *)pPage->pPalette;
+    s = pDraw->pPixels;
+    d8 = &pPage->pFrameBuffer[pDraw->iX + y * pPage->iCanvasWidth];
+    x = 0;
+#if defined (HAS_SSE2) && !defined(NO_SIMD)
+    {
+        const __m128i xmmTrans = _mm_set1_epi8((char)ucTrans), xmmBG = _mm_set1_epi8((char)ucBG);
+        for (; x<=iLen-16; x+=16) {
+            __m128i xmmSrc = _mm_loadu_si128((const __m128i *)&s[x]);
+            __m128i xmmDst = _mm_loadu_si128((const __m128i *)&d8[x]);
+            uint32_t u32Changed = (bAll) ? 0xffff : (~_mm_movemask_epi8(_mm_cmpeq_epi8(xmmSrc, xmmDst)) & 0xffff);
+            if (bTrans) {
+                __m128i xmmMask = _mm_cmpeq_epi8(xmmSrc, xmmTrans); // FF = transparent
+                uint32_t u32Trans = _mm_movemask_epi8(xmmMask);
+                uint32_t u32Erase = 0; // transparent pixels restored to the background color
+                if (bDispose) {
+                    u32Erase = (bAll) ? u32Trans : (u32Trans & ~_mm_movemask_epi8(_mm_cmpeq_epi8(xmmDst, xmmBG)));
+                    xmmDst = xmmBG;
+                }
+                u32Changed = (u32Changed & ~u32Trans) | u32Erase;
+                if (u32Changed == 0) { // nothing to write in this group
+                    iCount = GIFSpanBits(0, x, &iStart, pSpans, iCount, iMaxSpans);
+                    continue;
+                }
+                xmmSrc = _mm_or_si128(_mm_andnot_si128(xmmMask, xmmSrc), _mm_and_si128(xmmMask, xmmDst));
+            }
+            if (u32Changed) {
+                _mm_storeu_si128((__m128i *)&d8[x], xmmSrc);
+                for (i=15; !(u32Changed & (1 << i)); i--) {}
+                iEnd = x + i + 1;
+            }
+            iCount = GIFSpanBits(u32Changed, x, &iStart, pSpans, iCount, iMaxSpans);
+        }
+    }
+#endif // x86 SSE2
+    // Generic C version (and the 'tail' pixels)
+    for (; x<iLen; x++) {
+        c = s[x];
+        if (bTrans && c == ucTrans) {
+            bChanged = bDispose && (bAll || d8[x] != ucBG);
+            c = ucBG;
+        } else {
+            bChanged = (bAll || c != d8[x]);
+        }
+        if (bChanged) {
+            d8[x] = c;
+            iEnd = x + 1;
+            if (iStart < 0)
+                iStart = x;
+        } else if (iStart >= 0) {
+            iCount = GIFAddSpan(pSpans, iCount, iMaxSpans, iStart, x);
+            iStart = -1;
+        }
+    }
+    if (iStart >= 0)
+        iCount = GIFAddSpan(pSpans, iCount, iMaxSpans, iStart, iLen);
+    if (iCount < 0) { // too many spans, the last one covers the rest of the changes
+        iCount = iMaxSpans;
+        pSpans[iCount*2-1] = (uint16_t)(iEnd - pSpans[iCount*2-2]);
+    }
+    pDraw->iSpanCount = iCount;
+    if (iCount == 0)
+        return;
+    GIFDirtyAdd(pPage, pDraw->iX + pSpans[0], y, pDraw->iX + iEnd);
+    // Convert the changed pixels from the updated canvas
+    for (i=0; i<iCount; i++) {
+        int iX = pSpans[i*2], iSpan = pSpans[i*2+1];
+        uint8_t *d;
+        switch (pPage->ucPaletteType) {
+            case GIF_PALETTE_RGB565_LE:
+            case GIF_PALETTE_RGB565_BE:
+                GIF_cookPixels(&d8[iX], &d8[iX], -1, iSpan, (uint32_t *)pPal, &((uint16_t *)pDest)[iX]);
+                break;
+            case GIF_PALETTE_RGB888:
+                d = &((uint8_t *)pDest)[iX * 3];
+                for (x=iX; x<iX+iSpan; x++) {
+                    memcpy(d, &pPal[d8[x] * 3], 3);
+                    d += 3;
+                }
+                break;
+            default: // GIF_PALETTE_RGB8888
+                d = &((uint8_t *)pDest)[iX * 4];
+                for (x=iX; x<iX+iSpan; x++) {
+                    memcpy(d, &pPal[d8[x] * 3], 3);
+                    d[3] = 0xff;
+                    d += 4;
+                }
+                break;
+        }
+    }
+} /* GIFDrawChanged() */
 //
 // Handle transparent pixels and disposal method
 // Used only when a frame buffer is allocated
@@ -1178,6 +4149,7 @@ static void DrawNewPixels(GIFIMAGE *pPage, GIFDRAW *pDraw)
     uint8_t *d, *s;
     int iPitch = pPage->iCanvasWidth;
 
+    GIFDirtyRow(pPage, pDraw);
     s = pDraw->pPixels;
     d = &pPage->pFrameBuffer[pDraw->iX + (pDraw->y + pDraw->iY)  * iPitch]; // dest pointer in our complete canvas buffer
     
@@ -1187,12 +4159,245 @@ static void DrawNewPixels(GIFIMAGE *pPage, GIFDRAW *pDraw)
         if (pDraw->ucDisposalMethod == 2) {
             memset(d, pDraw->ucBackground, pDraw->iWidth); // start with background color
         }
-        GIF_mergeTransparent(s, d, ucTransparent, pDraw->iWidth);
+        if (pDraw->pSpans) { // build the span list while merging
+            GIFLineSpans(pDraw, pPage->iSpanMax, d);
+        } else {
+            GIF_mergeTransparent(s, d, ucTransparent, pDraw->iWidth);
+        }
     } else { // disposal method doesn't matter when there aren't any transparent pixels
         memcpy(d, s, pDraw->iWidth); // just overwrite the old pixels
     }
 } /* DrawNewPixels() */
 //
+// Fill in the GIFDRAW fields which are the same for every line of the current frame
+//
+static void GIFInitDraw(GIFIMAGE *pPage, GIFDRAW *pDraw)
+{
+    pDraw->iX = pPage->iX;
+    pDraw->iY = pPage->iY;
+    pDraw->iWidth = pPage->iWidth;
+    pDraw->iHeight = pPage->iHeight;
+    pDraw->iCanvasWidth = pPage->iCanvasWidth;
+    pDraw->iStripHeight = 1;
+    pDraw->iPitch = GIFOutputPitch(pPage);
+    pDraw->pUser = pPage->pUser;
+    pDraw->pPalette = (pPage->bUseLocalPalette) ? pPage->pLocalPal : pPage->pPalette;
+    pDraw->pPalette24 = (uint8_t *)pDraw->pPalette; // just cast the pointer for RGB888
+    pPage->ucDisposalMethod = pDraw->ucDisposalMethod = (pPage->ucGIFBits & 0x1c)>>2;
+    pDraw->ucTransparent = pPage->ucTransparent;
+    pDraw->ucHasTransparency = pPage->ucGIFBits & 1;
+    pDraw->ucBackground = pPage->ucBackground;
+    pDraw->ucPaletteType = pPage->ucPaletteType;
+    pDraw->ucIsGlobalPalette = pPage->bUseLocalPalette==1?0:1;
+    pDraw->pSpans = pPage->pSpanBuf;
+    pDraw->iSpanCount = 0;
+    if (pDraw->pSpans && !pDraw->ucHasTransparency) { // every line is a single opaque span
+        pDraw->pSpans[0] = 0;
+        pDraw->pSpans[1] = (uint16_t)pDraw->iWidth;
+        pDraw->iSpanCount = 1;
+    }
+    GIFSelectCook(pPage, pDraw);
+} /* GIFInitDraw() */
+//
+// Downscaled output
+// An output pixel is kept for every source pixel whose canvas coordinates
+// are both multiples of the scale factor, so the canvas and frame rects
+// shrink to GIF_SCALED() of their source edges and frames stay aligned
+// with the canvas no matter where they start
+//
+static void GIFScaleCanvas(GIFIMAGE *pPage)
+{
+    pPage->iCanvasWidth = pPage->iWidth = GIF_SCALED(pPage, pPage->iSrcCanvasWidth);
+    pPage->iCanvasHeight = pPage->iHeight = GIF_SCALED(pPage, pPage->iSrcCanvasHeight);
+    pPage->iSrcWidth = pPage->iSrcCanvasWidth;
+    pPage->iSrcHeight = pPage->iSrcCanvasHeight;
+} /* GIFScaleCanvas() */
+//
+// Set the output rect of the current frame from its source rect
+// and clip it to the viewport (it can end up empty)
+//
+static void GIFScaleFrame(GIFIMAGE *pPage)
+{
+    int x1 = GIF_SCALED(pPage, pPage->iSrcX);
+    int y1 = GIF_SCALED(pPage, pPage->iSrcY);
+    int x2 = GIF_SCALED(pPage, pPage->iSrcX + pPage->iSrcWidth);
+    int y2 = GIF_SCALED(pPage, pPage->iSrcY + pPage->iSrcHeight);
+
+    if (pPage->iViewWidth) {
+        if (x1 < pPage->iViewX) x1 = pPage->iViewX;
+        if (y1 < pPage->iViewY) y1 = pPage->iViewY;
+        if (x2 > pPage->iViewX + pPage->iViewWidth) x2 = pPage->iViewX + pPage->iViewWidth;
+        if (y2 > pPage->iViewY + pPage->iViewHeight) y2 = pPage->iViewY + pPage->iViewHeight;
+        if (x1 > pPage->iCanvasWidth) x1 = pPage->iCanvasWidth;
+        if (y1 > pPage->iCanvasHeight) y1 = pPage->iCanvasHeight;
+        if (x2 < x1) x2 = x1;
+        if (y2 < y1) y2 = y1;
+    }
+    pPage->iX = (uint16_t)x1;
+    pPage->iY = (uint16_t)y1;
+    pPage->iWidth = (uint16_t)(x2 - x1);
+    pPage->iHeight = (uint16_t)(y2 - y1);
+} /* GIFScaleFrame() */
+//
+// Return the 8-bit RGB components of a palette entry in the current output format
+//
+static void GIFPaletteRGB(GIFIMAGE *pPage, uint8_t ucIndex, int *pR, int *pG, int *pB)
+{
+    uint8_t *pPal = (uint8_t *)((pPage->bUseLocalPalette) ? pPage->pLocalPal : pPage->pPalette);
+    uint16_t us;
+
+    switch (pPage->ucPaletteType) {
+        case GIF_PALETTE_RGB565_LE:
+        case GIF_PALETTE_RGB565_BE:
+            us = ((uint16_t *)pPal)[ucIndex];
+            if (pPage->ucPaletteType == GIF_PALETTE_RGB565_BE)
+                us = __builtin_bswap16(us);
+            *pR = (us >> 8) & 0xf8;
+            *pG = (us >> 3) & 0xfc;
+            *pB = (us << 3) & 0xf8;
+            break;
+        case GIF_PALETTE_1BPP:
+        case GIF_PALETTE_1BPP_OLED:
+            *pR = *pG = *pB = (pPal[ucIndex]) ? 255 : 0;
+            break;
+        default: // RGB888 / RGB8888 keep the original entries
+            *pR = pPal[ucIndex * 3];
+            *pG = pPal[ucIndex * 3 + 1];
+            *pB = pPal[ucIndex * 3 + 2];
+            break;
+    }
+} /* GIFPaletteRGB() */
+//
+// Box filter one output pixel from a fully decoded frame
+// The result has to stay a palette index, so the opaque pixel of the block
+// closest to the block's average color is chosen. Blocks which are mostly
+// transparent stay transparent.
+//
+static uint8_t GIFBoxPixel(GIFIMAGE *pPage, uint8_t *pFrame, int x, int y)
+{
+    int f = 1 << pPage->ucScale;
+    int w = pPage->iSrcWidth - x, h = pPage->iSrcHeight - y;
+    int i, j, r, g, b, n = 0, iR = 0, iG = 0, iB = 0, iBest = 0x7fffffff;
+    int bTrans = pPage->ucGIFBits & 1;
+    uint8_t c, ucBest, *s;
+
+    if (w > f) w = f;
+    if (h > f) h = f;
+    s = &pFrame[(y * pPage->iSrcWidth) + x];
+    ucBest = s[0];
+    for (j=0; j<h; j++) {
+        for (i=0; i<w; i++) {
+            c = s[(j * pPage->iSrcWidth) + i];
+            if (bTrans && c == pPage->ucTransparent)
+                continue;
+            GIFPaletteRGB(pPage, c, &r, &g, &b);
+            iR += r; iG += g; iB += b;
+            n++;
+        }
+    }
+    if (n == 0 || n*2 < w*h) // mostly transparent
+        return (bTrans) ? pPage->ucTransparent : ucBest;
+    iR /= n; iG /= n; iB /= n;
+    for (j=0; j<h; j++) {
+        for (i=0; i<w; i++) {
+            c = s[(j * pPage->iSrcWidth) + i];
+            if (bTrans && c == pPage->ucTransparent)
+                continue;
+            GIFPaletteRGB(pPage, c, &r, &g, &b);
+            r = (r - iR)*(r - iR) + (g - iG)*(g - iG) + (b - iB)*(b - iB);
+            if (r < iBest) {
+                iBest = r;
+                ucBest = c;
+            }
+        }
+    }
+    return ucBest;
+} /* GIFBoxPixel() */
+//
+// Map one decoded source line to the (scaled and clipped) output frame rect
+// pDraw->y holds the frame-relative source row on entry and the output row
+// on exit. pFrame points to the whole decoded frame when it's available
+// (Turbo) so that the box filter can see every row of a block; otherwise
+// the line is decimated in place. Returns 0 if the line isn't part of the output.
+//
+static int GIFScaleLine(GIFIMAGE *pPage, GIFDRAW *pDraw, uint8_t *pFrame)
+{
+    int i, x, sh = pPage->ucScale;
+    int sy = pPage->iSrcY + pDraw->y;
+    uint8_t *s, *d = pPage->pLineBufAligned;
+
+    if ((sy & ((1 << sh)-1)) || pPage->iWidth == 0)
+        return 0;
+    pDraw->y = (sy >> sh) - pPage->iY;
+    if (pDraw->y < 0 || pDraw->y >= pPage->iHeight) // outside of the viewport
+        return 0;
+    x = (pPage->iX << sh) - pPage->iSrcX; // first kept column within the frame
+    if (sh == 0) { // viewport only, the visible pixels are already contiguous
+        pDraw->pPixels += x;
+    } else if (pFrame && pPage->ucScaleFilter == GIF_SCALE_BOX) {
+        for (i=0; i<pPage->iWidth; i++)
+            d[i] = GIFBoxPixel(pPage, pFrame, x + (i << sh), sy - pPage->iSrcY);
+        pDraw->pPixels = d;
+    } else {
+        s = pDraw->pPixels;
+        for (i=0; i<pPage->iWidth; i++) // safe in place since the reads stay ahead
+            d[i] = s[x + (i << sh)];
+        pDraw->pPixels = d;
+    }
+    return 1;
+} /* GIFScaleLine() */
+//
+// Strip mode
+// Finished lines are collected in the strip buffer and the GIFDRAW callback
+// receives up to iStripLines lines at a time. Interlaced frames and
+// 1-bpp output are always sent one line at a time.
+//
+// Return a pointer to the strip buffer line for the current output line
+// or NULL if strip mode is not active for this frame
+//
+static uint8_t *GIFStripLine(GIFIMAGE *pPage, GIFDRAW *pDraw)
+{
+    if (pPage->iStripLines < 2 || pPage->pStripBuf == NULL || pPage->pfnDraw == NULL || (pPage->ucMap & 0x40) ||
+        (pPage->ucDrawType == GIF_DRAW_COOKED && (pPage->ucPaletteType == GIF_PALETTE_1BPP || pPage->ucPaletteType == GIF_PALETTE_1BPP_OLED)))
+        return NULL;
+    if (pPage->iStripCount == 0) // first line of a new strip
+        pPage->iStripY = pDraw->y;
+    return &pPage->pStripBuf[pPage->iStripCount * pDraw->iPitch];
+} /* GIFStripLine() */
+//
+// Add a finished line to the strip and send the strip to the GIFDRAW
+// callback when it's full or when the last line of the frame is reached
+//
+static void GIFStripAdd(GIFIMAGE *pPage, GIFDRAW *pDraw, uint8_t *pLine, int bLastLine)
+{
+    if (pDraw->pPixels != pLine) // RAW pixels need to be copied
+        memcpy(pLine, pDraw->pPixels, pDraw->iPitch);
+    pPage->iStripCount++;
+    if (pPage->iStripCount >= pPage->iStripLines || bLastLine) {
+        pDraw->y = pPage->iStripY;
+        pDraw->iStripHeight = pPage->iStripCount;
+        pDraw->pPixels = pPage->pStripBuf;
+        (*pPage->pfnDraw)(pDraw);
+        pPage->iStripCount = 0;
+    }
+} /* GIFStripAdd() */
+//
+// Send any lines left in the strip buffer (e.g. a frame which ended early)
+//
+static void GIFStripFlush(GIFIMAGE *pPage)
+{
+    if (pPage->iStripCount > 0) {
+        GIFDRAW gd;
+        GIFInitDraw(pPage, &gd);
+        gd.y = pPage->iStripY;
+        gd.iStripHeight = pPage->iStripCount;
+        gd.pPixels = pPage->pStripBuf;
+        gd.pSpans = NULL;
+        (*pPage->pfnDraw)(&gd);
+        pPage->iStripCount = 0;
+    }
+} /* GIFStripFlush() */
+//
 // LZWCopyBytes
 //
 // Output the bytes for a single code (checks for buffer len)
@@ -1246,6 +4451,74 @@ uint32_t u32Offset;
         code = ((ulBits >> bitnum) & sMask);  \
         bitnum += codesize;
 
+//
+// Send a fully decoded Turbo frame out one line at a time
+//
+static void GIFTurboOutput(GIFIMAGE *pImage, uint8_t *buf)
+{
+    // The whole frame is in the Turbo buffer; send it out one line at a time
+    // COOKED output converts each line through the palette. RAW output passes the
+    // 8-bit pixels to the GIFDRAW callback (and merges them into the frame buffer if present)
+    if ((pImage->ucDrawType == GIF_DRAW_COOKED && pImage->pFrameBuffer) ||
+        (pImage->ucDrawType == GIF_DRAW_RAW && pImage->pfnDraw)) {
+        GIFDRAW gd;
+        uint8_t *pStripLine;
+        int iStripLines = pImage->iStripLines;
+        // RAW lines are already contiguous in the Turbo buffer, so strips don't need to be copied
+        int bDirectStrip = (pImage->ucDrawType == GIF_DRAW_RAW && iStripLines > 1 && !(pImage->ucMap & 0x40) && !GIF_LINE_MAPPED(pImage));
+        for (int y=0; y<pImage->iSrcHeight; y++) {
+            GIFInitDraw(pImage, &gd);
+            gd.y = y;
+            gd.pPixels = &buf[(y * pImage->iSrcWidth)]; // source pixels
+            // Ugly logic to handle the interlaced line position, but it
+            // saves having to have another set of state variables
+            if (pImage->ucMap & 0x40) { // interlaced?
+               int height = pImage->iSrcHeight-1;
+               if (gd.y > height / 2)
+                  gd.y = gd.y * 2 - (height | 1);
+               else if (gd.y > height / 4)
+                  gd.y = gd.y * 4 - ((height & ~1) | 2);
+               else if (gd.y > height / 8)
+                  gd.y = gd.y * 8 - ((height & ~3) | 4);
+               else
+                  gd.y = gd.y * 8;
+            }
+            if (GIF_LINE_MAPPED(pImage) && !GIFScaleLine(pImage, &gd, buf))
+                continue; // this line isn't part of the output
+            if (pImage->ucDrawType == GIF_DRAW_RAW) {
+                GIFSpanLine(pImage, &gd, bDirectStrip);
+                if (pImage->pFrameBuffer) {
+                    DrawNewPixels(pImage, &gd); // merge the new opaque pixels
+                }
+                if (!bDirectStrip) {
+                    if (GIF_LINE_VISIBLE(pImage, &gd))
+                        (*pImage->pfnDraw)(&gd); // callback to handle this line
+                } else if ((y % iStripLines) == iStripLines-1 || y == pImage->iHeight-1) {
+                    gd.y = y - (y % iStripLines); // first line of this strip
+                    gd.iStripHeight = y - gd.y + 1;
+                    gd.pPixels = &buf[gd.y * pImage->iWidth];
+                    (*pImage->pfnDraw)(&gd); // callback to handle this strip
+                }
+            } else if (pImage->pfnDraw) {
+                pStripLine = GIFStripLine(pImage, &gd);
+                GIFSpanLine(pImage, &gd, (pStripLine != NULL));
+                if (pStripLine) {
+                    DrawCooked(pImage, &gd, pStripLine);
+                    gd.pPixels = pStripLine;
+                    GIFStripAdd(pImage, &gd, pStripLine, (gd.y == pImage->iHeight-1));
+                } else {
+                    DrawCooked(pImage, &gd, &buf[pImage->iSrcCanvasHeight * pImage->iSrcCanvasWidth]); // dest = one line past end of canvas
+                    gd.pPixels = &buf[pImage->iSrcCanvasHeight * pImage->iSrcCanvasWidth]; // point to the line we just converted
+                    if (GIF_LINE_VISIBLE(pImage, &gd))
+                        (*pImage->pfnDraw)(&gd); // callback to handle this line
+                }
+            } else if (pImage->pFrameBuffer) {
+                uint16_t *d = (uint16_t *)&pImage->pFrameBuffer[pImage->iCanvasWidth * pImage->iCanvasHeight];
+                DrawCooked(pImage, &gd, &d[((gd.y + gd.iY) * pImage->iCanvasWidth) + gd.iX]);
+            }
+        }
+    }
+} /* GIFTurboOutput() */
 //
 // DecodeLZWTurbo
 //
@@ -1289,12 +4562,13 @@ int iOffset;
 uint32_t *pSymbols;
 uint16_t *pLengths;
 
-    (void)iOptions;
-    pImage->iYCount = pImage->iHeight; // count down the lines
-    pImage->iXCount = pImage->iWidth;
+    pImage->iYCount = pImage->iSrcHeight; // count down the lines
+    pImage->iXCount = pImage->iSrcWidth;
     bitnum = 0;
-    pHighWater = pImage->ucLZW + LZW_HIGHWATER_TURBO;
+    // a fast GIF frame is already complete in memory; it never needs more data
+    pHighWater = pImage->pLZW + ((pImage->bFastGIF) ? pImage->iLZWSize : LZW_HIGHWATER_TURBO);
     pImage->iLZWOff = 0; // Offset into compressed data
+    pImage->iStripCount = 0;
     GIFGetMoreData(pImage); // Read some data to start
     codestart = pImage->ucCodeStart;
     iColors = 1 << codestart;
@@ -1302,12 +4576,12 @@ uint16_t *pLengths;
     sMask = 0xffffffff - sMask;
     cc = (sMask >> 1) + 1; /* Clear code */
     eoi = cc + 1;
-    iUncompressedLen = (pImage->iWidth * pImage->iHeight);
+    iUncompressedLen = (pImage->iSrcWidth * pImage->iSrcHeight);
     buf = (uint8_t *)pImage->pTurboBuffer;
     pSymbols = (uint32_t *)&buf[iUncompressedLen+256]; // we need 32-bits (really 23) for the offsets
     pLengths = (uint16_t *)&pSymbols[4096]; // but only 16-bits for the length of any single string
     iOffset = 0; // output data offset
-    p = pImage->ucLZW; // un-chunked LZW data
+    p = pImage->pLZW; // un-chunked LZW data
     ulBits = INTELLONG(p); // start by reading some LZW data
     // set up the default symbols (0..iColors-1)
    for (i = 0; i<iColors; i++) {
@@ -1358,55 +4632,17 @@ init_codetable:
                 sMask = (sMask << 1) | 1;
             }
             if (p >= pHighWater) {
-                pImage->iLZWOff = (int)(p - pImage->ucLZW); // restore object member var
+                pImage->iLZWOff = (int)(p - pImage->pLZW); // restore object member var
                 GIFGetMoreData(pImage); // We need to read more LZW data
-                p = &pImage->ucLZW[pImage->iLZWOff];
+                p = &pImage->pLZW[pImage->iLZWOff];
             }
             oldcode = code;
             GET_CODE_TURBO
         } /* while not end of LZW code stream */
     } // while not end of frame
-    if (pImage->ucDrawType == GIF_DRAW_COOKED && pImage->pFrameBuffer) { // convert each line through the palette
-        GIFDRAW gd;
-        gd.iX = pImage->iX;
-        gd.iY = pImage->iY;
-        gd.iWidth = pImage->iWidth;
-        gd.iHeight = pImage->iHeight;
-        gd.pPalette = (pImage->bUseLocalPalette) ? pImage->pLocalPalette : pImage->pPalette;
-        gd.pPalette24 = (uint8_t *)gd.pPalette; // just cast the pointer for RGB888
-        gd.ucIsGlobalPalette = pImage->bUseLocalPalette==1?0:1;
-        gd.pUser = pImage->pUser;
-        gd.ucPaletteType = pImage->ucPaletteType;
-        for (int y=0; y<pImage->iHeight; y++) {
-            gd.y = y;
-            gd.pPixels = &buf[(y * pImage->iWidth)]; // source pixels
-            // Ugly logic to handle the interlaced line position, but it
-            // saves having to have another set of state variables
-            if (pImage->ucMap & 0x40) { // interlaced?
-               int height = pImage->iHeight-1;
-               if (gd.y > height / 2)
-                  gd.y = gd.y * 2 - (height | 1);
-               else if (gd.y > height / 4)
-                  gd.y = gd.y * 4 - ((height & ~1) | 2);
-               else if (gd.y > height / 8)
-                  gd.y = gd.y * 8 - ((height & ~3) | 4);
-               else
-                  gd.y = gd.y * 8;
-            }
-            pImage->ucDisposalMethod = gd.ucDisposalMethod = (pImage->ucGIFBits & 0x1c)>>2;
-            gd.ucTransparent = pImage->ucTransparent;
-            gd.ucHasTransparency = pImage->ucGIFBits & 1;
-            gd.ucBackground = pImage->ucBackground;
-            gd.iCanvasWidth = pImage->iCanvasWidth;
-            if (pImage->pfnDraw) {
-                DrawCooked(pImage, &gd, &buf[pImage->iCanvasHeight * pImage->iCanvasWidth]); // dest = one line past end of canvas
-                gd.pPixels = &buf[pImage->iCanvasHeight * pImage->iCanvasWidth]; // point to the line we just converted
-                (*pImage->pfnDraw)(&gd); // callback to handle this line
-            } else if (pImage->pFrameBuffer) {
-                uint16_t *d = (uint16_t *)&pImage->pFrameBuffer[pImage->iCanvasWidth * pImage->iCanvasHeight];
-                DrawCooked(pImage, &gd, &d[((gd.y + gd.iY) * pImage->iCanvasWidth) + gd.iX]);
-            }
-        }
+    if (!(iOptions & GIF_DECODE_ONLY)) {
+        GIFDirtyStart(pImage);
+        GIFTurboOutput(pImage, buf);
     }
     return iErr;
 } /* DecodeLZWTurbo() */
@@ -1423,9 +4659,9 @@ static void GIFMakePels(GIFIMAGE *pPage, unsigned int code)
     //   iPixCount = 0;
     pEnd = pPage->ucFileBuf;
     s = pEnd + FILE_BUF_SIZE; /* Pixels will come out in reversed order */
-    buf = pPage->pLineBufAligned + (pPage->iWidth - pPage->iXCount);
-    giftabs = pPage->usGIFTable;
-    gifpels = &pPage->ucGIFPixels[PIXEL_LAST];
+    buf = pPage->pLineBufAligned + (pPage->iSrcWidth - pPage->iXCount);
+    giftabs = GIF_WORK(pPage)->usGIFTable;
+    gifpels = &GIF_WORK(pPage)->ucGIFPixels[PIXEL_LAST];
     while (code < LINK_UNUSED)
     {
         if (s == pEnd) /* Houston, we have a problem */
@@ -1463,27 +4699,22 @@ static void GIFMakePels(GIFIMAGE *pPage, unsigned int code)
         else  /* Pixels cross into next line */
         {
             GIFDRAW gd;
+            uint8_t *pDest, *pStripLine;
             pEnd = buf + pPage->iXCount;
             while (buf < pEnd)
             {
                 *buf++ = *s++;
             }
             iPixCount -= pPage->iXCount;
-            pPage->iXCount = pPage->iWidth; /* Reset pixel count */
+            pPage->iXCount = pPage->iSrcWidth; /* Reset pixel count */
             // Prepare GIDRAW structure for callback
-            gd.iX = pPage->iX;
-            gd.iY = pPage->iY;
-            gd.iWidth = pPage->iWidth;
-            gd.iHeight = pPage->iHeight;
+            GIFInitDraw(pPage, &gd);
             gd.pPixels = pPage->pLineBufAligned;
-            gd.pPalette = (pPage->bUseLocalPalette) ? pPage->pLocalPalette : pPage->pPalette;
-            gd.pPalette24 = (uint8_t *)gd.pPalette; // just cast the pointer for RGB888
-            gd.ucIsGlobalPalette = pPage->bUseLocalPalette==1?0:1;
-            gd.y = pPage->iHeight - pPage->iYCount;
+            gd.y = pPage->iSrcHeight - pPage->iYCount;
             // Ugly logic to handle the interlaced line position, but it
             // saves having to have another set of state variables
             if (pPage->ucMap & 0x40) { // interlaced?
-               int height = pPage->iHeight-1;
+               int height = pPage->iSrcHeight-1;
                if (gd.y > height / 2)
                   gd.y = gd.y * 2 - (height | 1);
                else if (gd.y > height / 4)
@@ -1493,13 +4724,13 @@ static void GIFMakePels(GIFIMAGE *pPage, unsigned int code)
                else
                   gd.y = gd.y * 8;
             }
-            pPage->ucDisposalMethod = gd.ucDisposalMethod = (pPage->ucGIFBits & 0x1c)>>2;
-            gd.ucTransparent = pPage->ucTransparent;
-            gd.ucHasTransparency = pPage->ucGIFBits & 1;
-            gd.ucBackground = pPage->ucBackground;
-            gd.iCanvasWidth = pPage->iCanvasWidth;
-            gd.pUser = pPage->pUser;
-            gd.ucPaletteType = pPage->ucPaletteType;
+            if (GIF_LINE_MAPPED(pPage) && !GIFScaleLine(pPage, &gd, NULL)) {
+                pPage->iYCount--; // this line isn't part of the output
+                buf = pPage->pLineBufAligned;
+                continue;
+            }
+            pStripLine = GIFStripLine(pPage, &gd); // NULL unless strip mode is active
+            GIFSpanLine(pPage, &gd, (pStripLine != NULL));
             if (pPage->pFrameBuffer) // update the frame buffer
             {
                 int iPitch = 0, iBpp = 1, iOffset = pPage->iCanvasWidth * pPage->iCanvasHeight;
@@ -1525,14 +4756,17 @@ static void GIFMakePels(GIFIMAGE *pPage, unsigned int code)
                         }
                         iOffset += (iBpp * pPage->iX) + ((gd.y + pPage->iY) * iPitch);
                     }
-                    DrawCooked(pPage, &gd, &pPage->pFrameBuffer[iOffset]);
+                    pDest = (pStripLine) ? pStripLine : &pPage->pFrameBuffer[iOffset];
+                    DrawCooked(pPage, &gd, pDest);
                     // pass the cooked pixel pointer to the GIFDraw callback
-                    gd.pPixels = &pPage->pFrameBuffer[iOffset];
+                    gd.pPixels = pDest;
                 } else { // the user will manage converting them through the palette
                     DrawNewPixels(pPage, &gd); // merge the new opaque pixels
                 }
             }
-            if (pPage->pfnDraw) {
+            if (pStripLine) {
+                GIFStripAdd(pPage, &gd, pStripLine, (GIF_LINE_MAPPED(pPage)) ? (gd.y == pPage->iHeight-1) : (pPage->iYCount == 1));
+            } else if (pPage->pfnDraw && GIF_LINE_VISIBLE(pPage, &gd)) {
                 (*pPage->pfnDraw)(&gd); // callback to handle this line
             }
             pPage->iYCount--;
@@ -1553,47 +4787,29 @@ static void GIFMakePels(GIFIMAGE *pPage, unsigned int code)
         code = (unsigned short) (ulBits >> bitnum); /* Read a REGISTER_WIDTH chunk */ \
         code &= sMask; bitnum += codesize;
 //
-// Decode LZW into an image
+// Handle disposal method 2 of the previous frame
+// If we're generating fully 'cooked' output we can support disposal method 2
+// This requires that we know the size and position of the last frame so that we can
+// 'dispose' of it by filling it with the background color
 //
-static int DecodeLZW(GIFIMAGE *pImage, int iOptions)
+static void GIFDisposePrevious(GIFIMAGE *pImage)
 {
-    int i, bitnum;
-    unsigned short oldcode, codesize, nextcode, nextlim;
-    unsigned short *giftabs, cc, eoi;
-    signed short sMask;
-    unsigned char c, *gifpels, *p;
-    //    int iStripSize;
-    //unsigned char **index;
-    BIGUINT ulBits;
-    unsigned short code;
-    (void)iOptions; // not used for now
-    // if output can be used for string table, do it faster
-    //       if (bGIF && (OutPage->cBitsperpixel == 8 && ((OutPage->iWidth & 3) == 0)))
-    //          return PILFastLZW(InPage, OutPage, bGIF, iOptions);
-    if (pImage->ucDrawType == GIF_DRAW_COOKED && pImage->pFrameBuffer == NULL && pImage->pfnDraw == NULL) { // without a framebuffer and a GIFDRAW callback, we cannot continue
-        pImage->iError = GIF_INVALID_PARAMETER;
-        return 1; // indicate a problem
-    }
-    // If the user selected RAW output and there is no GIFDRAW callback, that won't work either
-    if (pImage->ucDrawType == GIF_DRAW_RAW && pImage->pfnDraw == NULL) {
-        pImage->iError = GIF_INVALID_PARAMETER;
-        return 1; // indicate a problem
-    }
-    // If we're generating fully 'cooked' output we can support disposal method 2
-    // This requires that we know the size and position of the last frame so that we can
-    // 'dispose' of it by filling it with the background color
     if (pImage->ucDrawType == GIF_DRAW_COOKED && pImage->pFrameBuffer) {
         // cooked output with a framebuffer
         if (pImage->ucPrevDisp == 2) {
-            uint8_t *pActivePalette;
+            uint8_t *pActivePalette, *p, c;
             uint16_t *pPal, u16BG, *d16;
-            pActivePalette = (pImage->bUseLocalPalette) ? (uint8_t *)pImage->pLocalPalette : (uint8_t *)pImage->pPalette;
+            int i;
+            pActivePalette = (pImage->bUseLocalPalette) ? (uint8_t *)pImage->pLocalPal : (uint8_t *)pImage->pPalette;
             pPal = (uint16_t *)pActivePalette;
             c = pImage->ucBackground;
             for (int y=pImage->iPrevY; y < pImage->iPrevH + pImage->iPrevY; y++) {
                 p = &pImage->pFrameBuffer[(y * pImage->iCanvasWidth) + pImage->iPrevX];
+                GIFDirtyFill(pImage, p, c, pImage->iPrevX, y, pImage->iPrevW);
                 memset(p, c, pImage->iPrevW); // restore 8-bit image to background color
-                if (pImage->ucPaletteType == GIF_PALETTE_RGB565_LE || pImage->ucPaletteType == GIF_PALETTE_RGB565_BE) {
+                if (pImage->ucPaletteType != GIF_PALETTE_RGB565_LE && pImage->ucPaletteType != GIF_PALETTE_RGB565_BE) {
+                    pImage->bCookedStale = pImage->bDirtyAll = 1; // the cooked pixels still show the old frame
+                } else {
                     u16BG = pPal[c];
                     d16 = (uint16_t *)&pImage->pFrameBuffer[(pImage->iCanvasWidth * pImage->iCanvasHeight) + (y * pImage->iCanvasWidth*2) + (pImage->iPrevX * 2)];
                     for (i=0; i<pImage->iPrevW; i++) {
@@ -1603,18 +4819,59 @@ static int DecodeLZW(GIFIMAGE *pImage, int iOptions)
             }
         }
     }
-    p = pImage->ucLZW; // un-chunked LZW data
+} /* GIFDisposePrevious() */
+//
+// Save this info because we need to dispose of this frame area the next time
+// through the decoder. Disposal method 2 says to erase the 'previous' frame to
+// the background color, so we need to save it's size and position
+//
+static void GIFSavePrevious(GIFIMAGE *pImage)
+{
+    if (pImage->ucDisposalMethod == 2) {
+        pImage->iPrevW = pImage->iWidth;
+        pImage->iPrevH = pImage->iHeight;
+        pImage->iPrevX = pImage->iX;
+        pImage->iPrevY = pImage->iY;
+    }
+    pImage->ucPrevDisp = pImage->ucDisposalMethod;
+} /* GIFSavePrevious() */
+//
+// Set up the classic decoder for the current frame
+// returns 0 for success, 1 for a problem (iError is set)
+//
+static int GIFStartLZW(GIFIMAGE *pImage)
+{
+    int i;
+    unsigned short cc;
+    signed short sMask;
+    unsigned char *gifpels;
+    unsigned short *giftabs;
+
+    // if output can be used for string table, do it faster
+    //       if (bGIF && (OutPage->cBitsperpixel == 8 && ((OutPage->iWidth & 3) == 0)))
+    //          return PILFastLZW(InPage, OutPage, bGIF, iOptions);
+    if (pImage->ucDrawType == GIF_DRAW_COOKED && pImage->pFrameBuffer == NULL && pImage->pfnDraw == NULL) { // without a framebuffer and a GIFDRAW callback, we cannot continue
+        pImage->iError = GIF_INVALID_PARAMETER;
+        return 1; // indicate a problem
+    }
+    // If the user selected RAW output and there is no GIFDRAW callback, that won't work either
+    if (pImage->ucDrawType == GIF_DRAW_RAW && pImage->pfnDraw == NULL) {
+        pImage->iError = GIF_INVALID_PARAMETER;
+        return 1; // indicate a problem
+    }
+    GIFDirtyStart(pImage);
+    GIFDisposePrevious(pImage);
     sMask = 0xffff << (pImage->ucCodeStart + 1);
     sMask = 0xffff - sMask;
     cc = (sMask >> 1) + 1; /* Clear code */
-    eoi = cc + 1;
-    giftabs = pImage->usGIFTable;
-    gifpels = pImage->ucGIFPixels;
-    pImage->iYCount = pImage->iHeight; // count down the lines
-    pImage->iXCount = pImage->iWidth;
-    bitnum = 0;
+    giftabs = GIF_WORK(pImage)->usGIFTable;
+    gifpels = GIF_WORK(pImage)->ucGIFPixels;
+    pImage->iYCount = pImage->iSrcHeight; // count down the lines
+    pImage->iXCount = pImage->iSrcWidth;
+    pImage->iBitNum = 0;
     pImage->iLZWOff = 0; // Offset into compressed data
     GIFGetMoreData(pImage); // Read some data to start
+    pImage->iStripCount = 0;
 
     // Initialize code table
     // this part only needs to be initialized once
@@ -1623,14 +4880,96 @@ static int DecodeLZW(GIFIMAGE *pImage, int iOptions)
         gifpels[PIXEL_FIRST + i] = gifpels[PIXEL_LAST + i] = (unsigned short) i;
         giftabs[i] = LINK_END;
     }
+    pImage->bNewTable = 1; // the code stream starts with a fresh table
+    pImage->iStepStopY = pImage->iStepEndY = -1; // no budget (see GIFDecodeStep)
+    return 0;
+} /* GIFStartLZW() */
+//
+// Microsecond clock for the decodeStep() time budget
+//
+static uint32_t GIFMicros(void)
+{
+#if defined(__LINUX__) || defined(__MACH__)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+#elif defined(ARDUINO)
+    return (uint32_t)micros();
+#else
+    return 0; // no clock; only the row budget counts
+#endif
+} /* GIFMicros() */
+//
+// A row has been finished; see if the decodeStep() budget is spent
+// The clock is only read once per row
+//
+static int GIFStepSpent(GIFIMAGE *pImage)
+{
+    if (pImage->iYCount <= pImage->iStepEndY)
+        return 1;
+    if (pImage->u32StepMicros && (GIFMicros() - pImage->u32StepStart) >= pImage->u32StepMicros)
+        return 1;
+    pImage->iStepStopY = (pImage->u32StepMicros) ? pImage->iYCount - 1 : pImage->iStepEndY;
+    return 0;
+} /* GIFStepSpent() */
+//
+// Check if the classic decoder has to stop before the next code(s):
+// the decodeStep() budget is spent or (push mode) they haven't arrived yet
+//
+static GIF_INLINE int GIFLZWPause(GIFIMAGE *pImage, int bitnum, int iBits)
+{
+    if ((int)pImage->iYCount <= pImage->iStepStopY && GIFStepSpent(pImage))
+        return 1;
+    return (pImage->ucFeedState && !pImage->bEndOfFrame && ((pImage->iLZWSize - pImage->iLZWOff) << 3) - bitnum < iBits);
+} /* GIFLZWPause() */
+//
+// Run the classic decoder until the end of the frame
+// With bSteps set, it stops when the decodeStep() budget is spent or
+// before a code whose bits haven't arrived yet (push mode) and keeps its
+// state in GIFIMAGE so that the next call picks up there.
+// returns 0 when the frame is finished, 1 when it stopped early
+//
+static GIF_INLINE int GIFRunLZW(GIFIMAGE *pImage, int bSteps)
+{
+    int bitnum;
+    unsigned short oldcode, codesize, nextcode, nextlim;
+    unsigned short *giftabs, cc, eoi;
+    signed short sMask;
+    unsigned char c, *gifpels, *p;
+    BIGUINT ulBits;
+    unsigned short code;
+
+    p = pImage->pLZW; // un-chunked LZW data
+    sMask = 0xffff << (pImage->ucCodeStart + 1);
+    sMask = 0xffff - sMask;
+    cc = (sMask >> 1) + 1; /* Clear code */
+    eoi = cc + 1;
+    giftabs = GIF_WORK(pImage)->usGIFTable;
+    gifpels = GIF_WORK(pImage)->ucGIFPixels;
+    bitnum = pImage->iBitNum;
+    if (!pImage->bNewTable) { // pick up where the last call stopped
+        codesize = pImage->usCodeSize;
+        sMask = pImage->sCodeMask;
+        nextcode = pImage->usNextCode;
+        nextlim = pImage->usNextLim;
+        c = pImage->ucLastPel;
+        code = oldcode = pImage->usOldCode;
+        ulBits = INTELLONG(&p[pImage->iLZWOff]);
+        goto decode_codes;
+    }
 init_codetable:
+    if (bSteps && GIFLZWPause(pImage, bitnum, (pImage->ucCodeStart + 1) * 2)) {
+        pImage->bNewTable = 1;
+        pImage->iBitNum = bitnum;
+        return 1;
+    }
     codesize = pImage->ucCodeStart + 1;
     sMask = 0xffff << (pImage->ucCodeStart + 1);
     sMask = 0xffff - sMask;
     nextcode = cc + 2;
     nextlim = (unsigned short) ((1 << codesize));
     // This part of the table needs to be reset multiple times
-    memset(&giftabs[cc], LINK_UNUSED, sizeof(pImage->usGIFTable) - sizeof(giftabs[0])*cc);
+    memset(&giftabs[cc], LINK_UNUSED, sizeof(GIF_WORK(pImage)->usGIFTable) - sizeof(giftabs[0])*cc);
     ulBits = INTELLONG(&p[pImage->iLZWOff]); // start by reading 4 bytes of LZW data
     GET_CODE
     if (code == cc) // we just reset the dictionary, so get another code
@@ -1639,9 +4978,21 @@ init_codetable:
     }
     c = oldcode = code;
     GIFMakePels(pImage, code); // first code is output as the first pixel
+decode_codes:
     // Main decode loop
     while (code != eoi && pImage->iYCount > 0) // && y < pImage->iHeight+1) /* Loop through all lines of the image (or strip) */
     {
+        if (bSteps && GIFLZWPause(pImage, bitnum, codesize)) {
+            pImage->bNewTable = 0;
+            pImage->iBitNum = bitnum;
+            pImage->usCodeSize = codesize;
+            pImage->sCodeMask = sMask;
+            pImage->usNextCode = nextcode;
+            pImage->usNextLim = nextlim;
+            pImage->ucLastPel = c;
+            pImage->usOldCode = oldcode;
+            return 1;
+        }
         GET_CODE
         if (code == cc) /* Clear code?, and not first code */
             goto init_codetable;
@@ -1664,22 +5015,311 @@ init_codetable:
             oldcode = code;
         }
     } /* while not end of LZW code stream */
-    if (pImage->ucDisposalMethod == 2) {
-        // Save this info because we need to dispose of this frame area the next time
-        // through the decoder. Disposal method 2 says to erase the 'previous' frame to
-        // the background color, so we need to save it's size and position
-        pImage->iPrevW = pImage->iWidth;
-        pImage->iPrevH = pImage->iHeight;
-        pImage->iPrevX = pImage->iX;
-        pImage->iPrevY = pImage->iY;
+    return 0;
+} /* GIFRunLZW() */
+//
+// Finish the frame after the last code
+//
+static void GIFEndLZW(GIFIMAGE *pImage)
+{
+    if (pImage->pfnDraw) {
+        GIFStripFlush(pImage); // in case the frame ended early
     }
-    pImage->ucPrevDisp = pImage->ucDisposalMethod;
+    GIFSavePrevious(pImage);
+} /* GIFEndLZW() */
+//
+// Decode LZW into an image
+//
+static int DecodeLZW(GIFIMAGE *pImage, int iOptions)
+{
+    (void)iOptions; // not used for now
+    if (GIFStartLZW(pImage))
+        return 1; // indicate a problem
+    GIFRunLZW(pImage, 0);
+    GIFEndLZW(pImage);
     return 0;
 //gif_forced_error:
 //    free(pImage->pPixels);
 //    pImage->pPixels = NULL;
 //    return -1;
 } /* DecodeLZW() */
+//
+// Time-sliced decoding
+// Each call decodes the current frame (starting the next one if needed)
+// until iRows rows are finished or iMicros microseconds have passed,
+// whichever comes first, then returns so that the caller can do other
+// work. The classic decoder's state stays in GIFIMAGE between calls.
+// At least one row is decoded per call; 0 for both decodes the rest of
+// the frame. The budget is checked between rows, so a step can overrun
+// it by one row. Frames decoded in steps always use the classic decoder
+// (Turbo decodes a frame in one pass through the Turbo buffer) and don't
+// borrow a workspace from a pool.
+// returns 2 = the frame isn't finished yet, 1 = the frame is finished
+// and more follow, 0 = the last frame is finished, -1 = error
+//
+static int GIFDecodeStep(GIFIMAGE *pPage, int iRows, int32_t iMicros, int *delayMilliseconds, void *pUser)
+{
+    if (delayMilliseconds)
+        *delayMilliseconds = 0;
+    if (pPage->ucFeedState || iRows < 0 || iMicros < 0) {
+        pPage->iError = GIF_INVALID_PARAMETER;
+        return -1;
+    }
+    pPage->u32StepStart = GIFMicros();
+    pPage->pUser = pUser;
+    if (!pPage->bStepFrame) { // start the next frame
+        if (pPage->GIFFile.iPos >= pPage->GIFFile.iSize-1) { // no more data exists
+            (*pPage->pfnSeek)(&pPage->GIFFile, 0); // seek to start
+            pPage->iCurrentFrame = 0;
+        }
+        if (pPage->ucBakeState && GIFBakeReplay(pPage)) // drawn from the decoded frame cache in one go
+            goto frame_done;
+        pPage->bStepFrame = 1;
+        pPage->iStepFrameStart = pPage->GIFFile.iPos;
+        if (!GIFParseInfo(pPage, 0) || pPage->iError == GIF_EMPTY_FRAME || GIFStartLZW(pPage)) {
+            pPage->bStepFrame = 0;
+            GIFReleaseWork(pPage);
+            return (pPage->iError == GIF_EMPTY_FRAME) ? 0 : -1;
+        }
+    }
+    pPage->iStepEndY = (iRows) ? pPage->iYCount - iRows : -1;
+    pPage->u32StepMicros = (uint32_t)iMicros;
+    pPage->iStepStopY = (iMicros) ? pPage->iYCount - 1 : pPage->iStepEndY;
+    if (GIFRunLZW(pPage, 1))
+        return 2; // the budget is spent
+    GIFEndLZW(pPage);
+    pPage->bStepFrame = 0;
+    GIFReleaseWork(pPage);
+    GIFBakeSave(pPage);
+    pPage->iCurrentFrame++;
+    if (pPage->pSnapBuf)
+        GIFSaveSnapshot(pPage);
+frame_done:
+    if (pPage->pStretchBuf)
+        GIFStretchFrame(pPage);
+    if (delayMilliseconds) // if not NULL, return the frame delay time
+        *delayMilliseconds = pPage->iFrameDelay;
+    return GIFMoreFrames(pPage);
+} /* GIFDecodeStep() */
+//
+// Returns 1 if there's another frame after the one just played
+// (the last 10 bytes can only hold the trailer and stray padding)
+//
+static int GIFMoreFrames(GIFIMAGE *pPage)
+{
+    return (pPage->GIFFile.iPos < pPage->GIFFile.iSize-10);
+} /* GIFMoreFrames() */
+//
+// Drop a frame which decodeStep() hasn't finished; the file goes back to
+// the start of that frame so that whatever decodes next starts it again
+//
+static void GIFDropStep(GIFIMAGE *pPage)
+{
+    if (pPage->bStepFrame) {
+        pPage->bStepFrame = 0;
+        GIFReleaseWork(pPage);
+        (*pPage->pfnSeek)(&pPage->GIFFile, pPage->iStepFrameStart);
+    }
+} /* GIFDropStep() */
+//
+// Push mode
+// Instead of reading the file, the decoder is given the bytes as they
+// arrive (feed). They're collected in the caller's buffer and the classic
+// decoder runs as far as they allow, then keeps its state in GIFIMAGE for
+// the next call, so the lines of a frame are drawn while the rest of it
+// is still on its way. Headers are parsed once they're complete and LZW
+// data is taken a whole sub-block at a time; the bytes used are dropped
+// from the buffer, so it only has to hold the largest header (with the
+// palettes) plus a sub-block or two. The canvas size is known (see
+// getCanvasWidth) once the first 13 bytes have been fed. Push mode always
+// uses the classic decoder and doesn't use the frame cache, snapshots,
+// the frame index, the comment or a workspace pool.
+//
+static int GIFOpenFeed(GIFIMAGE *pPage, uint8_t *pBuf, int32_t iBufSize, GIF_DRAW_CALLBACK *pfnDraw)
+{
+    if (pBuf == NULL || iBufSize < MAX_CHUNK_SIZE * 2) {
+        pPage->iError = GIF_INVALID_PARAMETER;
+        return 0;
+    }
+    pPage->iError = GIF_SUCCESS;
+    pPage->pfnRead = readMem;
+    pPage->pfnSeek = seekMem;
+    pPage->pfnDraw = pfnDraw;
+    pPage->pfnOpen = NULL;
+    pPage->pfnClose = NULL;
+    pPage->GIFFile.pData = pBuf;
+    pPage->GIFFile.iSize = pPage->GIFFile.iPos = 0;
+    pPage->pFeedBuf = pBuf;
+    pPage->iFeedBufSize = iBufSize;
+    pPage->ucFeedState = GIF_FEED_HEADER;
+    pPage->iSrcCanvasWidth = pPage->iSrcCanvasHeight = 0;
+    pPage->iCanvasWidth = pPage->iCanvasHeight = 0;
+    pPage->iCurrentFrame = 0;
+    pPage->iCommentPos = pPage->sCommentLen = 0;
+    return 1;
+} /* GIFOpenFeed() */
+//
+// Check if the file header (before the first frame) and the next frame
+// header have arrived in full, along with the length of the first sub-block
+// returns 1 = ready, 0 = wait for more data, 2 = end of file, -1 = error
+//
+static int GIFFeedReady(GIFIMAGE *pPage)
+{
+    const uint8_t *p = pPage->GIFFile.pData;
+    int32_t i = pPage->GIFFile.iPos, iLen = pPage->GIFFile.iSize;
+    int c;
+
+    if (pPage->ucFeedState == GIF_FEED_HEADER) {
+        if (iLen < 13)
+            return 0;
+        if (memcmp(p, "GIF89", 5) != 0 && memcmp(p, "GIF87", 5) != 0) { // not a GIF file
+            pPage->iError = GIF_BAD_FILE;
+            return -1;
+        }
+        if (pPage->iSrcCanvasWidth == 0) { // let the caller set up for the canvas size
+            pPage->iSrcCanvasWidth = INTELSHORT(&p[6]);
+            pPage->iSrcCanvasHeight = INTELSHORT(&p[8]);
+            GIFScaleCanvas(pPage);
+        }
+        i = 13;
+        if (p[10] & 0x80) // global color table
+            i += 3 << ((p[10] & 7) + 1);
+    }
+    while (i < iLen) {
+        if (p[i] == ';') // trailer
+            return 2;
+        if (p[i] == ',') { // image descriptor
+            if (i + 10 > iLen)
+                return 0;
+            c = p[i+9];
+            i += 10;
+            if (c & 0x80) // local color table
+                i += 3 << ((c & 7) + 1);
+            return (i + 1 < iLen); // the code size and the first sub-block length
+        }
+        if (p[i] != '!') {
+            pPage->iError = GIF_DECODE_ERROR;
+            return -1;
+        }
+        i += 2; // extension introducer and label
+        do { // data sub-blocks
+            if (i >= iLen)
+                return 0;
+            c = p[i];
+            i += c + 1;
+        } while (c);
+    }
+    return 0;
+} /* GIFFeedReady() */
+//
+// Run the push mode decoder as far as the bytes in the buffer allow
+// returns 0 = wait for more data, 2 = end of file, -1 = error
+//
+static int GIFFeedRun(GIFIMAGE *pPage, GIFFEEDINFO *pInfo)
+{
+    const uint8_t *p;
+    int32_t iPos;
+    int rc, iLines;
+
+    while (1) {
+        switch (pPage->ucFeedState) {
+            case GIF_FEED_HEADER:
+            case GIF_FEED_FRAME:
+                rc = GIFFeedReady(pPage);
+                if (rc != 1)
+                    return rc;
+                if (pPage->ucFeedState == GIF_FEED_HEADER && !GIFInit(pPage))
+                    return -1;
+                if (!GIFParseInfo(pPage, 0) || GIFStartLZW(pPage))
+                    return -1;
+                pPage->ucFeedState = GIF_FEED_DECODE;
+                // fall through
+            case GIF_FEED_DECODE:
+                iLines = pPage->iYCount;
+                GIFGetMoreData(pPage); // the sub-blocks which arrived since the last call
+                while ((rc = GIFRunLZW(pPage, 1)) == 1) { // out of codes
+                    iPos = pPage->iLZWSize - pPage->iLZWOff;
+                    GIFGetMoreData(pPage);
+                    if (pPage->iLZWSize - pPage->iLZWOff == iPos && !pPage->bEndOfFrame)
+                        break; // the rest of the frame hasn't arrived yet
+                }
+                pInfo->iRows += iLines - pPage->iYCount;
+                if (rc)
+                    return 0;
+                GIFEndLZW(pPage);
+                pPage->iCurrentFrame++;
+                if (pPage->pStretchBuf)
+                    GIFStretchFrame(pPage);
+                pInfo->iFrames++;
+                pPage->ucFeedState = GIF_FEED_SKIP;
+                // fall through
+            case GIF_FEED_SKIP: // any sub-blocks left after the last code
+                p = pPage->GIFFile.pData;
+                iPos = pPage->GIFFile.iPos;
+                while (!pPage->bEndOfFrame) {
+                    if (iPos >= pPage->GIFFile.iSize || iPos + 1 + p[iPos] > pPage->GIFFile.iSize) {
+                        pPage->GIFFile.iPos = iPos;
+                        return 0;
+                    }
+                    pPage->bEndOfFrame = (p[iPos] == 0);
+                    iPos += 1 + p[iPos];
+                }
+                pPage->GIFFile.iPos = iPos;
+                pPage->ucFeedState = GIF_FEED_FRAME;
+                break;
+            default: // GIF_FEED_END
+                return 2;
+        }
+    }
+} /* GIFFeedRun() */
+//
+// Pass the next piece of the file to the push mode decoder
+// returns 1 = more data needed, 0 = the end of the file was reached, -1 = error
+//
+static int GIFFeed(GIFIMAGE *pPage, const uint8_t *pData, int32_t iLen, GIFFEEDINFO *pInfo, void *pUser)
+{
+    GIFFEEDINFO info;
+    int32_t i, iPos;
+    int rc;
+
+    if (pInfo == NULL)
+        pInfo = &info;
+    pInfo->iFrames = pInfo->iRows = 0;
+    if (pPage->ucFeedState == GIF_FEED_OFF || iLen < 0 || (pData == NULL && iLen)) {
+        pPage->iError = GIF_INVALID_PARAMETER;
+        return -1;
+    }
+    pPage->pUser = pUser;
+    do {
+        i = pPage->iFeedBufSize - pPage->GIFFile.iSize; // room left in the buffer
+        if (i > iLen)
+            i = iLen;
+        memcpy(&pPage->pFeedBuf[pPage->GIFFile.iSize], pData, i);
+        pPage->GIFFile.iSize += i;
+        pData += i;
+        iLen -= i;
+        rc = GIFFeedRun(pPage, pInfo);
+        iPos = pPage->GIFFile.iPos;
+        if (iPos > 1) { // drop the bytes used; keep one so that position 0 still means the file header
+            memmove(&pPage->pFeedBuf[1], &pPage->pFeedBuf[iPos], pPage->GIFFile.iSize - iPos);
+            pPage->GIFFile.iSize -= iPos - 1;
+            pPage->GIFFile.iPos = 1;
+            pPage->iCommentPos = pPage->sCommentLen = 0;
+        }
+        if (rc == 0 && iLen && pPage->GIFFile.iSize == pPage->iFeedBufSize) { // a header doesn't fit
+            pPage->iError = GIF_ERROR_MEMORY;
+            rc = -1;
+        }
+    } while (rc == 0 && iLen);
+    pInfo->iFrame = pPage->iCurrentFrame;
+    pInfo->iFrameRows = (pPage->ucFeedState == GIF_FEED_DECODE) ? pPage->iSrcHeight - pPage->iYCount : 0;
+    if (rc < 0) {
+        if (pPage->iError == GIF_SUCCESS)
+            pPage->iError = GIF_DECODE_ERROR;
+        return -1;
+    }
+    return (rc == 0);
+} /* GIFFeed() */
 
 void GIF_setDrawCallback(GIFIMAGE *pGIF, GIF_DRAW_CALLBACK *pfnDraw)
 {